@@ -8,5 +8,5 @@ clean:
 	-rm -f basis$(EXE)
 
 basis: basis.o $(LIBPHORWARD)
-	$(CC) -o $@$(EXE) basis.o $(LIBPHORWARD)
+	$(CC) -o $@$(EXE) basis.o $(LIBPHORWARD) -lpthread
 
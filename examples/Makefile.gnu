@@ -1,5 +1,5 @@
 CFLAGS += -g -DDEBUG -DUNICODE -DUTF8 -I../src
-LDFLAGS += -L../src -lphorward
+LDFLAGS += -L../src -lphorward -lpthread
 
 SRC = 	lexing.c \
 		parsing.c \
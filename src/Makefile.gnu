@@ -31,13 +31,18 @@ SRC = \
 	parse/pbnf.c \
 	parse/prod.c \
 	parse/sym.c \
+	regex/bitnfa.c \
 	regex/dfa.c \
 	regex/direct.c \
+	regex/image.c \
+	regex/lazy.c \
 	regex/lex.c \
 	regex/misc.c \
 	regex/nfa.c \
+	regex/parallel.c \
 	regex/ptn.c \
 	regex/regex.c \
+	regex/stream.c \
 	string/convert.c \
 	string/string.c \
 	string/utf8.c \
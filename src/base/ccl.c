@@ -12,13 +12,139 @@ Usage:	Character classes
 #define PREGEX_LOCAL
 #include "phorward.h"
 
-/* Sort-function required for quick sort */
-static int ccl_SORTFUNC( plist* list, plistel* el, plistel* er )
+/*
+	A character-class holds its ranges in one packed array, which is kept
+	sorted by the begin of the ranges, and where no ranges overlap or touch
+	each other. Tests are done by binary search; for the characters 0-255,
+	the bitmap //map// is kept in sync with the ranges and answers single
+	character tests directly.
+
+	Set operations merge the sorted range arrays of both classes in one pass.
+*/
+
+/* Sort-function required for qsort() */
+static int ccl_SORTFUNC( const void* l, const void* r )
+{
+	return ((pcrange*)l)->begin - ((pcrange*)r)->begin;
+}
+
+/* Ensures that //ccl// has space for at least //size// ranges. */
+static void p_ccl_grow( pccl* ccl, int size )
+{
+	if( size <= ccl->size )
+		return;
+
+	ccl->size = ccl->size * 2 > size ? ccl->size * 2 : size;
+
+	if( ccl->size < 8 )
+		ccl->size = 8;
+
+	ccl->ranges = (pcrange*)prealloc( ccl->ranges,
+										ccl->size * sizeof( pcrange ) );
+}
+
+/* Rebuilds the bitmap of the characters 0-255 from the ranges of //ccl//. */
+static void p_ccl_setmap( pccl* ccl )
 {
-	pcrange*	l	= (pcrange*)plist_access( el );
-	pcrange*	r	= (pcrange*)plist_access( er );
+	pcrange*	r;
+	int			ch;
+	int			end;
+
+	memset( ccl->map, 0, sizeof( ccl->map ) );
+
+	for( r = ccl->ranges; r < ccl->ranges + ccl->count; r++ )
+	{
+		if( r->begin > 0xFF )
+			break;
+
+		end = r->end > 0xFF ? 0xFF : r->end;
 
-	return r->begin - l->begin;
+		for( ch = r->begin; ch <= end; ch++ )
+			ccl->map[ ch >> 3 ] |= 1 << ( ch & 7 );
+	}
+}
+
+/* Returns the index of the first range in //ccl// that ends at or behind
+//ch//, or the number of ranges if there is none. */
+static int p_ccl_find( pccl* ccl, int ch )
+{
+	int		lo	= 0;
+	int		hi	= ccl->count;
+	int		mid;
+
+	while( lo < hi )
+	{
+		mid = ( lo + hi ) / 2;
+
+		if( ccl->ranges[ mid ].end < ch )
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+/* Replaces the ranges //from// up to //to// (exclusive) of //ccl// by the
+//cnt// ranges in //ins//. */
+static void p_ccl_splice( pccl* ccl, int from, int to, pcrange* ins, int cnt )
+{
+	p_ccl_grow( ccl, ccl->count - ( to - from ) + cnt );
+
+	memmove( ccl->ranges + from + cnt, ccl->ranges + to,
+				( ccl->count - to ) * sizeof( pcrange ) );
+	memcpy( ccl->ranges + from, ins, cnt * sizeof( pcrange ) );
+
+	ccl->count += cnt - ( to - from );
+}
+
+/* Appends a range to //ccl//, which must not begin before the last range of
+//ccl//. Overlapping or touching ranges are merged. */
+static void p_ccl_append( pccl* ccl, wchar_t begin, wchar_t end )
+{
+	pcrange*	last;
+
+	if( ccl->count )
+	{
+		last = ccl->ranges + ccl->count - 1;
+
+		if( (int)begin <= (int)last->end + 1 )
+		{
+			if( end > last->end )
+				last->end = end;
+
+			return;
+		}
+	}
+
+	p_ccl_grow( ccl, ccl->count + 1 );
+
+	ccl->ranges[ ccl->count ].begin = begin;
+	ccl->ranges[ ccl->count++ ].end = end;
+}
+
+/* Orders and clips the range //begin// to //end// to the universe of //ccl//
+into //cr//. Returns FALSE if the range is outside the universe. */
+static pboolean p_ccl_clip( pccl* ccl, pcrange* cr, wchar_t begin, wchar_t end )
+{
+	if( begin > end )
+	{
+		cr->begin = end;
+		cr->end = begin;
+	}
+	else
+	{
+		cr->begin = begin;
+		cr->end = end;
+	}
+
+	if( cr->begin < ccl->min )
+		cr->begin = ccl->min;
+
+	if( cr->end > ccl->max )
+		cr->end = ccl->max;
+
+	return cr->begin <= ccl->max && cr->end >= ccl->min;
 }
 
 /** Constructor function to create a new character-class.
@@ -43,9 +169,6 @@ pccl* p_ccl_create( int min, int max, char* ccldef )
 
 	ccl = (pccl*)pmalloc( sizeof( pccl ) );
 
-	ccl->ranges = plist_create( sizeof( pcrange ), PLIST_MOD_RECYCLE );
-	plist_set_sortfn( ccl->ranges, ccl_SORTFUNC );
-
 	if( min > max )
 	{
 		ccl->min = max;
@@ -94,7 +217,7 @@ int p_ccl_size( pccl* ccl )
 		return 0;
 	}
 
-	return plist_count( ccl->ranges );
+	return ccl->count;
 }
 
 /** Returns the number of characters within a character-class.
@@ -105,7 +228,6 @@ Returns the total number of characters the class is holding.
 */
 int p_ccl_count( pccl* ccl )
 {
-	plistel*	e;
 	pcrange*	cr;
 	int			cnt	= 0;
 
@@ -115,11 +237,8 @@ int p_ccl_count( pccl* ccl )
 		return 0;
 	}
 
-	for( e = plist_first( ccl->ranges ); e; e = plist_next( e ) )
-	{
-		cr = (pcrange*)plist_access( e );
+	for( cr = ccl->ranges; cr < ccl->ranges + ccl->count; cr++ )
 		cnt += ( cr->end - cr->begin ) + 1;
-	}
 
 	return cnt;
 }
@@ -134,7 +253,6 @@ in error case.
 pccl* p_ccl_dup( pccl* ccl )
 {
 	pccl* 		dup;
-	plistel*	e;
 
 	if( !ccl )
 	{
@@ -145,31 +263,33 @@ pccl* p_ccl_dup( pccl* ccl )
 	/* Create new, empty ccl */
 	dup = p_ccl_create( ccl->min, ccl->max, (char*)NULL );
 
-	/* Copy elements */
-	plist_for( ccl->ranges, e )
-		plist_push( dup->ranges, plist_access( e ) );
+	/* Copy ranges and bitmap */
+	p_ccl_grow( dup, ccl->count );
+
+	if( ccl->count )
+		memcpy( dup->ranges, ccl->ranges, ccl->count * sizeof( pcrange ) );
+
+	dup->count = ccl->count;
+	memcpy( dup->map, ccl->map, sizeof( ccl->map ) );
 
 	return dup;
 }
 
 /* Normalizes a pre-parsed or modified character-class.
 
-Normalization means, that duplicate elements will be removed, the range pairs
-are sorted and intersections are resolved. The result is a unique, normalized
-character-class to be used for further operations.
+Normalization means, that the range pairs are sorted, and duplicate,
+overlapping or touching ranges are merged. The result is a unique, normalized
+character-class to be used for further operations, and its bitmap is
+updated.
 
 //ccl// is the character-class to be normalized.
 
-Returns the number of cycles used for normalization.
+Returns the number of ranges after normalization.
 */
 static int p_ccl_normalize( pccl* ccl )
 {
-	plistel*	e;
-	pcrange*	l;
-	pcrange*	r;
-	int			count		= 0;
-	int			oldcount	= 0;
-	int			cycles		= 0;
+	int			i;
+	int			cnt;
 
 	PROC( "p_ccl_normalize" );
 	PARMS( "ccl", "%p", ccl );
@@ -180,44 +300,18 @@ static int p_ccl_normalize( pccl* ccl )
 		RETURN( -1 );
 	}
 
-	do
+	if( ( cnt = ccl->count ) )
 	{
-		oldcount = count;
-
-		/* First sort the character ranges */
-		plist_sort( ccl->ranges );
-
-		/* Then, find intersections and... */
-		for( e = plist_first( ccl->ranges ); e; )
-		{
-			l = (pcrange*)plist_access( e );
-
-			if( ( r = (pcrange*)plist_access( plist_next( e ) ) ) )
-			{
-				if( r->begin <= l->end && r->end >= l->begin )
-				{
-					if( r->end > l->end )
-						l->end = r->end;
-
-					plist_remove( ccl->ranges, plist_next( e ) );
-					continue;
-				}
-				else if( l->end + 1 == r->begin )
-				{
-					l->end = r->end;
-					plist_remove( ccl->ranges, plist_next( e ) );
-					continue;
-				}
-			}
+		qsort( ccl->ranges, cnt, sizeof( pcrange ), ccl_SORTFUNC );
 
-			e = plist_next( e );
-		}
-
-		cycles++;
+		/* Merge the sorted ranges in place */
+		for( ccl->count = 1, i = 1; i < cnt; i++ )
+			p_ccl_append( ccl, ccl->ranges[ i ].begin, ccl->ranges[ i ].end );
 	}
-	while( ( count = p_ccl_size( ccl ) ) != oldcount );
 
-	RETURN( cycles );
+	p_ccl_setmap( ccl );
+
+	RETURN( ccl->count );
 }
 
 /** Tests a character-class to match a character range.
@@ -230,8 +324,7 @@ Returns TRUE if the entire character range matches the class, and FALSE if not.
 */
 pboolean p_ccl_testrange( pccl* ccl, wchar_t begin, wchar_t end )
 {
-	pcrange*	cr;
-	plistel*	e;
+	int		i;
 
 	if( !( ccl ) )
 	{
@@ -239,13 +332,9 @@ pboolean p_ccl_testrange( pccl* ccl, wchar_t begin, wchar_t end )
 		return FALSE;
 	}
 
-	for( e = plist_first( ccl->ranges ); e; e = plist_next( e ) )
-	{
-		cr = (pcrange*)plist_access( e );
-
-		if( begin >= cr->begin && end <= cr->end )
-			return TRUE;
-	}
+	if( ( i = p_ccl_find( ccl, begin ) ) < ccl->count
+			&& begin >= ccl->ranges[ i ].begin && end <= ccl->ranges[ i ].end )
+		return TRUE;
 
 	return FALSE;
 }
@@ -255,12 +344,22 @@ pboolean p_ccl_testrange( pccl* ccl, wchar_t begin, wchar_t end )
 //ccl// is the pointer to character-class to be tested.
 //ch// is the character to be tested.
 
-The function is a shortcut for p_ccl_testrange().
+The function is a shortcut for p_ccl_testrange(), but answers tests for the
+characters 0-255 from the bitmap of the character-class.
 
 It returns TRUE, if the character matches the class, and FALSE if not.
 */
 pboolean p_ccl_test( pccl* ccl, wchar_t ch )
 {
+	if( !ccl )
+	{
+		WRONGPARAM;
+		return FALSE;
+	}
+
+	if( (unsigned int)ch <= 0xFF )
+		return PCCL_MAPTEST( ccl, ch ) ? TRUE : FALSE;
+
 	return p_ccl_testrange( ccl, ch, ch );
 }
 
@@ -316,36 +415,14 @@ static pboolean p_ccl_ADDRANGE( pccl* ccl, wchar_t begin, wchar_t end )
 		RETURN( FALSE );
 	}
 
-	if( begin > end )
-	{
-		cr.begin = end;
-		cr.end = begin;
-	}
-	else
-	{
-		cr.begin = begin;
-		cr.end = end;
-	}
-
-	if( cr.begin < ccl->min )
-		cr.begin = ccl->min;
-
-	if( cr.end > ccl->max )
-		cr.end = ccl->max;
-
-	if( p_ccl_testrange( ccl, cr.begin, cr.end ) )
-	{
-		MSG( "Range already in character-class" );
-		RETURN( TRUE );
-	}
-
-	if( cr.begin > ccl->max || cr.end < ccl->min )
+	if( !p_ccl_clip( ccl, &cr, begin, end ) )
 	{
 		MSG( "Character-range not in the universe of character-class" );
 		RETURN( FALSE );
 	}
 
-	plist_push( ccl->ranges, (void*)&cr );
+	p_ccl_grow( ccl, ccl->count + 1 );
+	ccl->ranges[ ccl->count++ ] = cr;
 
 	RETURN( TRUE );
 }
@@ -362,15 +439,41 @@ If //begin// is greater than //end//, the values will be swapped.
 */
 pboolean p_ccl_addrange( pccl* ccl, wchar_t begin, wchar_t end )
 {
+	pcrange		cr;
+	int			i;
+	int			j;
+
 	PROC( "p_ccl_addrange" );
 	PARMS( "ccl", "%p", ccl );
 	PARMS( "begin", "%d", begin );
 	PARMS( "end", "%d", end );
 
-	if( !p_ccl_ADDRANGE( ccl, begin, end ) )
+	if( !( ccl ) )
+	{
+		WRONGPARAM;
 		RETURN( FALSE );
+	}
+
+	if( !p_ccl_clip( ccl, &cr, begin, end ) )
+	{
+		MSG( "Character-range not in the universe of character-class" );
+		RETURN( FALSE );
+	}
+
+	/* Merge all ranges overlapping or touching the new one */
+	for( i = j = p_ccl_find( ccl, (int)cr.begin - 1 );
+			j < ccl->count && (int)ccl->ranges[ j ].begin <= (int)cr.end + 1;
+				j++ )
+	{
+		if( ccl->ranges[ j ].begin < cr.begin )
+			cr.begin = ccl->ranges[ j ].begin;
+		if( ccl->ranges[ j ].end > cr.end )
+			cr.end = ccl->ranges[ j ].end;
+	}
+
+	p_ccl_splice( ccl, i, j, &cr, 1 );
+	p_ccl_setmap( ccl );
 
-	p_ccl_normalize( ccl );
 	RETURN( TRUE );
 }
 
@@ -395,9 +498,11 @@ pboolean p_ccl_add( pccl* ccl, wchar_t ch )
 */
 pboolean p_ccl_delrange( pccl* ccl, wchar_t begin, wchar_t end )
 {
-	plistel*	e;
 	pcrange		d;
-	pcrange*	r;
+	pcrange		keep	[ 2 ];
+	int			cnt		= 0;
+	int			i;
+	int			j;
 
 	PROC( "p_ccl_delrange" );
 	PARMS( "ccl", "%p", ccl );
@@ -421,54 +526,35 @@ pboolean p_ccl_delrange( pccl* ccl, wchar_t begin, wchar_t end )
 		d.end = end;
 	}
 
-	/* Which elements do match? */
-	do
-	{
-		for( e = plist_first( ccl->ranges ); e; e = plist_next( e ) )
-		{
-			r = (pcrange*)plist_access( e );
+	/* Which ranges do match? */
+	for( i = j = p_ccl_find( ccl, d.begin );
+			j < ccl->count && ccl->ranges[ j ].begin <= d.end; j++ )
+		;
 
-			if( d.begin <= r->end && end >= r->begin )
-			{
-				/* Slitting required? */
-				if( d.begin > r->begin && d.end < r->end )
-				{
-					MSG( "Split current range" );
-					end = r->end;
-					r->end = d.begin - 1;
-
-					if( !p_ccl_addrange( ccl, d.end + 1, end ) )
-						RETURN( FALSE );
+	if( i == j )
+	{
+		MSG( "No range affected" );
+		RETURN( TRUE );
+	}
 
-					break;
-				}
-				/* Move the end */
-				else if( d.begin > r->begin )
-				{
-					MSG( "Move end of current range" );
-					r->end = d.begin - 1;
-				}
-				/* Move the begin */
-				else if( d.end < r->end )
-				{
-					MSG( "Change begin of current range" );
-					r->begin = d.end + 1;
-				}
-				/* Remove entire range */
-				else
-				{
-					MSG( "Remove entire range" );
-					plist_remove( ccl->ranges, e );
+	/* Keep the parts of the first and last range outside of d */
+	if( ccl->ranges[ i ].begin < d.begin )
+	{
+		MSG( "Keep begin of first range" );
+		keep[ cnt ].begin = ccl->ranges[ i ].begin;
+		keep[ cnt++ ].end = d.begin - 1;
+	}
 
-					e = plist_first( ccl->ranges );
-					break;
-				}
-			}
-		}
+	if( ccl->ranges[ j - 1 ].end > d.end )
+	{
+		MSG( "Keep end of last range" );
+		keep[ cnt ].begin = d.end + 1;
+		keep[ cnt++ ].end = ccl->ranges[ j - 1 ].end;
 	}
-	while( e );
 
-	p_ccl_normalize( ccl );
+	p_ccl_splice( ccl, i, j, keep, cnt );
+	p_ccl_setmap( ccl );
+
 	RETURN( TRUE );
 }
 
@@ -492,11 +578,10 @@ Returns a pointer to //ccl//.
 */
 pccl* p_ccl_negate( pccl* ccl )
 {
-	wchar_t		start;
-	wchar_t		end;
-	plistel*	e;
-	plistel*	ne;
-	pcrange*	r;
+	pcrange*	ranges;
+	int			cnt;
+	int			i;
+	int			start;
 
 	PROC( "p_ccl_negate" );
 	PARMS( "ccl", "%p", ccl );
@@ -507,32 +592,26 @@ pccl* p_ccl_negate( pccl* ccl )
 		RETURN( (pccl*)NULL );
 	}
 
-	start = end = ccl->min;
+	ranges = ccl->ranges;
+	cnt = ccl->count;
 
-	for( e = plist_first( ccl->ranges ); e; e = ne )
-	{
-		r = (pcrange*)plist_access( e );
-		ne = plist_next( e );
+	ccl->ranges = (pcrange*)NULL;
+	ccl->count = ccl->size = 0;
 
-		if( end < r->begin )
-		{
-			start = r->begin;
-			r->begin = end;
+	/* Collect the gaps between the ranges */
+	for( start = ccl->min, i = 0; i < cnt; i++ )
+	{
+		if( start < ranges[ i ].begin )
+			p_ccl_append( ccl, start, ranges[ i ].begin - 1 );
 
-			end = r->end + 1;
-			r->end = start - 1;
-		}
-		else
-		{
-			end = r->end + 1;
-			plist_remove( ccl->ranges, e );
-		}
+		start = ranges[ i ].end + 1;
 	}
 
-	if( end < ccl->max )
-		p_ccl_addrange( ccl, end, ccl->max );
+	if( start <= ccl->max )
+		p_ccl_append( ccl, start, ccl->max );
 
-	p_ccl_normalize( ccl );
+	pfree( ranges );
+	p_ccl_setmap( ccl );
 
 	RETURN( ccl );
 }
@@ -549,8 +628,9 @@ if //ccl// and //add//.
 pccl* p_ccl_union( pccl* ccl, pccl* add )
 {
 	pccl*		un;
-	plistel*	e;
 	pcrange*	r;
+	int			i		= 0;
+	int			j		= 0;
 
 	PROC( "p_ccl_union" );
 	PARMS( "ccl", "%p", ccl );
@@ -568,17 +648,22 @@ pccl* p_ccl_union( pccl* ccl, pccl* add )
 		RETURN( (pccl*)NULL );
 	}
 
-	un = p_ccl_dup( ccl );
+	un = p_ccl_create( ccl->min, ccl->max, (char*)NULL );
+	p_ccl_grow( un, ccl->count + add->count );
 
-	for( e = plist_first( add->ranges ); e; e = plist_next( e ) )
+	/* Merge both range arrays by their begin */
+	while( i < ccl->count || j < add->count )
 	{
-		r = (pcrange*)plist_access( e );
+		if( j == add->count || ( i < ccl->count
+				&& ccl->ranges[ i ].begin <= add->ranges[ j ].begin ) )
+			r = ccl->ranges + i++;
+		else
+			r = add->ranges + j++;
 
-		if( !p_ccl_ADDRANGE( un, r->begin, r->end ) )
-			RETURN( FALSE );
+		p_ccl_append( un, r->begin, r->end );
 	}
 
-	p_ccl_normalize( un );
+	p_ccl_setmap( un );
 
 	RETURN( un );
 }
@@ -597,9 +682,12 @@ error.
 */
 pccl* p_ccl_diff( pccl* ccl, pccl* rem )
 {
-	plistel*	e;
-	pcrange*	r;
 	pccl*		diff;
+	int			begin;
+	int			end;
+	int			i;
+	int			j		= 0;
+	int			k;
 
 	PROC( "p_ccl_diff" );
 	PARMS( "ccl", "%p", ccl );
@@ -617,16 +705,34 @@ pccl* p_ccl_diff( pccl* ccl, pccl* rem )
 		RETURN( (pccl*)NULL );
 	}
 
-	if( !( diff = p_ccl_dup( ccl ) ) )
-		return (pccl*)NULL;
+	diff = p_ccl_create( ccl->min, ccl->max, (char*)NULL );
 
-	for( e = plist_first( rem->ranges ); e; e = plist_next( e ) )
+	for( i = 0; i < ccl->count; i++ )
 	{
-		r = (pcrange*)plist_access( e );
-		p_ccl_delrange( diff, r->begin, r->end );
+		begin = ccl->ranges[ i ].begin;
+		end = ccl->ranges[ i ].end;
+
+		/* Skip ranges of rem that end before this range */
+		while( j < rem->count && rem->ranges[ j ].end < begin )
+			j++;
+
+		/* Cut out all ranges of rem overlapping this range */
+		for( k = j; k < rem->count && rem->ranges[ k ].begin <= end
+					&& begin <= end; k++ )
+		{
+			if( rem->ranges[ k ].begin > begin )
+				p_ccl_append( diff, begin, rem->ranges[ k ].begin - 1 );
+
+			begin = rem->ranges[ k ].end + 1;
+		}
+
+		if( begin <= end )
+			p_ccl_append( diff, begin, end );
 	}
 
-	return diff;
+	p_ccl_setmap( diff );
+
+	RETURN( diff );
 }
 
 /** Checks for differences in two character-classes.
@@ -639,10 +745,9 @@ equal to //right// or a value > 0 if //left// is greater than //right//.
 */
 int p_ccl_compare( pccl* left, pccl* right )
 {
-	plistel*	e;
-	plistel*	f;
 	pcrange*	l;
 	pcrange*	r;
+	int			i;
 	int			ret		= 0;
 
 	PROC( "p_ccl_compare" );
@@ -668,11 +773,10 @@ int p_ccl_compare( pccl* left, pccl* right )
 	}
 
 	MSG( "Deep check all ranges" );
-	for( e = plist_first( left->ranges ), f = plist_first( right->ranges );
-			e && f; e = plist_next( e ), f = plist_next( f ) )
+	for( i = 0; i < left->count; i++ )
 	{
-		l = (pcrange*)plist_access( e );
-		r = (pcrange*)plist_access( f );
+		l = left->ranges + i;
+		r = right->ranges + i;
 
 		if( !( l->begin == r->begin && l->end == r->end ) )
 		{
@@ -697,11 +801,11 @@ the function returns (pccl*)NULL.
 */
 pccl* p_ccl_intersect( pccl* ccl, pccl* within )
 {
-	plistel*	e;
-	plistel*	f;
 	pcrange*	r;
 	pcrange*	s;
-	pccl*		in	= (pccl*)NULL;
+	int			i		= 0;
+	int			j		= 0;
+	pccl*		in		= (pccl*)NULL;
 
 	PROC( "p_ccl_intersect" );
 	PARMS( "ccl", "%p", ccl );
@@ -719,31 +823,30 @@ pccl* p_ccl_intersect( pccl* ccl, pccl* within )
 		RETURN( (pccl*)NULL );
 	}
 
-	for( e = plist_first( ccl->ranges ); e; e = plist_next( e ) )
+	while( i < ccl->count && j < within->count )
 	{
-		r = (pcrange*)plist_access( e );
+		r = ccl->ranges + i;
+		s = within->ranges + j;
 
-		for( f = plist_first( within->ranges ); f; f = plist_next( f ) )
+		if( s->begin <= r->end && s->end >= r->begin )
 		{
-			s = (pcrange*)plist_access( f );
+			if( !in )
+				in = p_ccl_create( ccl->min, ccl->max, (char*)NULL );
 
-			if( s->begin <= r->end && s->end >= r->begin )
-			{
-				if( !in )
-					in = p_ccl_create( ccl->min, ccl->max, (char*)NULL );
-
-				p_ccl_addrange( in,
-					( r->begin > s->begin ) ? r->begin : s->begin,
-					( r->end > s->end ) ? s->end : r->end );
-			}
+			p_ccl_append( in,
+				( r->begin > s->begin ) ? r->begin : s->begin,
+				( r->end > s->end ) ? s->end : r->end );
 		}
+
+		/* Advance the range that ends first */
+		if( r->end < s->end )
+			i++;
+		else
+			j++;
 	}
 
 	if( in )
-	{
-		MSG( "Normalizing" );
-		p_ccl_normalize( in );
-	}
+		p_ccl_setmap( in );
 
 	RETURN( in );
 }
@@ -763,7 +866,6 @@ returns FALSE, meaning that the end of the characters is reached.
 On success, the function will always return TRUE. */
 pboolean p_ccl_get( wchar_t* from, wchar_t* to, pccl* ccl, int offset )
 {
-	plistel*	e;
 	pcrange*	cr;
 
 	PROC( "p_ccl_get" );
@@ -782,10 +884,8 @@ pboolean p_ccl_get( wchar_t* from, wchar_t* to, pccl* ccl, int offset )
 	{
 		MSG( "Single-character retrival" );
 
-		for( e = plist_first( ccl->ranges ); e; e = plist_next( e ) )
+		for( cr = ccl->ranges; cr < ccl->ranges + ccl->count; cr++ )
 		{
-			cr = (pcrange*)plist_access( e );
-
 			VARS( "offset", "%d", offset );
 			VARS( "cr->begin", "%d", cr->begin );
 			VARS( "cr->end", "%d", cr->end );
@@ -797,7 +897,7 @@ pboolean p_ccl_get( wchar_t* from, wchar_t* to, pccl* ccl, int offset )
 				MSG( "Offset not in this range" );
 				offset -= ( cr->end - cr->begin ) + 1;
 			}
-			else if( offset < ( cr->end - cr->begin ) + 1 )
+			else
 			{
 				MSG( "Offset is within this class" );
 
@@ -812,9 +912,10 @@ pboolean p_ccl_get( wchar_t* from, wchar_t* to, pccl* ccl, int offset )
 	{
 		MSG( "Range retrival" );
 
-		if( ( cr = (pcrange*)plist_access(
-						plist_get( ccl->ranges, offset ) ) ) )
+		if( offset < ccl->count )
 		{
+			cr = ccl->ranges + offset;
+
 			*from = cr->begin;
 			*to = cr->end;
 
@@ -1113,7 +1214,10 @@ pboolean p_ccl_erase( pccl* ccl )
 		return FALSE;
 	}
 
-	return plist_erase( ccl->ranges );
+	ccl->count = 0;
+	memset( ccl->map, 0, sizeof( ccl->map ) );
+
+	return TRUE;
 }
 
 /** Frees a character-class //ccl// and all its used memory.
@@ -1125,7 +1229,7 @@ pccl* p_ccl_free( pccl* ccl )
 	if( !ccl )
 		return (pccl*)NULL;
 
-	plist_free( ccl->ranges );
+	pfree( ccl->ranges );
 	pfree( ccl->str );
 
 	pfree( ccl );
@@ -1148,7 +1252,6 @@ character-class handling functions, so it should not be freed manually.
 */
 char* p_ccl_to_str( pccl* ccl, pboolean escape )
 {
-	plistel*	e;
 	pcrange*	r;
 	char		from	[ 40 + 1 ];
 	char		to		[ 20 + 1 ];
@@ -1165,10 +1268,8 @@ char* p_ccl_to_str( pccl* ccl, pboolean escape )
 
 	ccl->str = pfree( ccl->str );
 
-	for( e = plist_first( ccl->ranges ); e; e = plist_next( e ) )
+	for( r = ccl->ranges; r < ccl->ranges + ccl->count; r++ )
 	{
-		r = (pcrange*)plist_access( e );
-
 		if( escape )
 			u8_escape_wchar( from, sizeof( from ), r->begin );
 		else
@@ -1206,7 +1307,6 @@ left (FILE*)NULL, so //stderr// will be used.
 */
 void p_ccl_print( FILE* stream, pccl* ccl, int break_after )
 {
-	plistel*	e;
 	pcrange*	r;
 	int			cnt;
 	char		outstr[ 2 ] [ 10 + 1 ];
@@ -1220,11 +1320,8 @@ void p_ccl_print( FILE* stream, pccl* ccl, int break_after )
 	if( break_after < 0 )
 		fprintf( stream, "*** begin of ccl %p ***\n", ccl );
 
-	for( e = plist_first( ccl->ranges ), cnt = 0;
-			e; e = plist_next( e ), cnt++ )
+	for( r = ccl->ranges, cnt = 0; r < ccl->ranges + ccl->count; r++, cnt++ )
 	{
-		r = (pcrange*)plist_access( e );
-
 		u8_toutf8( outstr[0], sizeof( outstr[0] ), &( r->begin ), 1 );
 
 		if( r->begin != r->end )
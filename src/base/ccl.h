@@ -17,6 +17,9 @@ Usage:	Implements functions for Unicode-enabled character-class handling.
 #define PCCL_MAX			0xFF
 #endif
 
+#define PCCL_MAPTEST( ccl, ch ) \
+	( (ccl)->map[ (ch) >> 3 ] & ( 1 << ( (ch) & 7 ) ) )
+
 typedef struct
 {
 	wchar_t			begin;
@@ -28,7 +31,11 @@ typedef struct
 	int				min;
 	int				max;
 
-	plist*			ranges;
+	pcrange*		ranges;		/* Sorted, disjoint ranges */
+	int				count;		/* Number of ranges */
+	int				size;		/* Number of allocated ranges */
+
+	unsigned char	map			[ 32 ];	/* Bitmap of characters 0-255 */
 
 	char*			str;
 } pccl;
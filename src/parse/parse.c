@@ -215,7 +215,8 @@ static void print_stack( char* title, parray* stack )
 }
 #endif
 
-static ppsym* pp_par_scan( pppar* p, char** start, char** end, pboolean lazy )
+static ppsym* pp_par_scan( pppar* p, char** start, char** end, char* stop,
+								pboolean lazy )
 {
 	ppsym*			sym;
 	unsigned int	id;
@@ -224,8 +225,9 @@ static ppsym* pp_par_scan( pppar* p, char** start, char** end, pboolean lazy )
 
 	while( TRUE )
 	{
-		if( ( !lazy && ( id = plex_lex( p->lex, *start, end ) ) )
-			|| ( lazy && ( *start = plex_next( p->lex, *start, &id, end ) ) ) )
+		if( ( !lazy && ( id = plex_lex_n( p->lex, *start, stop, end ) ) )
+			|| ( lazy && ( *start = plex_next_n( p->lex, *start, stop,
+													&id, end ) ) ) )
 		{
 			sym = p->tokens[ id - 1 ];
 
@@ -251,6 +253,16 @@ Currently, the used parsing method is only LALR(1).
 
 It returns an abstract syntax tree to //root// on success. */
 pboolean pp_par_parse( ppast** root, pppar* par, char* start )
+{
+	return pp_par_parse_n( root, par, start, (char*)NULL );
+}
+
+/** Run parser //p// with input //start//, which ends at //stop//.
+
+This works like pp_par_parse(), but the input doesn't need to be
+zero-terminated, and may contain zero-bytes. If //stop// is (char*)NULL, the
+input is zero-terminated. */
+pboolean pp_par_parse_n( ppast** root, pppar* par, char* start, char* stop )
 {
 	int			i;
 	int			row		= 1;
@@ -269,7 +281,7 @@ pboolean pp_par_parse( ppast** root, pppar* par, char* start )
 	ppast*		node;
 	pboolean	lazy	= TRUE;
 
-	PROC( "pp_par_parse" );
+	PROC( "pp_par_parse_n" );
 
 	if( !( par && start ) )
 	{
@@ -279,7 +291,8 @@ pboolean pp_par_parse( ppast** root, pppar* par, char* start )
 
 	PARMS( "root", "%p", root );
 	PARMS( "par", "%p", par );
-	PARMS( "start", "%s", start );
+	PARMS( "start", "%p", start );
+	PARMS( "stop", "%p", stop );
 
 	/* Init */
 	if( par->lex )
@@ -302,7 +315,7 @@ pboolean pp_par_parse( ppast** root, pppar* par, char* start )
 
 	/* Read token */
 	lend = end = start;
-	sym = pp_par_scan( par, &start, &end, lazy );
+	sym = pp_par_scan( par, &start, &end, stop, lazy );
 
 	do
 	{
@@ -337,8 +350,8 @@ pboolean pp_par_parse( ppast** root, pppar* par, char* start )
 		{
 			/* Parse Error */
 			/* TODO: Error Recovery */
-			fprintf( stderr, "Parse Error [line:%d col:%d] @ >%s<\n",
-				row, col, end );
+			fprintf( stderr, "Parse Error [line:%d col:%d] @ >%.*s<\n",
+				row, col, (int)( stop ? stop - end : strlen( end ) ), end );
 
 			MSG( "Parsing failed" );
 			RETURN( FALSE );
@@ -372,7 +385,7 @@ pboolean pp_par_parse( ppast** root, pppar* par, char* start )
 
 			/* Read next token */
 			lend = start = end;
-			sym = pp_par_scan( par, &start, &end, lazy );
+			sym = pp_par_scan( par, &start, &end, stop, lazy );
 		}
 
 		/* Reduce */
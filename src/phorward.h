@@ -24,6 +24,7 @@ Usage:	Phorward Foundation Toolkit Global Header
 #include <string.h>
 #include <ctype.h>
 #include <limits.h>
+#include <stdint.h>
 
 #ifdef UTF8
 #include <wchar.h>
@@ -281,6 +282,9 @@ struct Plist
 #define PCCL_MAX			0xFF
 #endif
 
+#define PCCL_MAPTEST( ccl, ch ) \
+	( (ccl)->map[ (ch) >> 3 ] & ( 1 << ( (ch) & 7 ) ) )
+
 typedef struct
 {
 	wchar_t			begin;
@@ -292,7 +296,11 @@ typedef struct
 	int				min;
 	int				max;
 
-	plist*			ranges;
+	pcrange*		ranges;		/* Sorted, disjoint ranges */
+	int				count;		/* Number of ranges */
+	int				size;		/* Number of allocated ranges */
+
+	unsigned char	map			[ 32 ];	/* Bitmap of characters 0-255 */
 
 	char*			str;
 } pccl;
@@ -385,6 +393,17 @@ typedef struct
 
 #define PREGEX_ALLOC_STEP		16
 #define PREGEX_MAXREF			32
+#define PREGEX_SEARCH_MAXSTATES	1024
+#define PREGEX_SEARCH_MINSKIP	8
+#define PREGEX_LAZY_MAXSTATES	512
+#define PREGEX_LAZY_BUCKETS		256
+#define PREGEX_LAZY_MINCHARS	( 2 * PREGEX_LAZY_MAXSTATES )
+#define PREGEX_BITNFA_MAXWORDS	4
+#define PREGEX_IMAGE_MAGIC		"phxregex"
+#define PREGEX_IMAGE_VERSION	3
+#define PREGEX_STREAM_BUFSIZE	65536
+#define PREGEX_PARALLEL_MINCHUNK	65536
+#define PREGEX_PARALLEL_MINRECORDS	1024
 
 
 
@@ -397,6 +416,9 @@ typedef struct
 #define PREGEX_COMP_INSENSITIVE	0x20	
 #define PREGEX_COMP_STATIC		0x40	
 #define PREGEX_COMP_PTN			0x80	
+#define PREGEX_COMP_LAZY		0x4000	
+#define PREGEX_COMP_BITNFA		0x8000	
+#define PREGEX_COMP_UTF8		0x10000	
 
 
 #define PREGEX_RUN_WCHAR		0x100	
@@ -405,6 +427,8 @@ typedef struct
 #define PREGEX_RUN_NOREF		0x800	
 #define PREGEX_RUN_NONGREEDY	0x1000	
 #define PREGEX_RUN_DEBUG		0x2000 	
+#define PREGEX_RUN_NOTBOL		0x20000	
+#define PREGEX_RUN_NOTBOW		0x40000	
 
 
 #define PREGEX_FLAG_NONE		0x00	
@@ -413,6 +437,22 @@ typedef struct
 #define PREGEX_FLAG_BOW			0x04	
 #define PREGEX_FLAG_EOW			0x08	
 #define PREGEX_FLAG_NONGREEDY	0x10	
+#define PREGEX_FLAG_FALLBACK	0x20	
+#define PREGEX_FLAG_ANCHORS		( PREGEX_FLAG_BOL | PREGEX_FLAG_EOL \
+									| PREGEX_FLAG_BOW | PREGEX_FLAG_EOW )
+
+
+#define PREGEX_ANCHOR_LINE		0	
+#define PREGEX_ANCHOR_WORD		1	
+#define PREGEX_ANCHOR_OTHER		2	
+#define PREGEX_ANCHOR_CLASSES	3
+
+
+#define PREGEX_SEARCH_ENDED		0x100	
+#define PREGEX_SEARCH_ATEOF		0x200	
+#define PREGEX_SEARCH_CLASSES	0x400	
+#define PREGEX_SEARCH_IDLE		0x800	
+#define PREGEX_SEARCH_BEGINS( cls )	( 0x1000 << ( cls ) )
 
 
 enum _regex_ptntype
@@ -430,10 +470,19 @@ enum _regex_ptntype
 
 typedef struct	_regex_nfa_st	pregex_nfa_st;
 typedef struct	_regex_nfa		pregex_nfa;
+typedef struct	_regex_nfa_set	pregex_nfa_set;
 
 typedef struct	_regex_dfa_tr	pregex_dfa_tr;
 typedef struct	_regex_dfa_st	pregex_dfa_st;
 typedef struct	_regex_dfa		pregex_dfa;
+typedef struct	_regex_dense	pregex_dense;
+typedef struct	_regex_comb		pregex_comb;
+typedef struct	_regex_accel	pregex_accel;
+typedef struct	_regex_search	pregex_search;
+typedef struct	_regex_lazy_st	pregex_lazy_st;
+typedef struct	_regex_lazy		pregex_lazy;
+typedef struct	_regex_bitnfa	pregex_bitnfa;
+typedef struct	_regex_image	pregex_image;
 
 typedef enum 	_regex_ptntype	pregex_ptntype;
 typedef struct	_regex_ptn		pregex_ptn;
@@ -441,6 +490,10 @@ typedef struct	_regex_ptn		pregex_ptn;
 typedef struct	_range			prange;
 typedef struct	_regex			pregex;
 typedef struct	_lex			plex;
+typedef struct	_lex_stream		plex_stream;
+typedef struct	_regex_iter		pregex_iter;
+
+typedef int (*plex_readfn)( void* user, char* buf, size_t size );
 
 
 
@@ -455,6 +508,8 @@ struct _regex_nfa_st
 	unsigned int	accept;		
 	int				flags;		
 	int				refs;		
+
+	int				id;			
 };
 
 
@@ -462,8 +517,26 @@ struct _regex_nfa
 {
 	plist*			states;		
 	int				modifiers;	
+
+	int				cnt;		
+	pregex_nfa_st**	index;		
+};
+
+
+struct _regex_nfa_set
+{
+	int				cnt;		
+	int*			dense;		
+	int*			sparse;		
 };
 
+#define pregex_nfa_set_has( set, i ) \
+	( (set)->sparse[ i ] < (set)->cnt \
+		&& (set)->dense[ (set)->sparse[ i ] ] == ( i ) )
+
+#define pregex_nfa_set_add( set, i ) \
+	( (set)->dense[ (set)->sparse[ i ] = (set)->cnt++ ] = ( i ) )
+
 
 struct _regex_dfa_tr
 {
@@ -479,6 +552,7 @@ struct _regex_dfa_st
 
 	unsigned int	accept;		
 	int				flags;		
+	int*			fallback;	
 	int				refs;		
 };
 
@@ -489,6 +563,128 @@ struct _regex_dfa
 };
 
 
+#define pregex_dfatab_fallback( row ) \
+	( (row)[ 2 ] & PREGEX_FLAG_FALLBACK ? 1 + (row)[ (row)[ 0 ] ] * 2 : 0 )
+
+
+struct _regex_accel
+{
+	char			stay		[ 256 ];
+								
+	int				cnt;		
+	char			leave		[ 3 ];
+								
+};
+
+
+#define PREGEX_COMB_PAGES		( ( PCCL_MAX + 1 ) / 256 )
+
+struct _regex_comb
+{
+	int				classes;	
+	int				blocks;		
+	int				rows;		
+	int				size;		
+	size_t			bytes;		
+
+	int*			base;		
+	uint16_t*		page;		
+	uint16_t*		map;		
+	uint16_t*		row;		
+	uint16_t*		def;		
+	uint16_t*		tmpl;		
+	uint16_t*		next;		
+	uint16_t*		check;		
+};
+
+
+struct _regex_dense
+{
+	int				states;		
+	int				classes;	
+
+	unsigned char	map			[ 256 ];
+								
+	uint16_t*		trans;		
+	pregex_accel**	accel;		
+	unsigned char**	tags;		
+	pregex_comb*	comb;		
+};
+
+
+struct _regex_search
+{
+	int				flags;		
+
+	int				trans_cnt;	
+	wchar_t**		trans;		
+	pregex_dense*	dense;		
+
+	int				rtrans_cnt;	
+	wchar_t**		rtrans;		
+	pregex_dense*	rdense;		
+
+	int				btrans_cnt;	
+	wchar_t**		btrans;		
+	pregex_dense*	bdense;		
+};
+
+
+struct _regex_lazy_st
+{
+	int*			set;		
+	int				cnt;		
+	unsigned int	hash;		
+	int				next;		
+
+	unsigned int	accept;		
+	int				flags;		
+	int*			fallback;	
+	int				refs;		
+
+	int				trans		[ 256 ];
+								
+};
+
+
+struct _regex_lazy
+{
+	pregex_nfa*		nfa;		
+
+	pregex_lazy_st*	states;		
+	int				states_cnt;	
+	int				buckets		[ PREGEX_LAZY_BUCKETS ];
+								
+	int				flushes;	
+
+	pregex_nfa_set*	work;		
+};
+
+
+struct _regex_bitnfa
+{
+	int				positions;	
+	int				words;		
+
+	uint64_t*		follow;		
+	uint64_t*		last;		
+	pboolean		nullable;	
+	uint64_t*		mask;		
+	pccl**			ccl;		
+
+	unsigned int	accept;		
+	int				flags;		
+};
+
+
+struct _regex_image
+{
+	char*			data;		
+	size_t			size;		
+	pboolean		mapped;		
+};
+
+
 
 struct _regex_ptn
 {
@@ -522,6 +718,14 @@ struct _regex
 
 	int				trans_cnt;	
 	wchar_t**		trans;		
+	pregex_dense*	dense;		
+	pregex_search*	search;		
+	pregex_lazy*	lazy;		
+	pregex_bitnfa*	bitnfa;		
+	pregex_image*	image;		
+
+	char*			prefix;		
+	char*			factor;		
 
 	prange			ref			[ PREGEX_MAXREF ];
 };
@@ -535,11 +739,49 @@ struct _lex
 
 	int				trans_cnt;	
 	wchar_t**		trans;		
+	pregex_dense*	dense;		
+	pregex_search*	search;		
+	pregex_lazy*	lazy;		
+	pregex_image*	image;		
 
 	prange			ref			[ PREGEX_MAXREF ];
 };
 
 
+struct _lex_stream
+{
+	plex*			lex;		
+
+	plex_readfn		read;		
+	void*			user;		
+	int				fd;			
+
+	char*			buf;		
+	size_t			size;		
+	size_t			len;		
+	size_t			pos;		
+	size_t			base;		
+	pboolean		eof;		
+	int				prev;		
+
+	size_t			offset;		
+};
+
+
+struct _regex_iter
+{
+	pregex*			regex;		
+	plex*			lex;		
+
+	char*			begin;		
+	char*			ptr;		
+	char*			stop;		
+
+	prange			ref			[ PREGEX_MAXREF ];
+								
+};
+
+
 
 
 
@@ -970,6 +1212,7 @@ pppar* pp_par_free( pppar* p );
 int pp_par_autolex( pppar* p );
 pboolean pp_par_lex( pppar* p, ppsym* sym, char* pat, int flags );
 pboolean pp_par_parse( ppast** root, pppar* par, char* start );
+pboolean pp_par_parse_n( ppast** root, pppar* par, char* start, char* stop );
 
 
 pboolean pp_gram_from_pbnf( ppgram* g, char* src );
@@ -997,32 +1240,90 @@ ppsym* pp_sym_mod_optional( ppsym* sym );
 ppsym* pp_sym_mod_kleene( ppsym* sym );
 
 
+pregex_bitnfa* pregex_bitnfa_create( pregex_ptn* ptn, pboolean refs );
+pregex_bitnfa* pregex_bitnfa_free( pregex_bitnfa* bitnfa );
+pboolean pregex_bitnfa_first( pregex_bitnfa* bitnfa, wchar_t ch );
+int pregex_bitnfa_match( pregex_bitnfa* bitnfa, char* start, char* stop, char** end, int flags );
+
+
 void pregex_dfa_print( pregex_dfa* dfa );
 pregex_dfa* pregex_dfa_create( void );
 pboolean pregex_dfa_reset( pregex_dfa* dfa );
 pregex_dfa* pregex_dfa_free( pregex_dfa* dfa );
 int pregex_dfa_from_nfa( pregex_dfa* dfa, pregex_nfa* nfa );
+int pregex_dfa_from_literals( pregex_dfa* dfa, plist* ptns );
+int pregex_dfa_union( pregex_dfa* dfa, pregex_dfa* left, pregex_dfa* right );
 int pregex_dfa_minimize( pregex_dfa* dfa );
 int pregex_dfa_match( pregex_dfa* dfa, char* str, size_t* len, int* mflags, prange** ref, int* ref_count, int flags );
 int pregex_dfa_to_dfatab( wchar_t*** dfatab, pregex_dfa* dfa );
-
-
+size_t pregex_dfatab_size( wchar_t** dfatab, int states );
+unsigned int pregex_dfatab_accept( wchar_t* row, int i, int* flags );
+int pregex_dfatab_to_utf8( wchar_t*** dfatab, int states );
+char* pregex_accel_skip( pregex_accel* accel, char* ptr, char* stop );
+pregex_dense* pregex_dense_create( wchar_t** dfatab, int states );
+pregex_dense* pregex_dense_free( pregex_dense* dense );
+int pregex_dfatab_next( wchar_t** dfatab, int states, pregex_dense* dense, int state, wchar_t ch );
+int pregex_dfatab_match( wchar_t** dfatab, int states, pregex_dense* dense, char* start, char* stop, char** end, prange* ref, int flags );
+pregex_search* pregex_search_create( wchar_t** dfatab, int states, int flags );
+pboolean pregex_search_backward( pregex_search* search, wchar_t** dfatab, int states );
+pregex_search* pregex_search_free( pregex_search* search );
+pboolean pregex_search_find( pregex_search* search, char* start, char* stop, char* limit, char** mstart, int flags );
+pboolean pregex_search_start( pregex_search* search, char* start, char* stop, char* end, char** mstart, int flags );
+pboolean pregex_search_rfind( pregex_search* search, char* start, char* stop, char** mstart, int flags );
+
+
+void pregex_qcache( size_t size );
+void pregex_qcache_stats( size_t* hits, size_t* misses, size_t* evictions );
 int pregex_qmatch( char* regex, char* str, int flags, parray** matches );
 int pregex_qsplit( char* regex, char* str, int flags, parray** matches );
 char* pregex_qreplace( char* regex, char* str, char* replace, int flags );
 
 
+pregex_image* pregex_image_free( pregex_image* image, int* trans_cnt, pregex_search* search );
+pboolean pregex_save( pregex* regex, char* path );
+pregex* pregex_load( char* path );
+pboolean plex_save( plex* lex, char* path );
+plex* plex_load( char* path );
+
+
+pregex_lazy* pregex_lazy_create( pregex_nfa* nfa );
+pregex_lazy* pregex_lazy_free( pregex_lazy* lazy );
+pboolean pregex_lazy_first( pregex_lazy* lazy, wchar_t ch );
+int pregex_lazy_match( pregex_lazy* lazy, char* start, char* stop, char** end, prange* ref, int flags );
+
+
 plex* plex_create( int flags );
 plex* plex_free( plex* lex );
 pboolean plex_reset( plex* lex );
 pboolean plex_prepare( plex* lex );
 pregex_ptn* plex_define( plex* lex, char* pat, int match_id, int flags );
 int plex_lex( plex* lex, char* start, char** end );
+int plex_lex_n( plex* lex, char* start, char* stop, char** end );
+int plex_lex_r( plex* lex, char* start, char* stop, char** end, prange* ref );
 char* plex_next( plex* lex, char* start, unsigned int* id, char** end );
+char* plex_next_n( plex* lex, char* start, char* stop, unsigned int* id, char** end );
+char* plex_next_r( plex* lex, char* start, char* stop, unsigned int* id, char** end, prange* ref );
+char* plex_next_in( plex* lex, char* begin, char* start, char* stop, unsigned int* id, char** end, prange* ref );
+char* plex_next_before( plex* lex, char* begin, char* start, char* limit, char* stop, unsigned int* id, char** end, prange* ref );
 size_t plex_tokenize( plex* lex, char* start, parray** matches );
+size_t plex_tokenize_n( plex* lex, char* start, char* stop, parray** matches );
+pboolean plex_iter_init( pregex_iter* iter, plex* lex, char* start, char* stop );
+pboolean plex_iter_next( pregex_iter* iter, prange* match );
+pboolean plex_to_c( plex* lex, FILE* f, char* name );
 
 
 pboolean pregex_check_anchors( char* all, char* str, size_t len, int anchors, int flags );
+int pregex_anchor_class( wchar_t ch );
+pboolean pregex_anchor_wide( void );
+int pregex_anchor_before( char* begin, char* ptr, int flags );
+int pregex_anchor_after( char* ptr, char* stop, int flags );
+int pregex_anchor_flags( int cls );
+int pregex_anchor_at( char* begin, char* ptr, int flags );
+pboolean pregex_anchor_test( int anchors, int prev, int next );
+pboolean pregex_anchor_accept( int anchors, char* ptr, char* stop, int flags );
+void pregex_accept_add( unsigned int* st_accept, int* st_flags, int** fallback, unsigned int accept, int flags );
+unsigned int pregex_accept_nth( unsigned int st_accept, int st_flags, int* fallback, int i, int* flags );
+pboolean pregex_getchar( char** ptr, char* stop, wchar_t* ch, int flags );
 
 
 pregex_nfa_st* pregex_nfa_create_state( pregex_nfa* nfa, char* chardef, int flags );
@@ -1030,12 +1331,21 @@ void pregex_nfa_print( pregex_nfa* nfa );
 pregex_nfa* pregex_nfa_create( void );
 pboolean pregex_nfa_reset( pregex_nfa* nfa );
 pregex_nfa* pregex_nfa_free( pregex_nfa* nfa );
-int pregex_nfa_move( pregex_nfa* nfa, plist* hits, wchar_t from, wchar_t to );
-int pregex_nfa_epsilon_closure( pregex_nfa* nfa, plist* closure, unsigned int* accept, int* flags );
+int pregex_nfa_index( pregex_nfa* nfa );
+pregex_nfa_set* pregex_nfa_set_create( int max );
+pregex_nfa_set* pregex_nfa_set_free( pregex_nfa_set* set );
+int pregex_nfa_move( pregex_nfa* nfa, pregex_nfa_set* result, int* ids, int cnt, wchar_t from, wchar_t to );
+int pregex_nfa_epsilon_closure( pregex_nfa* nfa, pregex_nfa_set* closure, unsigned int* accept, int* flags );
 int pregex_nfa_match( pregex_nfa* nfa, char* str, size_t* len, int* mflags, prange** ref, int* ref_count, int flags );
 pboolean pregex_nfa_from_string( pregex_nfa* nfa, char* str, int flags, int acc );
 
 
+int pregex_findall_parallel( pregex* regex, char* start, char* stop, parray** matches, int threads );
+size_t plex_tokenize_parallel( plex* lex, char* start, char* stop, parray** matches, int threads );
+size_t pregex_match_batch( pregex* regex, prange* records, size_t count, prange* results, int threads );
+size_t plex_lex_batch( plex* lex, prange* records, size_t count, prange* results, int threads );
+
+
 pregex_ptn* pregex_ptn_create_char( pccl* ccl );
 pregex_ptn* pregex_ptn_create_string( char* str, int flags );
 pregex_ptn* pregex_ptn_create_sub( pregex_ptn* ptn );
@@ -1046,9 +1356,12 @@ pregex_ptn* pregex_ptn_create_pos( pregex_ptn* ptn );
 pregex_ptn* pregex_ptn_create_opt( pregex_ptn* ptn );
 pregex_ptn* pregex_ptn_create_seq( pregex_ptn* first, ... );
 pregex_ptn* pregex_ptn_dup( pregex_ptn* ptn );
+pregex_ptn* pregex_ptn_reverse( pregex_ptn* ptn );
 pregex_ptn* pregex_ptn_free( pregex_ptn* ptn );
 void pregex_ptn_print( pregex_ptn* ptn, int rec );
 char* pregex_ptn_to_regex( pregex_ptn* ptn );
+pboolean pregex_ptn_to_literals( pregex_ptn* ptn, wchar_t** prefix, wchar_t** factor );
+pboolean pregex_ptn_is_literal( pregex_ptn* ptn );
 pboolean pregex_ptn_to_nfa( pregex_nfa* nfa, pregex_ptn* ptn );
 pboolean pregex_ptn_to_dfa( pregex_dfa* dfa, pregex_ptn* ptn );
 int pregex_ptn_to_dfatab( wchar_t*** dfatab, pregex_ptn* ptn );
@@ -1058,11 +1371,33 @@ pboolean pregex_ptn_parse( pregex_ptn** ptn, char* str, int flags );
 pregex* pregex_create( char* pat, int flags );
 pregex* pregex_free( pregex* regex );
 pboolean pregex_match( pregex* regex, char* start, char** end );
+pboolean pregex_match_n( pregex* regex, char* start, char* stop, char** end );
+pboolean pregex_match_r( pregex* regex, char* start, char* stop, char** end, prange* ref );
 char* pregex_find( pregex* regex, char* start, char** end );
+char* pregex_find_n( pregex* regex, char* start, char* stop, char** end );
+char* pregex_find_r( pregex* regex, char* start, char* stop, char** end, prange* ref );
+char* pregex_find_in( pregex* regex, char* begin, char* start, char* stop, char** end, prange* ref );
+char* pregex_find_before( pregex* regex, char* begin, char* start, char* limit, char* stop, char** end, prange* ref );
+char* pregex_rfind( pregex* regex, char* start, char** end );
+char* pregex_rfind_n( pregex* regex, char* start, char* stop, char** end );
+char* pregex_rfind_r( pregex* regex, char* start, char* stop, char** end, prange* ref );
 int pregex_findall( pregex* regex, char* start, parray** matches );
+int pregex_findall_n( pregex* regex, char* start, char* stop, parray** matches );
 char* pregex_split( pregex* regex, char* start, char** end, char** next );
 int pregex_splitall( pregex* regex, char* start, parray** matches );
+pboolean pregex_iter_init( pregex_iter* iter, pregex* regex, char* start, char* stop );
+pboolean pregex_iter_next( pregex_iter* iter, prange* match );
+pboolean pregex_iter_split( pregex_iter* iter, prange* match );
 char* pregex_replace( pregex* regex, char* str, char* replacement );
+size_t pregex_replace_buf( pregex* regex, char* str, char* replacement, char* buf, size_t size );
+pboolean pregex_replace_file( pregex* regex, char* str, char* replacement, FILE* f );
+
+
+plex_stream* plex_stream_create( plex* lex, plex_readfn read, void* user );
+plex_stream* plex_stream_fd( plex* lex, int fd );
+plex_stream* plex_stream_file( plex* lex, FILE* f );
+plex_stream* plex_stream_free( plex_stream* stream );
+unsigned int plex_stream_next( plex_stream* stream, char** start, char** end );
 
 
 char* pwcs_to_str( wchar_t* str, pboolean freestr );
@@ -21,6 +21,7 @@ Usage:	Template for the general include file for phorward library
 #include <string.h>
 #include <ctype.h>
 #include <limits.h>
+#include <stdint.h>
 
 #ifdef UTF8
 #include <wchar.h>
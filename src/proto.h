@@ -203,6 +203,7 @@ pppar* pp_par_free( pppar* p );
 int pp_par_autolex( pppar* p );
 pboolean pp_par_lex( pppar* p, ppsym* sym, char* pat, int flags );
 pboolean pp_par_parse( ppast** root, pppar* par, char* start );
+pboolean pp_par_parse_n( ppast** root, pppar* par, char* start, char* stop );
 
 /* parse/pbnf.c */
 pboolean pp_gram_from_pbnf( ppgram* g, char* src );
@@ -229,21 +230,58 @@ ppsym* pp_sym_mod_positive( ppsym* sym );
 ppsym* pp_sym_mod_optional( ppsym* sym );
 ppsym* pp_sym_mod_kleene( ppsym* sym );
 
+/* regex/bitnfa.c */
+pregex_bitnfa* pregex_bitnfa_create( pregex_ptn* ptn, pboolean refs );
+pregex_bitnfa* pregex_bitnfa_free( pregex_bitnfa* bitnfa );
+pboolean pregex_bitnfa_first( pregex_bitnfa* bitnfa, wchar_t ch );
+int pregex_bitnfa_match( pregex_bitnfa* bitnfa, char* start, char* stop, char** end, int flags );
+
 /* regex/dfa.c */
 void pregex_dfa_print( pregex_dfa* dfa );
 pregex_dfa* pregex_dfa_create( void );
 pboolean pregex_dfa_reset( pregex_dfa* dfa );
 pregex_dfa* pregex_dfa_free( pregex_dfa* dfa );
 int pregex_dfa_from_nfa( pregex_dfa* dfa, pregex_nfa* nfa );
+int pregex_dfa_from_literals( pregex_dfa* dfa, plist* ptns );
+int pregex_dfa_union( pregex_dfa* dfa, pregex_dfa* left, pregex_dfa* right );
 int pregex_dfa_minimize( pregex_dfa* dfa );
 int pregex_dfa_match( pregex_dfa* dfa, char* str, size_t* len, int* mflags, prange** ref, int* ref_count, int flags );
 int pregex_dfa_to_dfatab( wchar_t*** dfatab, pregex_dfa* dfa );
+size_t pregex_dfatab_size( wchar_t** dfatab, int states );
+unsigned int pregex_dfatab_accept( wchar_t* row, int i, int* flags );
+int pregex_dfatab_to_utf8( wchar_t*** dfatab, int states );
+char* pregex_accel_skip( pregex_accel* accel, char* ptr, char* stop );
+pregex_dense* pregex_dense_create( wchar_t** dfatab, int states );
+pregex_dense* pregex_dense_free( pregex_dense* dense );
+int pregex_dfatab_next( wchar_t** dfatab, int states, pregex_dense* dense, int state, wchar_t ch );
+int pregex_dfatab_match( wchar_t** dfatab, int states, pregex_dense* dense, char* start, char* stop, char** end, prange* ref, int flags );
+pregex_search* pregex_search_create( wchar_t** dfatab, int states, int flags );
+pboolean pregex_search_backward( pregex_search* search, wchar_t** dfatab, int states );
+pregex_search* pregex_search_free( pregex_search* search );
+pboolean pregex_search_find( pregex_search* search, char* start, char* stop, char* limit, char** mstart, int flags );
+pboolean pregex_search_start( pregex_search* search, char* start, char* stop, char* end, char** mstart, int flags );
+pboolean pregex_search_rfind( pregex_search* search, char* start, char* stop, char** mstart, int flags );
 
 /* regex/direct.c */
+void pregex_qcache( size_t size );
+void pregex_qcache_stats( size_t* hits, size_t* misses, size_t* evictions );
 int pregex_qmatch( char* regex, char* str, int flags, parray** matches );
 int pregex_qsplit( char* regex, char* str, int flags, parray** matches );
 char* pregex_qreplace( char* regex, char* str, char* replace, int flags );
 
+/* regex/image.c */
+pregex_image* pregex_image_free( pregex_image* image, int* trans_cnt, pregex_search* search );
+pboolean pregex_save( pregex* regex, char* path );
+pregex* pregex_load( char* path );
+pboolean plex_save( plex* lex, char* path );
+plex* plex_load( char* path );
+
+/* regex/lazy.c */
+pregex_lazy* pregex_lazy_create( pregex_nfa* nfa );
+pregex_lazy* pregex_lazy_free( pregex_lazy* lazy );
+pboolean pregex_lazy_first( pregex_lazy* lazy, wchar_t ch );
+int pregex_lazy_match( pregex_lazy* lazy, char* start, char* stop, char** end, prange* ref, int flags );
+
 /* regex/lex.c */
 plex* plex_create( int flags );
 plex* plex_free( plex* lex );
@@ -251,11 +289,32 @@ pboolean plex_reset( plex* lex );
 pboolean plex_prepare( plex* lex );
 pregex_ptn* plex_define( plex* lex, char* pat, int match_id, int flags );
 int plex_lex( plex* lex, char* start, char** end );
+int plex_lex_n( plex* lex, char* start, char* stop, char** end );
+int plex_lex_r( plex* lex, char* start, char* stop, char** end, prange* ref );
 char* plex_next( plex* lex, char* start, unsigned int* id, char** end );
+char* plex_next_n( plex* lex, char* start, char* stop, unsigned int* id, char** end );
+char* plex_next_r( plex* lex, char* start, char* stop, unsigned int* id, char** end, prange* ref );
+char* plex_next_in( plex* lex, char* begin, char* start, char* stop, unsigned int* id, char** end, prange* ref );
+char* plex_next_before( plex* lex, char* begin, char* start, char* limit, char* stop, unsigned int* id, char** end, prange* ref );
 size_t plex_tokenize( plex* lex, char* start, parray** matches );
+size_t plex_tokenize_n( plex* lex, char* start, char* stop, parray** matches );
+pboolean plex_iter_init( pregex_iter* iter, plex* lex, char* start, char* stop );
+pboolean plex_iter_next( pregex_iter* iter, prange* match );
+pboolean plex_to_c( plex* lex, FILE* f, char* name );
 
 /* regex/misc.c */
 pboolean pregex_check_anchors( char* all, char* str, size_t len, int anchors, int flags );
+int pregex_anchor_class( wchar_t ch );
+pboolean pregex_anchor_wide( void );
+int pregex_anchor_before( char* begin, char* ptr, int flags );
+int pregex_anchor_after( char* ptr, char* stop, int flags );
+int pregex_anchor_flags( int cls );
+int pregex_anchor_at( char* begin, char* ptr, int flags );
+pboolean pregex_anchor_test( int anchors, int prev, int next );
+pboolean pregex_anchor_accept( int anchors, char* ptr, char* stop, int flags );
+void pregex_accept_add( unsigned int* st_accept, int* st_flags, int** fallback, unsigned int accept, int flags );
+unsigned int pregex_accept_nth( unsigned int st_accept, int st_flags, int* fallback, int i, int* flags );
+pboolean pregex_getchar( char** ptr, char* stop, wchar_t* ch, int flags );
 
 /* regex/nfa.c */
 pregex_nfa_st* pregex_nfa_create_state( pregex_nfa* nfa, char* chardef, int flags );
@@ -263,11 +322,20 @@ void pregex_nfa_print( pregex_nfa* nfa );
 pregex_nfa* pregex_nfa_create( void );
 pboolean pregex_nfa_reset( pregex_nfa* nfa );
 pregex_nfa* pregex_nfa_free( pregex_nfa* nfa );
-int pregex_nfa_move( pregex_nfa* nfa, plist* hits, wchar_t from, wchar_t to );
-int pregex_nfa_epsilon_closure( pregex_nfa* nfa, plist* closure, unsigned int* accept, int* flags );
+int pregex_nfa_index( pregex_nfa* nfa );
+pregex_nfa_set* pregex_nfa_set_create( int max );
+pregex_nfa_set* pregex_nfa_set_free( pregex_nfa_set* set );
+int pregex_nfa_move( pregex_nfa* nfa, pregex_nfa_set* result, int* ids, int cnt, wchar_t from, wchar_t to );
+int pregex_nfa_epsilon_closure( pregex_nfa* nfa, pregex_nfa_set* closure, unsigned int* accept, int* flags );
 int pregex_nfa_match( pregex_nfa* nfa, char* str, size_t* len, int* mflags, prange** ref, int* ref_count, int flags );
 pboolean pregex_nfa_from_string( pregex_nfa* nfa, char* str, int flags, int acc );
 
+/* regex/parallel.c */
+int pregex_findall_parallel( pregex* regex, char* start, char* stop, parray** matches, int threads );
+size_t plex_tokenize_parallel( plex* lex, char* start, char* stop, parray** matches, int threads );
+size_t pregex_match_batch( pregex* regex, prange* records, size_t count, prange* results, int threads );
+size_t plex_lex_batch( plex* lex, prange* records, size_t count, prange* results, int threads );
+
 /* regex/ptn.c */
 pregex_ptn* pregex_ptn_create_char( pccl* ccl );
 pregex_ptn* pregex_ptn_create_string( char* str, int flags );
@@ -279,9 +347,12 @@ pregex_ptn* pregex_ptn_create_pos( pregex_ptn* ptn );
 pregex_ptn* pregex_ptn_create_opt( pregex_ptn* ptn );
 pregex_ptn* pregex_ptn_create_seq( pregex_ptn* first, ... );
 pregex_ptn* pregex_ptn_dup( pregex_ptn* ptn );
+pregex_ptn* pregex_ptn_reverse( pregex_ptn* ptn );
 pregex_ptn* pregex_ptn_free( pregex_ptn* ptn );
 void pregex_ptn_print( pregex_ptn* ptn, int rec );
 char* pregex_ptn_to_regex( pregex_ptn* ptn );
+pboolean pregex_ptn_to_literals( pregex_ptn* ptn, wchar_t** prefix, wchar_t** factor );
+pboolean pregex_ptn_is_literal( pregex_ptn* ptn );
 pboolean pregex_ptn_to_nfa( pregex_nfa* nfa, pregex_ptn* ptn );
 pboolean pregex_ptn_to_dfa( pregex_dfa* dfa, pregex_ptn* ptn );
 int pregex_ptn_to_dfatab( wchar_t*** dfatab, pregex_ptn* ptn );
@@ -291,11 +362,33 @@ pboolean pregex_ptn_parse( pregex_ptn** ptn, char* str, int flags );
 pregex* pregex_create( char* pat, int flags );
 pregex* pregex_free( pregex* regex );
 pboolean pregex_match( pregex* regex, char* start, char** end );
+pboolean pregex_match_n( pregex* regex, char* start, char* stop, char** end );
+pboolean pregex_match_r( pregex* regex, char* start, char* stop, char** end, prange* ref );
 char* pregex_find( pregex* regex, char* start, char** end );
+char* pregex_find_n( pregex* regex, char* start, char* stop, char** end );
+char* pregex_find_r( pregex* regex, char* start, char* stop, char** end, prange* ref );
+char* pregex_find_in( pregex* regex, char* begin, char* start, char* stop, char** end, prange* ref );
+char* pregex_find_before( pregex* regex, char* begin, char* start, char* limit, char* stop, char** end, prange* ref );
+char* pregex_rfind( pregex* regex, char* start, char** end );
+char* pregex_rfind_n( pregex* regex, char* start, char* stop, char** end );
+char* pregex_rfind_r( pregex* regex, char* start, char* stop, char** end, prange* ref );
 int pregex_findall( pregex* regex, char* start, parray** matches );
+int pregex_findall_n( pregex* regex, char* start, char* stop, parray** matches );
 char* pregex_split( pregex* regex, char* start, char** end, char** next );
 int pregex_splitall( pregex* regex, char* start, parray** matches );
+pboolean pregex_iter_init( pregex_iter* iter, pregex* regex, char* start, char* stop );
+pboolean pregex_iter_next( pregex_iter* iter, prange* match );
+pboolean pregex_iter_split( pregex_iter* iter, prange* match );
 char* pregex_replace( pregex* regex, char* str, char* replacement );
+size_t pregex_replace_buf( pregex* regex, char* str, char* replacement, char* buf, size_t size );
+pboolean pregex_replace_file( pregex* regex, char* str, char* replacement, FILE* f );
+
+/* regex/stream.c */
+plex_stream* plex_stream_create( plex* lex, plex_readfn read, void* user );
+plex_stream* plex_stream_fd( plex* lex, int fd );
+plex_stream* plex_stream_file( plex* lex, FILE* f );
+plex_stream* plex_stream_free( plex_stream* stream );
+unsigned int plex_stream_next( plex_stream* stream, char** start, char** end );
 
 /* string/convert.c */
 char* pwcs_to_str( wchar_t* str, pboolean freestr );
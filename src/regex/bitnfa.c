@@ -0,0 +1,399 @@
+/* -MODULE----------------------------------------------------------------------
+Phorward Foundation Toolkit
+Copyright (C) 2006-2018 by Phorward Software Technologies, Jan Max Meyer
+http://www.phorward-software.com ++ contact<at>phorward<dash>software<dot>com
+All rights reserved. See LICENSE for more information.
+
+File:	bitnfa.c
+Author:	Jan Max Meyer
+Usage:	Bit-parallel Glushkov NFA, constructed directly from a pattern.
+----------------------------------------------------------------------------- */
+
+#include "phorward.h"
+
+/*NO_DOC*/
+/* No documentation for the entire module, all here is only used internally. */
+
+/* Index of the lowest bit set in a non-zero word */
+#ifdef __GNUC__
+#define PREGEX_BITNFA_LOWBIT( w )	__builtin_ctzll( w )
+#else
+static int PREGEX_BITNFA_LOWBIT( uint64_t w )
+{
+	int		i;
+
+	for( i = 0; !( w & 1 ); i++ )
+		w >>= 1;
+
+	return i;
+}
+#endif
+
+/* Counts the positions of //ptn//, and checks for references. */
+static int pregex_bitnfa_COUNT( pregex_ptn* ptn, pboolean* refs )
+{
+	int		cnt		= 0;
+
+	for( ; ptn && ptn->type != PREGEX_PTN_NULL; ptn = ptn->next )
+	{
+		switch( ptn->type )
+		{
+			case PREGEX_PTN_CHAR:
+				cnt++;
+				break;
+
+			case PREGEX_PTN_REFSUB:
+				*refs = TRUE;
+				/* NO break! */
+
+			default:
+				cnt += pregex_bitnfa_COUNT( ptn->child[ 0 ], refs )
+						+ pregex_bitnfa_COUNT( ptn->child[ 1 ], refs );
+				break;
+		}
+	}
+
+	return cnt;
+}
+
+/* Extends the follow sets of all positions in //from// by //to//. */
+static void pregex_bitnfa_follow( pregex_bitnfa* bitnfa,
+									uint64_t* from, uint64_t* to )
+{
+	uint64_t*	follow;
+	uint64_t	w;
+	int			i;
+	int			j;
+
+	for( i = 0; i < bitnfa->words; i++ )
+	{
+		for( w = from[ i ]; w; w &= w - 1 )
+		{
+			follow = bitnfa->follow + ( i * 64 + PREGEX_BITNFA_LOWBIT( w ) )
+											* bitnfa->words;
+
+			for( j = 0; j < bitnfa->words; j++ )
+				follow[ j ] |= to[ j ];
+		}
+	}
+}
+
+/* Glushkov construction of the pattern sequence //ptn//. Computes the
+//first// and //last// position sets and whether the sequence is //nullable//,
+and extends the follow sets. //pos// is the last position assigned. */
+static void pregex_bitnfa_BUILD( pregex_bitnfa* bitnfa, pregex_ptn* ptn,
+									uint64_t* first, uint64_t* last,
+										pboolean* nullable, int* pos )
+{
+	uint64_t	f			[ PREGEX_BITNFA_MAXWORDS ];
+	uint64_t	l			[ PREGEX_BITNFA_MAXWORDS ];
+	uint64_t	f2			[ PREGEX_BITNFA_MAXWORDS ];
+	uint64_t	l2			[ PREGEX_BITNFA_MAXWORDS ];
+	pboolean	n;
+	pboolean	n2;
+	int			i;
+
+	memset( first, 0, bitnfa->words * sizeof( uint64_t ) );
+	memset( last, 0, bitnfa->words * sizeof( uint64_t ) );
+	*nullable = TRUE;
+
+	for( ; ptn && ptn->type != PREGEX_PTN_NULL; ptn = ptn->next )
+	{
+		switch( ptn->type )
+		{
+			case PREGEX_PTN_CHAR:
+				memset( f, 0, bitnfa->words * sizeof( uint64_t ) );
+				(*pos)++;
+
+				f[ *pos / 64 ] = (uint64_t)1 << ( *pos % 64 );
+				memcpy( l, f, bitnfa->words * sizeof( uint64_t ) );
+				n = FALSE;
+
+				bitnfa->ccl[ *pos ] = ptn->ccl;
+				break;
+
+			case PREGEX_PTN_SUB:
+			case PREGEX_PTN_REFSUB:
+				pregex_bitnfa_BUILD( bitnfa, ptn->child[ 0 ], f, l, &n, pos );
+				break;
+
+			case PREGEX_PTN_ALT:
+				pregex_bitnfa_BUILD( bitnfa, ptn->child[ 0 ], f, l, &n, pos );
+				pregex_bitnfa_BUILD( bitnfa, ptn->child[ 1 ],
+										f2, l2, &n2, pos );
+
+				for( i = 0; i < bitnfa->words; i++ )
+				{
+					f[ i ] |= f2[ i ];
+					l[ i ] |= l2[ i ];
+				}
+
+				n = n || n2;
+				break;
+
+			case PREGEX_PTN_KLE:
+			case PREGEX_PTN_POS:
+			case PREGEX_PTN_OPT:
+				pregex_bitnfa_BUILD( bitnfa, ptn->child[ 0 ], f, l, &n, pos );
+
+				if( ptn->type != PREGEX_PTN_OPT )
+					pregex_bitnfa_follow( bitnfa, l, f );
+
+				if( ptn->type != PREGEX_PTN_POS )
+					n = TRUE;
+
+				break;
+
+			default:
+				MISSINGCASE;
+				return;
+		}
+
+		/* Chain the sequence */
+		pregex_bitnfa_follow( bitnfa, last, f );
+
+		for( i = 0; i < bitnfa->words; i++ )
+		{
+			if( *nullable )
+				first[ i ] |= f[ i ];
+
+			last[ i ] = n ? last[ i ] | l[ i ] : l[ i ];
+		}
+
+		*nullable = *nullable && n;
+	}
+}
+
+/** Creates a bit-parallel NFA from the pattern //ptn// using the Glushkov
+construction. The NFA has one position per character-class of //ptn//, and
+runs on sets of positions held in up to PREGEX_BITNFA_MAXWORDS 64-bit words.
+
+//ptn// must live as long as the bit-parallel NFA, because its
+character-classes are referenced.
+If //refs// is TRUE, patterns with references are rejected, because the
+bit-parallel NFA can't track them.
+
+Returns a pointer to the allocated pregex_bitnfa-object, which must be released
+using pregex_bitnfa_free(). Returns (pregex_bitnfa*)NULL if the pattern has
+too many positions or rejected references.
+*/
+pregex_bitnfa* pregex_bitnfa_create( pregex_ptn* ptn, pboolean refs )
+{
+	pregex_bitnfa*	bitnfa;
+	pboolean		has_refs	= FALSE;
+	int				positions;
+	int				pos			= 0;
+	int				i;
+	int				j;
+	wchar_t			from;
+	wchar_t			to;
+
+	PROC( "pregex_bitnfa_create" );
+	PARMS( "ptn", "%p", ptn );
+	PARMS( "refs", "%s", BOOLEAN_STR( refs ) );
+
+	if( !ptn )
+	{
+		WRONGPARAM;
+		RETURN( (pregex_bitnfa*)NULL );
+	}
+
+	positions = pregex_bitnfa_COUNT( ptn, &has_refs );
+	VARS( "positions", "%d", positions );
+
+	if( ( refs && has_refs )
+			|| positions >= PREGEX_BITNFA_MAXWORDS * 64 )
+	{
+		MSG( "Pattern not suitable for bit-parallel NFA" );
+		RETURN( (pregex_bitnfa*)NULL );
+	}
+
+	bitnfa = (pregex_bitnfa*)pmalloc( sizeof( pregex_bitnfa ) );
+
+	/* Position 0 is the initial position */
+	bitnfa->positions = positions + 1;
+	bitnfa->words = ( bitnfa->positions + 63 ) / 64;
+
+	bitnfa->follow = (uint64_t*)pmalloc( bitnfa->positions * bitnfa->words
+											* sizeof( uint64_t ) );
+	bitnfa->last = (uint64_t*)pmalloc( bitnfa->words * sizeof( uint64_t ) );
+	bitnfa->mask = (uint64_t*)pmalloc( 256 * bitnfa->words
+											* sizeof( uint64_t ) );
+	bitnfa->ccl = (pccl**)pmalloc( bitnfa->positions * sizeof( pccl* ) );
+
+	/* The first positions follow the initial position */
+	pregex_bitnfa_BUILD( bitnfa, ptn, bitnfa->follow, bitnfa->last,
+							&bitnfa->nullable, &pos );
+
+	bitnfa->accept = ptn->accept;
+	bitnfa->flags = ptn->flags;
+
+	/* Character masks for 0-255 */
+	for( i = 1; i < bitnfa->positions; i++ )
+	{
+		for( j = 0; p_ccl_get( &from, &to, bitnfa->ccl[ i ], j ); j++ )
+		{
+			if( from > 255 )
+				break;
+
+			for( ; from <= to && from < 256; from++ )
+				bitnfa->mask[ from * bitnfa->words + i / 64 ]
+					|= (uint64_t)1 << ( i % 64 );
+		}
+	}
+
+	RETURN( bitnfa );
+}
+
+/** Frees the bit-parallel NFA //bitnfa//.
+
+Always returns (pregex_bitnfa*)NULL. */
+pregex_bitnfa* pregex_bitnfa_free( pregex_bitnfa* bitnfa )
+{
+	if( !bitnfa )
+		return (pregex_bitnfa*)NULL;
+
+	pfree( bitnfa->follow );
+	pfree( bitnfa->last );
+	pfree( bitnfa->mask );
+	pfree( bitnfa->ccl );
+	pfree( bitnfa );
+
+	return (pregex_bitnfa*)NULL;
+}
+
+/* Intersects //set// with the positions matching //ch//;
+Returns TRUE if positions are left. */
+static pboolean pregex_bitnfa_filter( pregex_bitnfa* bitnfa,
+										uint64_t* set, wchar_t ch )
+{
+	uint64_t*	mask;
+	uint64_t	any		= 0;
+	uint64_t	w;
+	int			i;
+
+	if( (unsigned int)ch < 256 )
+	{
+		mask = bitnfa->mask + ch * bitnfa->words;
+
+		for( i = 0; i < bitnfa->words; i++ )
+			any |= ( set[ i ] &= mask[ i ] );
+
+		return any != 0;
+	}
+
+	for( i = 0; i < bitnfa->words; i++ )
+	{
+		for( w = set[ i ]; w; w &= w - 1 )
+			if( !p_ccl_test( bitnfa->ccl[ i * 64
+									+ PREGEX_BITNFA_LOWBIT( w ) ], ch ) )
+				set[ i ] &= ~( w & -w );
+
+		any |= set[ i ];
+	}
+
+	return any != 0;
+}
+
+/** Checks if //bitnfa// has a transition on //ch// from its initial
+position. */
+pboolean pregex_bitnfa_first( pregex_bitnfa* bitnfa, wchar_t ch )
+{
+	uint64_t	set		[ PREGEX_BITNFA_MAXWORDS ];
+
+	if( !bitnfa )
+	{
+		WRONGPARAM;
+		return FALSE;
+	}
+
+	memcpy( set, bitnfa->follow, bitnfa->words * sizeof( uint64_t ) );
+	return pregex_bitnfa_filter( bitnfa, set, ch );
+}
+
+/** Tries to match the bit-parallel NFA //bitnfa// at pointer //start//.
+
+//stop// is the end of the input, or (char*)NULL for zero-terminated input.
+//flags// are the runtime flags (PREGEX_RUN_*) to be used.
+
+If the NFA can be matched, the function returns the match ID of the pattern,
+and //end// receives the pointer to the last matched character.
+Otherwise, the function returns 0.
+*/
+int pregex_bitnfa_match( pregex_bitnfa* bitnfa, char* start, char* stop,
+							char** end, int flags )
+{
+	uint64_t	set			[ PREGEX_BITNFA_MAXWORDS ];
+	uint64_t	next		[ PREGEX_BITNFA_MAXWORDS ];
+	uint64_t*	follow;
+	uint64_t	w;
+	uint64_t	acc;
+	int			i;
+	int			j;
+	char*		match		= (char*)NULL;
+	char*		ptr			= start;
+	wchar_t		ch;
+
+	PROC( "pregex_bitnfa_match" );
+	PARMS( "bitnfa", "%p", bitnfa );
+	PARMS( "start", "%s", start );
+	PARMS( "stop", "%p", stop );
+	PARMS( "end", "%p", end );
+	PARMS( "flags", "%d", flags );
+
+	if( !( bitnfa && start ) )
+	{
+		WRONGPARAM;
+		RETURN( 0 );
+	}
+
+	/* Initial position */
+	memset( set, 0, bitnfa->words * sizeof( uint64_t ) );
+	*set = 1;
+	acc = bitnfa->nullable;
+
+	while( TRUE )
+	{
+		/* Set accepts, and the anchors hold? */
+		if( acc && pregex_anchor_accept( bitnfa->flags, ptr, stop, flags ) )
+		{
+			MSG( "This set accepts the input" );
+			match = ptr;
+
+			if( flags & PREGEX_RUN_NONGREEDY
+					|| bitnfa->flags & PREGEX_FLAG_NONGREEDY )
+				break;
+		}
+
+		/* Get next character */
+		if( !pregex_getchar( &ptr, stop, &ch, flags ) )
+			break;
+
+		/* Union of the follow sets of all positions */
+		memset( next, 0, bitnfa->words * sizeof( uint64_t ) );
+
+		for( i = 0; i < bitnfa->words; i++ )
+		{
+			for( w = set[ i ]; w; w &= w - 1 )
+			{
+				follow = bitnfa->follow
+							+ ( i * 64 + PREGEX_BITNFA_LOWBIT( w ) )
+								* bitnfa->words;
+
+				for( j = 0; j < bitnfa->words; j++ )
+					next[ j ] |= follow[ j ];
+			}
+		}
+
+		if( !pregex_bitnfa_filter( bitnfa, next, ch ) )
+			break;
+
+		for( acc = 0, i = 0; i < bitnfa->words; i++ )
+			acc |= ( set[ i ] = next[ i ] ) & bitnfa->last[ i ];
+	}
+
+	if( match && end )
+		*end = match;
+
+	RETURN( match ? bitnfa->accept : 0 );
+}
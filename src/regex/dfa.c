@@ -11,6 +11,12 @@ Usage:	Internal DFA creation and transformation functions.
 
 #include "phorward.h"
 
+#if defined( __AVX2__ ) && defined( __GNUC__ )
+#include <immintrin.h>
+#elif defined( __SSE2__ ) && defined( __GNUC__ )
+#include <emmintrin.h>
+#endif
+
 /*NO_DOC*/
 /* No documentation for the entire module, all here is only used internally. */
 
@@ -30,6 +36,11 @@ void pregex_dfa_print( pregex_dfa* dfa )
 			plist_offset( plist_get_by_ptr( dfa->states, s ) ),
 				s->accept, s->flags );
 
+		if( s->fallback )
+			for( i = 0; i < *s->fallback; i++ )
+				fprintf( stderr, ", %d flags %d", s->fallback[ i * 2 + 1 ],
+							s->fallback[ i * 2 + 2 ] );
+
 		if( s->refs )
 		{
 			fprintf( stderr, " refs" );
@@ -71,6 +82,15 @@ static int pregex_dfa_sort_classes( plist* list, plistel* el, plistel* er )
 	return p_ccl_compare( l, r ) < 0 ? 1 : 0;
 }
 
+/* Compare two wchar_t for qsort() */
+static int pregex_wchar_compare( const void* l, const void* r )
+{
+	if( *( (wchar_t*)l ) < *( (wchar_t*)r ) )
+		return -1;
+
+	return *( (wchar_t*)l ) > *( (wchar_t*)r ) ? 1 : 0;
+}
+
 /* Creating a new DFA state */
 static pregex_dfa_st* pregex_dfa_create_state( pregex_dfa* dfa )
 {
@@ -97,6 +117,7 @@ static void pregex_dfa_delete_state( pregex_dfa_st* st )
 	}
 
 	st->trans = plist_free( st->trans );
+	st->fallback = pfree( st->fallback );
 }
 
 /** Allocates an initializes a new pregex_dfa-object for a deterministic
@@ -202,56 +223,158 @@ static void pregex_dfa_default_trans( pregex_dfa* dfa )
 			all += cnt;
 		}
 
-		if( all < PCCL_MAX )
+		if( all <= PCCL_MAX - PCCL_MIN )
 			st->def_trans = (pregex_dfa_tr*)NULL;
 	}
 
 	VOIDRET;
 }
 
-/** Collects all references by the NFA-states forming a DFA-state, and puts them
-into an dynamically allocated array for later re-use.
+/* NFA state set of a DFA state during subset construction */
+typedef struct
+{
+	int*			set;		/* Sorted NFA state ids */
+	int				cnt;		/* Number of NFA state ids in set */
+
+	unsigned int	hash;		/* Hash value of set */
+	int				next;		/* Next set in same hash bucket (+1) */
+} pregex_dfa_set;
+
+/* Sort function for NFA state ids */
+static int pregex_dfa_sort_ids( const void* a, const void* b )
+{
+	return *( (int*)a ) - *( (int*)b );
+}
+
+/** Collects all references by the NFA-states forming a DFA-state.
 
 //st// is the DFA-state, for which references shall be collected.
+//nfa// is the indexed NFA.
+//nfa_set// is the set of NFA state ids.
 */
-static pboolean pregex_dfa_collect_ref( pregex_dfa_st* st, plist* nfa_set )
+static pboolean pregex_dfa_collect_ref( pregex_dfa_st* st, pregex_nfa* nfa,
+											pregex_dfa_set* nfa_set )
 {
-	plistel*		e;
-	pregex_nfa_st*	nfa_st;
+	int				i;
 
 	PROC( "pregex_dfa_collect_ref" );
 
 	/* Find out number of references */
 	MSG( "Searching for references in the NFA transitions" );
-	plist_for( nfa_set, e )
+	for( i = 0; i < nfa_set->cnt; i++ )
+		st->refs |= nfa->index[ nfa_set->set[ i ] ]->refs;
+
+	RETURN( TRUE );
+}
+
+/* Get the DFA-state with the same NFA state set than //trans//, or insert a
+	new set for it. The set in //trans// is sorted to its canonical order.
+	The hash table in //buckets// is doubled when it holds more sets than
+	buckets. Returns the offset of the DFA-state, and sets //created// if
+	its set was inserted. */
+static int pregex_dfa_same_transitions( parray* sets, int** buckets,
+											int* size, pregex_nfa_set* trans,
+												pboolean* created )
+{
+	pregex_dfa_set*	nfa_set;
+	unsigned int	hash	= 0;
+	int				i;
+
+	/* The set is cleared by the next move, so its sparse part may get
+		invalid by sorting. */
+	qsort( trans->dense, trans->cnt, sizeof( int ), pregex_dfa_sort_ids );
+
+	for( i = 0; i < trans->cnt; i++ )
+		hash = hash * 31 + trans->dense[ i ];
+
+	*created = FALSE;
+
+	for( i = ( *buckets )[ hash % *size ]; i; i = nfa_set->next )
 	{
-		nfa_st = (pregex_nfa_st*)plist_access( e );
-		st->refs |= nfa_st->refs;
+		nfa_set = (pregex_dfa_set*)parray_get( sets, i - 1 );
+
+		if( nfa_set->hash == hash && nfa_set->cnt == trans->cnt
+				&& !memcmp( nfa_set->set, trans->dense,
+								trans->cnt * sizeof( int ) ) )
+			return i - 1;
 	}
 
-	RETURN( TRUE );
+	*created = TRUE;
+
+	nfa_set = (pregex_dfa_set*)parray_malloc( sets );
+	nfa_set->set = (int*)pmemdup( trans->dense, trans->cnt * sizeof( int ) );
+	nfa_set->cnt = trans->cnt;
+	nfa_set->hash = hash;
+
+	if( (int)parray_count( sets ) > *size )
+	{
+		/* Grow the hash table and rehash all sets */
+		*size *= 2;
+		*buckets = (int*)prealloc( *buckets, *size * sizeof( int ) );
+		memset( *buckets, 0, *size * sizeof( int ) );
+
+		for( i = 0; i < (int)parray_count( sets ); i++ )
+		{
+			nfa_set = (pregex_dfa_set*)parray_get( sets, i );
+
+			nfa_set->next = ( *buckets )[ nfa_set->hash % *size ];
+			( *buckets )[ nfa_set->hash % *size ] = i + 1;
+		}
+	}
+	else
+	{
+		nfa_set->next = ( *buckets )[ hash % *size ];
+		( *buckets )[ hash % *size ] = parray_count( sets );
+	}
+
+	return parray_count( sets ) - 1;
 }
 
-/* Checks for DFA-states with same NFA-epsilon transitions than the specified
-	one within the DFA-state machine. If an equal item is found, the offset of
-		that DFA-state is returned, else -1. */
-static pregex_dfa_st* pregex_dfa_same_transitions(
-							pregex_dfa* dfa, plist* trans, parray* sets )
+/* Adds the character class //ccl// to the disjoint character classes in
+	//classes//. Every class intersecting with //ccl// is split into the
+		intersection and the rest, so no character is shared between two
+			classes. //ccl// is consumed. */
+static pboolean pregex_dfa_add_class( plist* classes, pccl* ccl )
 {
 	plistel*		e;
-	pregex_dfa_st*	ptr;
-	plist*			nfa_set;
+	plistel*		next;
+	pccl*			test;
+	pccl*			subset;
+	pccl*			rest;
 
-	plist_for( dfa->states, e )
+	for( e = plist_first( classes ); e && p_ccl_size( ccl ); e = next )
 	{
-		ptr = (pregex_dfa_st*)plist_access( e );
+		next = plist_next( e );
+		test = (pccl*)plist_access( e );
+
+		if( !( subset = p_ccl_intersect( ccl, test ) ) )
+			continue;
+
+		rest = p_ccl_diff( ccl, subset );
+		p_ccl_free( ccl );
+		ccl = rest;
+
+		rest = p_ccl_diff( test, subset );
+		p_ccl_free( test );
+		plist_remove( classes, e );
 
-		nfa_set = *( (plist**)parray_get( sets, plist_offset( e ) ) );
-		if( plist_diff( nfa_set, trans ) == 0 )
-			return ptr;
+		if( !( rest && ccl && plist_push( classes, subset ) ) )
+			return FALSE;
+
+		if( p_ccl_size( rest ) )
+		{
+			if( !plist_push( classes, rest ) )
+				return FALSE;
+		}
+		else
+			p_ccl_free( rest );
 	}
 
-	return (pregex_dfa_st*)NULL;
+	if( p_ccl_size( ccl ) )
+		return plist_push( classes, ccl ) ? TRUE : FALSE;
+
+	p_ccl_free( ccl );
+	return TRUE;
 }
 
 /** Turns a NFA-state machine into a DFA-state machine using the
@@ -267,29 +390,28 @@ In case of an error, -1 is returned.
 */
 int pregex_dfa_from_nfa( pregex_dfa* dfa, pregex_nfa* nfa )
 {
-	plist*			transitions;
+	pregex_nfa_set*	transitions;
 	plist*			classes;
-	plist*			done;
 	parray*			sets;
 
-	plist*			nfa_set;
-	plist*			current_nfa_set;
+	pregex_dfa_set*	current_nfa_set;
+	int*			buckets;
+	int				size		= 256;
+	int				done;
+	pboolean		created;
 
 	plistel*		e;
 	plistel*		f;
+	plistel*		g;
 	pregex_dfa_tr*	trans;
 	pregex_dfa_st*	current;
 	pregex_dfa_st*	st;
 	pregex_nfa_st*	nfa_st;
 	int				state_next	= 0;
-	pboolean		changed;
 	int				i;
 	wchar_t			begin;
 	wchar_t			end;
 	pccl*			ccl;
-	pccl*			test;
-	pccl*			del;
-	pccl*			subset;
 
 	PROC( "pregex_dfa_from_nfa" );
 	PARMS( "dfa", "%p", dfa );
@@ -305,63 +427,53 @@ int pregex_dfa_from_nfa( pregex_dfa* dfa, pregex_nfa* nfa )
 	classes = plist_create( 0, PLIST_MOD_PTR | PLIST_MOD_RECYCLE );
 	plist_set_sortfn( classes, pregex_dfa_sort_classes );
 
-	transitions = plist_create( 0, PLIST_MOD_PTR | PLIST_MOD_RECYCLE );
+	if( !pregex_nfa_index( nfa ) )
+		RETURN( -1 );
 
-	done = plist_create( 0, PLIST_MOD_PTR | PLIST_MOD_RECYCLE );
+	/* One work buffer is reused for all moves and closures */
+	transitions = pregex_nfa_set_create( nfa->cnt );
 
-	sets = parray_create( sizeof( plist* ), 0 );
+	sets = parray_create( sizeof( pregex_dfa_set ), 0 );
+	buckets = (int*)pmalloc( size * sizeof( int ) );
 
 	/* Starting seed */
 
 	if( !( current = pregex_dfa_create_state( dfa ) ) )
 		RETURN( -1 );
 
-	nfa_set = plist_create( 0, PLIST_MOD_PTR );
-	plist_push( nfa_set, plist_access( plist_first( nfa->states ) ) );
-	parray_push( sets, &nfa_set );
+	pregex_nfa_set_add( transitions, 0 );
+	pregex_nfa_epsilon_closure( nfa, transitions,
+									(unsigned int*)NULL, (int*)NULL );
 
-	pregex_nfa_epsilon_closure( nfa, nfa_set, (unsigned int*)NULL, (int*)NULL );
-	pregex_dfa_collect_ref( current, nfa_set );
+	pregex_dfa_same_transitions( sets, &buckets, &size, transitions,
+									&created );
+	pregex_dfa_collect_ref( current, nfa,
+								(pregex_dfa_set*)parray_get( sets, 0 ) );
 
-	/* Perform algorithm until all states are done */
-	while( TRUE )
+	/* Perform algorithm until all states are done; New states are always
+		appended, so the undone states are the ones following the current. */
+	for( e = plist_first( dfa->states ), done = 0; e;
+			e = plist_next( e ), done++ )
 	{
 		MSG( "WHILE" );
 
-		/* Get next undone state */
-		plist_for( dfa->states, e )
-		{
-			current = (pregex_dfa_st*)plist_access( e );
-			if( !plist_get_by_ptr( done, current ) )
-				break;
-		}
-
-		if( !e )
-		{
-			MSG( "No more undone states found" );
-			break;
-		}
-
-		plist_push( done, current );
+		current = (pregex_dfa_st*)plist_access( e );
 		current->accept = 0;
-		current_nfa_set = *( (plist**)parray_get( sets, plist_offset( e ) ) );
+		current_nfa_set = (pregex_dfa_set*)parray_get( sets, done );
 
 		/* Assemble all character sets in the alphabet list */
 		plist_erase( classes );
 
-		plist_for( current_nfa_set, e )
+		for( i = 0; i < current_nfa_set->cnt; i++ )
 		{
-			nfa_st = (pregex_nfa_st*)plist_access( e );
+			nfa_st = nfa->index[ current_nfa_set->set[ i ] ];
 
 			if( nfa_st->accept )
 			{
 				MSG( "NFA is an accepting state" );
-				if( !current->accept || current->accept >= nfa_st->accept )
-				{
-					MSG( "Copying accept information" );
-					current->accept = nfa_st->accept;
-					current->flags = nfa_st->flags;
-				}
+				pregex_accept_add( &current->accept, &current->flags,
+									&current->fallback, nfa_st->accept,
+										nfa_st->flags );
 			}
 
 			/* Generate list of character classes */
@@ -372,7 +484,7 @@ int pregex_dfa_from_nfa( pregex_dfa* dfa, pregex_nfa* nfa )
 				if( !( ccl = p_ccl_dup( nfa_st->ccl ) ) )
 					RETURN( -1 );
 
-				if( !plist_push( classes, ccl ) )
+				if( !pregex_dfa_add_class( classes, ccl ) )
 					RETURN( -1 );
 
 				VARS( "plist_count( classes )", "%d", plist_count( classes ) );
@@ -381,53 +493,14 @@ int pregex_dfa_from_nfa( pregex_dfa* dfa, pregex_nfa* nfa )
 
 		VARS( "current->accept", "%d", current->accept );
 
-		MSG( "Removing intersections within character classes" );
-		do
-		{
-			changed = FALSE;
-
-			plist_for( classes, e )
-			{
-				ccl = (pccl*)plist_access( e );
-
-				plist_for( classes, f )
-				{
-					if( e == f )
-						continue;
-
-					test = (pccl*)plist_access( f );
-
-					if( p_ccl_count( ccl ) > p_ccl_count( test ) )
-						continue;
-
-					if( ( subset = p_ccl_intersect( ccl, test ) ) )
-					{
-						test = p_ccl_diff( test, subset );
-						p_ccl_free( subset );
-
-						del = (pccl*)plist_access( f );
-						p_ccl_free( del );
-
-						plist_remove( classes, f );
-						plist_push( classes, test );
-
-						changed = TRUE;
-					}
-				}
-			}
-
-			VARS( "changed", "%s", BOOLEAN_STR( changed ) );
-		}
-		while( changed );
-
 		/* Sort classes */
 		plist_sort( classes );
 
 		MSG( "Make transitions on constructed alphabet" );
 		/* Make transitions on constructed alphabet */
-		plist_for( classes, e )
+		plist_for( classes, g )
 		{
-			ccl = (pccl*)plist_access( e );
+			ccl = (pccl*)plist_access( g );
 
 			MSG( "Check char class" );
 			for( i = 0; p_ccl_get( &begin, &end, ccl, i ); i++ )
@@ -435,13 +508,11 @@ int pregex_dfa_from_nfa( pregex_dfa* dfa, pregex_nfa* nfa )
 				VARS( "begin", "%d", begin );
 				VARS( "end", "%d", end );
 
-				plist_for( current_nfa_set, f )
-				{
-					if( !plist_push( transitions, plist_access( f ) ) )
-						RETURN( -1 );
-				}
+				/* The sets array may be moved by insertions */
+				current_nfa_set = (pregex_dfa_set*)parray_get( sets, done );
 
-				if( pregex_nfa_move( nfa, transitions, begin, end ) < 0 )
+				if( pregex_nfa_move( nfa, transitions, current_nfa_set->set,
+										current_nfa_set->cnt, begin, end ) < 0 )
 				{
 					MSG( "pregex_nfa_move() failed" );
 					break;
@@ -454,24 +525,20 @@ int pregex_dfa_from_nfa( pregex_dfa* dfa, pregex_nfa* nfa )
 					break;
 				}
 
-				if( !plist_count( transitions ) )
+				if( !transitions->cnt )
 				{
 					/* There is no move on this character! */
 					MSG( "transition set is empty, will continue" );
 					continue;
 				}
-				else if( ( st = pregex_dfa_same_transitions(
-									dfa, transitions, sets ) ) )
+
+				state_next = pregex_dfa_same_transitions( sets, &buckets,
+									&size, transitions, &created );
+
+				if( !created )
 				{
+					/* This transition is already existing in the DFA */
 					MSG( "State with same transitions exists" );
-					/* This transition is already existing in the DFA
-						- discard the transition table! */
-					plist_erase( transitions );
-					state_next = plist_offset(
-									plist_get_by_ptr( dfa->states, st ) );
-
-					nfa_set = *( (plist**)parray_get( sets, state_next ) );
-					pregex_dfa_collect_ref( st, nfa_set );
 				}
 				else
 				{
@@ -480,14 +547,8 @@ int pregex_dfa_from_nfa( pregex_dfa* dfa, pregex_nfa* nfa )
 					if( !( st = pregex_dfa_create_state( dfa ) ) )
 						RETURN( -1 );
 
-					state_next = plist_count( dfa->states ) - 1;
-
-					nfa_set = plist_dup( transitions );
-					plist_erase( transitions );
-
-					pregex_dfa_collect_ref( st, nfa_set );
-
-					parray_push( sets, &nfa_set );
+					pregex_dfa_collect_ref( st, nfa,
+						(pregex_dfa_set*)parray_get( sets, state_next ) );
 				}
 
 				VARS( "state_next", "%d", state_next );
@@ -526,12 +587,13 @@ int pregex_dfa_from_nfa( pregex_dfa* dfa, pregex_nfa* nfa )
 	}
 
 	/* Clear temporary allocated memory */
-	plist_free( done );
 	plist_free( classes );
-	plist_free( transitions );
+	pregex_nfa_set_free( transitions );
 
 	while( parray_count( sets ) )
-		plist_free( *( (plist**)parray_pop( sets ) ) );
+		pfree( ( (pregex_dfa_set*)parray_pop( sets ) )->set );
+
+	pfree( buckets );
 
 	parray_free( sets );
 
@@ -541,263 +603,380 @@ int pregex_dfa_from_nfa( pregex_dfa* dfa, pregex_nfa* nfa )
 	RETURN( plist_count( dfa->states ) );
 }
 
-/** Checks for transition equality within two dfa states.
+/** Constructs a DFA from the literal patterns in //ptns// directly, as a trie
+of their characters, without a NFA and subset construction.
 
-//dfa// is the pointer to DFA state machine.
-//groups// is the list of DFA groups
-//first// is the first state to check.
-//second// is the Second state to check.
+//dfa// is the pointer to the DFA-machine that will be constructed by this
+function. It is reset before it is used.
+//ptns// is a list of pregex_ptn*, which all must be literals as checked by
+pregex_ptn_is_literal(). On equal literals, the accepting ids are added by
+pregex_accept_add(), like pregex_dfa_from_nfa() does.
 
-Returns TRUE if both states are totally equal, FALSE else.
+Returns the number of DFA states that where constructed.
+In case of an error, -1 is returned.
 */
-static pboolean pregex_dfa_equal_states(
-	pregex_dfa* dfa, plist* groups,
-		pregex_dfa_st* first, pregex_dfa_st* second )
+int pregex_dfa_from_literals( pregex_dfa* dfa, plist* ptns )
 {
+	parray*			sts;
 	plistel*		e;
 	plistel*		f;
-	plistel*		g;
-	pregex_dfa_tr*	tr	[ 2 ];
+	pregex_ptn*		ptn;
+	pregex_ptn*		chr;
+	pregex_dfa_st*	st;
+	pregex_dfa_tr*	tr;
+	wchar_t			ch;
 
-	PROC( "pregex_dfa_equal_states" );
-	PARMS( "first", "%p", first );
-	PARMS( "second", "%p", second );
+	PROC( "pregex_dfa_from_literals" );
+	PARMS( "dfa", "%p", dfa );
+	PARMS( "ptns", "%p", ptns );
 
-	if( plist_count( first->trans ) != plist_count( second->trans ) )
+	if( !( dfa && ptns ) )
 	{
-		MSG( "Number of transitions is different" );
-		RETURN( FALSE );
+		WRONGPARAM;
+		RETURN( -1 );
 	}
 
-	for( e = plist_first( first->trans ), f = plist_first( second->trans );
-			e && f; e = plist_next( e ), f = plist_next( f ) )
+	pregex_dfa_reset( dfa );
+
+	/* States by offset, for following the trie */
+	sts = parray_create( sizeof( pregex_dfa_st* ), 0 );
+
+	st = pregex_dfa_create_state( dfa );
+	parray_push( sts, &st );
+
+	plist_for( ptns, e )
 	{
-		tr[0] = (pregex_dfa_tr*)plist_access( e );
-		tr[1] = (pregex_dfa_tr*)plist_access( f );
+		ptn = (pregex_ptn*)plist_access( e );
 
-		/* Equal Character class selection? */
-		if( p_ccl_compare( tr[0]->ccl, tr[1]->ccl ) )
+		if( !pregex_ptn_is_literal( ptn ) )
 		{
-			MSG( "Character classes are not equal" );
-			RETURN( FALSE );
+			MSG( "Pattern is not a literal" );
+			parray_free( sts );
+			RETURN( -1 );
 		}
 
-		/* Search for goto-state group equality */
-		first = (pregex_dfa_st*)plist_access(
-					plist_get( dfa->states, tr[0]->go_to ) );
-		second = (pregex_dfa_st*)plist_access(
-					plist_get( dfa->states, tr[1]->go_to ) );
+		st = *( (pregex_dfa_st**)parray_get( sts, 0 ) );
 
-		plist_for( groups, g )
+		for( chr = ptn; chr; chr = chr->next )
 		{
-			if( plist_get_by_ptr( (plist*)plist_access( g ), first )
-				&& !plist_get_by_ptr( (plist*)plist_access( g ), second ) )
+			p_ccl_get( &ch, (wchar_t*)NULL, chr->ccl, 0 );
+
+			/* Follow existing transition or insert a new state */
+			plist_for( st->trans, f )
+			{
+				tr = (pregex_dfa_tr*)plist_access( f );
+
+				if( p_ccl_test( tr->ccl, ch ) )
+					break;
+			}
+
+			if( !f )
 			{
-				MSG( "Transition state are in different groups\n" );
-				RETURN( FALSE );
+				tr = (pregex_dfa_tr*)plist_malloc( st->trans );
+				tr->ccl = p_ccl_create( -1, -1, (char*)NULL );
+				tr->go_to = parray_count( sts );
+
+				if( !p_ccl_add( tr->ccl, ch ) )
+				{
+					parray_free( sts );
+					RETURN( -1 );
+				}
+
+				st = pregex_dfa_create_state( dfa );
+				parray_push( sts, &st );
 			}
+			else
+				st = *( (pregex_dfa_st**)parray_get( sts, tr->go_to ) );
 		}
+
+		MSG( "Adding accept information" );
+		pregex_accept_add( &st->accept, &st->flags, &st->fallback,
+							ptn->accept, ptn->flags );
 	}
 
-	RETURN( TRUE );
-}
+	parray_free( sts );
 
-/** Minimizes a DFA to lesser states by grouping equivalent states to new
-states, and transforming transitions to them.
+	/* Set default transitions */
+	pregex_dfa_default_trans( dfa );
 
-//dfa// is the pointer to the DFA-machine that will be minimized. The content of
-//dfa// will be replaced with the reduced machine.
+	RETURN( plist_count( dfa->states ) );
+}
 
-Returns the number of DFA states that where constructed in the minimized version
-of //dfa//. Returns -1 on error.
-*/
-int pregex_dfa_minimize( pregex_dfa* dfa )
+/* State pair of the product construction in pregex_dfa_union() */
+typedef struct
 {
-	pregex_dfa_st*	dfa_st;
-	pregex_dfa_st*	grp_dfa_st;
-	pregex_dfa_tr*	ent;
+	int				left;		/* State of left DFA, -1 if none */
+	int				right;		/* State of right DFA, -1 if none */
 
-	plist*			min_states;
-	plist*			group;
-	plist*			groups;
-	plist*			newgroup;
+	int				next;		/* Next pair in same hash bucket (+1) */
+} pregex_dfa_pair;
 
+/* Returns an array of the states of //dfa//, for access by their offset. */
+static pregex_dfa_st** pregex_dfa_index( pregex_dfa* dfa )
+{
+	pregex_dfa_st**	sts;
 	plistel*		e;
-	plistel*		f;
-	plistel*		g;
-	plistel*		first;
-	plistel*		next;
-	plistel*		next_next;
-	int				i;
-	pboolean		changes		= TRUE;
+	int				i		= 0;
 
-	PROC( "pregex_dfa_minimize" );
-	PARMS( "dfa", "%p", dfa );
+	sts = (pregex_dfa_st**)pmalloc( ( plist_count( dfa->states ) + 1 )
+										* sizeof( pregex_dfa_st* ) );
 
-	if( !dfa )
+	plist_for( dfa->states, e )
+		sts[ i++ ] = (pregex_dfa_st*)plist_access( e );
+
+	return sts;
+}
+
+/* Get the offset of the state pair //left// and //right//, or insert it. The
+	hash table in //buckets// is doubled when it holds more pairs than buckets.
+	Sets //created// if the pair was inserted. */
+static int pregex_dfa_get_pair( parray* pairs, int** buckets, int* size,
+									int left, int right, pboolean* created )
+{
+	pregex_dfa_pair*	pair;
+	unsigned int		hash;
+	int					i;
+
+	hash = (unsigned int)left * 31 + (unsigned int)right;
+	*created = FALSE;
+
+	for( i = ( *buckets )[ hash % *size ]; i; i = pair->next )
 	{
-		WRONGPARAM;
-		RETURN( -1 );
+		pair = (pregex_dfa_pair*)parray_get( pairs, i - 1 );
+
+		if( pair->left == left && pair->right == right )
+			return i - 1;
 	}
 
-	groups = plist_create( 0, PLIST_MOD_PTR | PLIST_MOD_RECYCLE );
+	*created = TRUE;
 
-	MSG( "First, all states are grouped by accepting id" );
-	plist_for( dfa->states, e )
+	pair = (pregex_dfa_pair*)parray_malloc( pairs );
+	pair->left = left;
+	pair->right = right;
+
+	if( (int)parray_count( pairs ) > *size )
 	{
-		dfa_st = (pregex_dfa_st*)plist_access( e );
+		/* Grow the hash table and rehash all pairs */
+		*size *= 2;
+		*buckets = (int*)prealloc( *buckets, *size * sizeof( int ) );
+		memset( *buckets, 0, *size * sizeof( int ) );
 
-		plist_for( groups, f )
+		for( i = 0; i < (int)parray_count( pairs ); i++ )
 		{
-			group = (plist*)plist_access( f );
-			grp_dfa_st = (pregex_dfa_st*)plist_access( plist_first( group ) );
+			pair = (pregex_dfa_pair*)parray_get( pairs, i );
+			hash = (unsigned int)pair->left * 31 + (unsigned int)pair->right;
 
-			if( grp_dfa_st->accept == dfa_st->accept )
-				break;
+			pair->next = ( *buckets )[ hash % *size ];
+			( *buckets )[ hash % *size ] = i + 1;
 		}
+	}
+	else
+	{
+		pair->next = ( *buckets )[ hash % *size ];
+		( *buckets )[ hash % *size ] = parray_count( pairs );
+	}
 
-		if( !f )
-		{
-			group = plist_create( 0, PLIST_MOD_PTR | PLIST_MOD_RECYCLE );
-			if( !plist_push( group, dfa_st ) )
-				RETURN( -1 );
+	return parray_count( pairs ) - 1;
+}
 
-			if( !plist_push( groups, group ) )
-				RETURN( -1 );
-		}
-		else if( !plist_push( group, dfa_st ) )
-			RETURN( -1 );
-	}
+/* Adds a transition on //ccl// from //st// to the state of the pair //left//
+	and //right// in pregex_dfa_union(), which is created if necessary.
+	Transitions to the same state are merged. */
+static void pregex_dfa_union_trans( pregex_dfa* dfa, pregex_dfa_st* st,
+										parray* pairs, int** buckets,
+											int* size, pccl* ccl,
+												int left, int right )
+{
+	plistel*		e;
+	pregex_dfa_tr*	tr;
+	pccl*			un;
+	int				go_to;
+	pboolean		created;
 
-	MSG( "Perform the algorithm" );
-	while( changes )
+	go_to = pregex_dfa_get_pair( pairs, buckets, size, left, right, &created );
+
+	if( created )
+		pregex_dfa_create_state( dfa );
+
+	plist_for( st->trans, e )
 	{
-		MSG( "LOOP" );
-		VARS( "groups", "%d", plist_count( groups ) );
-		changes = FALSE;
+		tr = (pregex_dfa_tr*)plist_access( e );
 
-		plist_for( groups, e )
+		if( tr->go_to == go_to )
 		{
-			MSG( "Examining group" );
-			newgroup = (plist*)NULL;
+			un = p_ccl_union( tr->ccl, ccl );
+			p_ccl_free( tr->ccl );
+			tr->ccl = un;
+			return;
+		}
+	}
 
-			group = (plist*)plist_access( e );
+	tr = (pregex_dfa_tr*)plist_malloc( st->trans );
+	tr->ccl = p_ccl_dup( ccl );
+	tr->go_to = go_to;
+}
 
-			first = plist_first( group );
+/** Constructs the union of the DFAs //left// and //right// into //dfa//,
+which matches anything matched by any of both machines.
 
-			dfa_st = (pregex_dfa_st*)plist_access( first );
-			next_next = plist_next( first );
+This is done by product construction, where each state of //dfa// is a pair of
+states of //left// and //right//. On states accepting in both machines, the
+accepting ids of both are added by pregex_accept_add(), those of //left//
+first. This allows to combine DFAs constructed separately, e.g. by
+pregex_dfa_from_literals() and pregex_dfa_from_nfa().
 
-			while( ( next = next_next ) )
-			{
-				next_next = plist_next( next );
-				grp_dfa_st = (pregex_dfa_st*)plist_access( next );
+//dfa// is the pointer to the DFA-machine that will be constructed by this
+function. It is reset before it is used, and must be different from //left//
+and //right//.
 
-				VARS( "dfa_st", "%d", plist_offset(
-										plist_get_by_ptr(
-											dfa->states, dfa_st ) ) );
-				VARS( "grp_dfa_st", "%d", plist_offset(
-										plist_get_by_ptr(
-											dfa->states, grp_dfa_st ) ) );
-				VARS( "dfa_st->trans", "%p", dfa_st->trans );
-				VARS( "grp_dfa_st->trans", "%p", grp_dfa_st->trans );
+Returns the number of DFA states that where constructed.
+In case of an error, -1 is returned.
+*/
+int pregex_dfa_union( pregex_dfa* dfa, pregex_dfa* left, pregex_dfa* right )
+{
+	pregex_dfa_st**		lsts;
+	pregex_dfa_st**		rsts;
+	pregex_dfa_st*		current;
+	pregex_dfa_st*		l;
+	pregex_dfa_st*		r;
+	pregex_dfa_tr*		ltr;
+	pregex_dfa_tr*		rtr;
+	pregex_dfa_pair*	pair;
+	parray*				pairs;
+	plistel*			e;
+	plistel*			f;
+	plistel*			g;
+	pccl*				ccl;
+	pccl*				rest;
+	pccl*				del;
+	int*				buckets;
+	int					size		= 256;
+	int					done;
+	int					flags;
+	int					i;
+	unsigned int		accept;
+	pboolean			created;
+
+	PROC( "pregex_dfa_union" );
+	PARMS( "dfa", "%p", dfa );
+	PARMS( "left", "%p", left );
+	PARMS( "right", "%p", right );
 
-				/* Check for state equality */
-				if( !pregex_dfa_equal_states( dfa, groups,
-							dfa_st, grp_dfa_st ) )
-				{
-					MSG( "States aren't equal" );
-					MSG( "Removing state from current group" );
-					plist_remove( group, plist_get_by_ptr(
-											group, grp_dfa_st ) );
+	if( !( dfa && left && right && dfa != left && dfa != right
+			&& plist_count( left->states ) && plist_count( right->states ) ) )
+	{
+		WRONGPARAM;
+		RETURN( -1 );
+	}
 
-					if( !plist_count( group ) )
-						plist_remove( groups,
-							plist_get_by_ptr( groups, first ) );
+	pregex_dfa_reset( dfa );
 
-					MSG( "Appending state into new group" );
+	lsts = pregex_dfa_index( left );
+	rsts = pregex_dfa_index( right );
 
-					if( !newgroup )
-					{
-						if( !( newgroup =
-								plist_create( 0,
-									PLIST_MOD_PTR | PLIST_MOD_RECYCLE ) ) )
-							RETURN( -1 );
-					}
+	pairs = parray_create( sizeof( pregex_dfa_pair ), 0 );
+	buckets = (int*)pmalloc( size * sizeof( int ) );
 
-					if( !plist_push( newgroup, grp_dfa_st ) )
-						RETURN( -1 );
-				}
-			}
+	/* Starting seed */
+	pregex_dfa_get_pair( pairs, &buckets, &size, 0, 0, &created );
+	pregex_dfa_create_state( dfa );
 
-			VARS( "newgroup", "%p", newgroup );
-			if( newgroup )
-			{
-				MSG( "Engaging new group into list of groups" );
-				if( !plist_push( groups, newgroup ) )
-					RETURN( -1 );
+	/* New states are always appended, like in pregex_dfa_from_nfa() */
+	for( e = plist_first( dfa->states ), done = 0; e;
+			e = plist_next( e ), done++ )
+	{
+		current = (pregex_dfa_st*)plist_access( e );
+		pair = (pregex_dfa_pair*)parray_get( pairs, done );
 
-				changes = TRUE;
-			}
-		}
+		l = pair->left >= 0 ? lsts[ pair->left ] : (pregex_dfa_st*)NULL;
+		r = pair->right >= 0 ? rsts[ pair->right ] : (pregex_dfa_st*)NULL;
 
-		VARS( "changes", "%s", BOOLEAN_STR( changes ) );
-	}
+		/* Accept information and references */
+		for( i = 0; l && ( accept = pregex_accept_nth( l->accept, l->flags,
+											l->fallback, i, &flags ) ); i++ )
+			pregex_accept_add( &current->accept, &current->flags,
+								&current->fallback, accept, flags );
 
-	/* Now that we have all groups, reduce each group to one state */
-	plist_for( groups, e )
-	{
-		group = (plist*)plist_access( e );
-		grp_dfa_st = (pregex_dfa_st*)plist_access( plist_first( group ) );
+		for( i = 0; r && ( accept = pregex_accept_nth( r->accept, r->flags,
+											r->fallback, i, &flags ) ); i++ )
+			pregex_accept_add( &current->accept, &current->flags,
+								&current->fallback, accept, flags );
 
-		plist_for( grp_dfa_st->trans, f )
-		{
-			ent = (pregex_dfa_tr*)plist_access( f );
+		if( l )
+			current->refs = l->refs;
 
-			dfa_st = (pregex_dfa_st*)plist_access(
-										plist_get( dfa->states, ent->go_to ) );
+		if( r )
+			current->refs |= r->refs;
 
-			for( g = plist_first( groups ), i = 0;
-					g; g = plist_next( g ), i++ )
+		/* Transitions on characters of the left machine */
+		if( l )
+		{
+			plist_for( l->trans, f )
 			{
-				if( plist_get_by_ptr( (plist*)plist_access( g ), dfa_st ) )
+				ltr = (pregex_dfa_tr*)plist_access( f );
+				rest = p_ccl_dup( ltr->ccl );
+
+				if( r )
 				{
-					ent->go_to = i;
-					break;
+					plist_for( r->trans, g )
+					{
+						rtr = (pregex_dfa_tr*)plist_access( g );
+
+						if( !( ccl = p_ccl_intersect( ltr->ccl, rtr->ccl ) ) )
+							continue;
+
+						pregex_dfa_union_trans( dfa, current, pairs,
+													&buckets, &size, ccl,
+														ltr->go_to, rtr->go_to );
+
+						rest = p_ccl_diff( del = rest, ccl );
+						p_ccl_free( del );
+						p_ccl_free( ccl );
+					}
 				}
+
+				if( p_ccl_count( rest ) )
+					pregex_dfa_union_trans( dfa, current, pairs,
+												&buckets, &size, rest,
+													ltr->go_to, -1 );
+
+				p_ccl_free( rest );
 			}
 		}
-	}
-
-	/* Put leading group states into new, minimized dfa state machine */
-	min_states = plist_create( sizeof( pregex_dfa_st ), PLIST_MOD_RECYCLE );
 
-	plist_for( groups, e )
-	{
-		group = (plist*)plist_access( e );
+		/* Transitions on characters only of the right machine */
+		if( r )
+		{
+			plist_for( r->trans, g )
+			{
+				rtr = (pregex_dfa_tr*)plist_access( g );
+				rest = p_ccl_dup( rtr->ccl );
 
-		grp_dfa_st = (pregex_dfa_st*)plist_access( plist_first( group ) );
+				if( l )
+				{
+					plist_for( l->trans, f )
+					{
+						ltr = (pregex_dfa_tr*)plist_access( f );
 
-		/* Delete all states except the first one in the group */
-		for( f = plist_next( plist_first( group ) ); f; f = plist_next( f ) )
-		{
-			dfa_st = (pregex_dfa_st*)plist_access( f );
-			grp_dfa_st->refs |= dfa_st->refs;
-			pregex_dfa_delete_state( dfa_st );
-		}
+						rest = p_ccl_diff( del = rest, ltr->ccl );
+						p_ccl_free( del );
+					}
+				}
 
-		/* Push the first one into the minimized list */
-		plist_push( min_states, grp_dfa_st );
+				if( p_ccl_count( rest ) )
+					pregex_dfa_union_trans( dfa, current, pairs,
+												&buckets, &size, rest,
+													-1, rtr->go_to );
 
-		/* Free this group */
-		plist_free( group );
+				p_ccl_free( rest );
+			}
+		}
 	}
 
-	plist_free( groups );
-
-	/* Replace states by minimized list */
-	plist_free( dfa->states );
-	dfa->states = min_states;
+	pfree( lsts );
+	pfree( rsts );
+	pfree( buckets );
+	parray_free( pairs );
 
 	/* Set default transitions */
 	pregex_dfa_default_trans( dfa );
@@ -805,16 +984,371 @@ int pregex_dfa_minimize( pregex_dfa* dfa )
 	RETURN( plist_count( dfa->states ) );
 }
 
-/* !!!OBSOLETE!!! */
-/** Tries to match a pattern using a DFA state machine.
+/* Checks if the DFA states //a// and //b// are equal in their accepting ids,
+flags and references. */
+static pboolean pregex_dfa_same_accept( pregex_dfa_st* a, pregex_dfa_st* b )
+{
+	if( a->accept != b->accept || a->flags != b->flags || a->refs != b->refs )
+		return FALSE;
 
-//dfa// is the DFA state machine to be executed.
-//str// is the test string where the DFA should work on.
-//len// is the length of the match, -1 on error or no match.
+	if( !( a->fallback && b->fallback ) )
+		return a->fallback == b->fallback;
 
-//flags// are the flags to modify the DFA state machine matching behavior.
+	return *a->fallback == *b->fallback
+			&& !memcmp( a->fallback + 1, b->fallback + 1,
+							*a->fallback * 2 * sizeof( int ) );
+}
 
-Returns 0, if no match was found, else the id of the bestmost (=longest) match.
+/** Minimizes a DFA to lesser states by grouping equivalent states to new
+states, and transforming transitions to them.
+
+The minimization uses Hopcroft's partition refinement algorithm on the
+character segments of all transitions. States are initially grouped by their
+accepting id, flags and references, and groups are split using the inverse
+transitions of the groups waiting to be processed, always processing the
+smaller half of a split.
+
+//dfa// is the pointer to the DFA-machine that will be minimized. The content of
+//dfa// will be replaced with the reduced machine.
+
+Returns the number of DFA states that where constructed in the minimized version
+of //dfa//. Returns -1 on error.
+*/
+int pregex_dfa_minimize( pregex_dfa* dfa )
+{
+	pregex_dfa_st**	st;
+	pregex_dfa_tr*	tr;
+	plist*			min_states;
+	plistel*		e;
+	plistel*		next;
+	wchar_t*		bounds;
+	wchar_t*		seg;
+	wchar_t			from;
+	wchar_t			to;
+	int				n;
+	int				cnt;
+	int				syms;
+	int				blocks;
+	int				work_cnt;
+	int				touched_cnt;
+	int				split_cnt;
+	int				b;
+	int				nb;
+	int				s;
+	int				t;
+	int				pos;
+	int				i;
+	int				j;
+	int				k;
+	int*			delta;
+	int*			inv;
+	int*			inv_idx;
+	int*			elems;
+	int*			loc;
+	int*			blk;
+	int*			first;
+	int*			end;
+	int*			marked;
+	int*			work;
+	int*			touched;
+	int*			split;
+	int*			newidx;
+	int*			rep;
+	int*			group;
+	char*			in_work;
+	pregex_dfa_st	dead;
+
+	PROC( "pregex_dfa_minimize" );
+	PARMS( "dfa", "%p", dfa );
+
+	if( !dfa )
+	{
+		WRONGPARAM;
+		RETURN( -1 );
+	}
+
+	if( !( n = plist_count( dfa->states ) ) )
+		RETURN( 0 );
+
+	/* Number the states; State n is the implicit dead state */
+	st = (pregex_dfa_st**)pmalloc( ( n + 1 ) * sizeof( pregex_dfa_st* ) );
+
+	for( e = plist_first( dfa->states ), i = 0; e; e = plist_next( e ), i++ )
+		st[ i ] = (pregex_dfa_st*)plist_access( e );
+
+	memset( &dead, 0, sizeof( pregex_dfa_st ) );
+	st[ n ] = &dead;
+
+	MSG( "Splitting the character range into segments" );
+	for( cnt = i = 0; i < n; i++ )
+		plist_for( st[ i ]->trans, e )
+			cnt += p_ccl_size( ( (pregex_dfa_tr*)plist_access( e ) )->ccl );
+
+	bounds = (wchar_t*)pmalloc( ( cnt * 2 + 1 ) * sizeof( wchar_t ) );
+
+	for( cnt = i = 0; i < n; i++ )
+		plist_for( st[ i ]->trans, e )
+		{
+			tr = (pregex_dfa_tr*)plist_access( e );
+
+			for( j = 0; p_ccl_get( &from, &to, tr->ccl, j ); j++ )
+			{
+				bounds[ cnt++ ] = from;
+				bounds[ cnt++ ] = to + 1;
+			}
+		}
+
+	qsort( bounds, cnt, sizeof( wchar_t ), pregex_wchar_compare );
+
+	for( i = j = 0; i < cnt; i++ )
+		if( !j || bounds[ j - 1 ] != bounds[ i ] )
+			bounds[ j++ ] = bounds[ i ];
+
+	syms = j ? j - 1 : 0;
+	VARS( "syms", "%d", syms );
+
+	MSG( "Building the transition function and its inverse" );
+	delta = (int*)pmalloc( ( ( n + 1 ) * syms + 1 ) * sizeof( int ) );
+
+	for( i = 0; i < ( n + 1 ) * syms; i++ )
+		delta[ i ] = n;
+
+	for( i = 0; i < n; i++ )
+		plist_for( st[ i ]->trans, e )
+		{
+			tr = (pregex_dfa_tr*)plist_access( e );
+
+			for( j = 0; p_ccl_get( &from, &to, tr->ccl, j ); j++ )
+			{
+				seg = (wchar_t*)bsearch( &from, bounds, syms + 1,
+							sizeof( wchar_t ), pregex_wchar_compare );
+
+				for( k = seg - bounds; k < syms && bounds[ k ] <= to; k++ )
+					delta[ i * syms + k ] = tr->go_to;
+			}
+		}
+
+	pfree( bounds );
+
+	inv_idx = (int*)pmalloc( ( syms * ( n + 1 ) + 1 ) * sizeof( int ) );
+	inv = (int*)pmalloc( ( ( n + 1 ) * syms + 1 ) * sizeof( int ) );
+
+	for( s = 0; s <= n; s++ )
+		for( k = 0; k < syms; k++ )
+			inv_idx[ k * ( n + 1 ) + delta[ s * syms + k ] + 1 ]++;
+
+	for( i = 0; i < syms * ( n + 1 ); i++ )
+		inv_idx[ i + 1 ] += inv_idx[ i ];
+
+	for( s = 0; s <= n; s++ )
+		for( k = 0; k < syms; k++ )
+			inv[ inv_idx[ k * ( n + 1 ) + delta[ s * syms + k ] ]++ ] = s;
+
+	/* Restore the begin of each inverse transition list */
+	for( i = syms * ( n + 1 ); i > 0; i-- )
+		inv_idx[ i ] = inv_idx[ i - 1 ];
+
+	*inv_idx = 0;
+	pfree( delta );
+
+	MSG( "First, all states are grouped by accepting id, flags and references" );
+	elems = (int*)pmalloc( ( n + 1 ) * sizeof( int ) );
+	loc = (int*)pmalloc( ( n + 1 ) * sizeof( int ) );
+	blk = (int*)pmalloc( ( n + 1 ) * sizeof( int ) );
+	first = (int*)pmalloc( ( n + 1 ) * sizeof( int ) );
+	end = (int*)pmalloc( ( n + 1 ) * sizeof( int ) );
+	marked = (int*)pmalloc( ( n + 1 ) * sizeof( int ) );
+	work = (int*)pmalloc( ( n + 1 ) * sizeof( int ) );
+	touched = (int*)pmalloc( ( n + 1 ) * sizeof( int ) );
+	split = (int*)pmalloc( ( n + 1 ) * sizeof( int ) );
+	group = (int*)pmalloc( ( n + 1 ) * sizeof( int ) );
+	in_work = (char*)pmalloc( ( n + 1 ) * sizeof( char ) );
+
+	for( blocks = s = 0; s <= n; s++ )
+	{
+		for( b = 0; b < blocks; b++ )
+			if( pregex_dfa_same_accept( st[ group[ b ] ], st[ s ] ) )
+				break;
+
+		if( b == blocks )
+			group[ blocks++ ] = s;
+
+		blk[ s ] = b;
+		end[ b ]++;
+	}
+
+	for( b = 1; b < blocks; b++ )
+		end[ b ] += end[ b - 1 ];
+
+	for( s = n; s >= 0; s-- )
+	{
+		loc[ s ] = --end[ blk[ s ] ];
+		elems[ loc[ s ] ] = s;
+	}
+
+	for( work_cnt = b = 0; b < blocks; b++ )
+	{
+		first[ b ] = end[ b ];
+		end[ b ] = b + 1 < blocks ? end[ b + 1 ] : n + 1;
+
+		work[ work_cnt++ ] = b;
+		in_work[ b ] = TRUE;
+	}
+
+	pfree( group );
+
+	MSG( "Perform the algorithm" );
+	while( work_cnt )
+	{
+		b = work[ --work_cnt ];
+		in_work[ b ] = FALSE;
+
+		/* The splitter may be split itself, so take a copy */
+		split_cnt = end[ b ] - first[ b ];
+		memcpy( split, elems + first[ b ], split_cnt * sizeof( int ) );
+
+		for( k = 0; k < syms; k++ )
+		{
+			/* Move all predecessors to the front of their groups */
+			for( touched_cnt = i = 0; i < split_cnt; i++ )
+			{
+				t = k * ( n + 1 ) + split[ i ];
+
+				for( j = inv_idx[ t ]; j < inv_idx[ t + 1 ]; j++ )
+				{
+					s = inv[ j ];
+					b = blk[ s ];
+
+					if( loc[ s ] < first[ b ] + marked[ b ] )
+						continue;
+
+					if( !marked[ b ] )
+						touched[ touched_cnt++ ] = b;
+
+					/* Swap with the first unmarked state of the group */
+					pos = first[ b ] + marked[ b ]++;
+
+					elems[ loc[ s ] ] = elems[ pos ];
+					loc[ elems[ pos ] ] = loc[ s ];
+					elems[ pos ] = s;
+					loc[ s ] = pos;
+				}
+			}
+
+			/* Split the touched groups */
+			for( i = 0; i < touched_cnt; i++ )
+			{
+				b = touched[ i ];
+
+				if( marked[ b ] == end[ b ] - first[ b ] )
+				{
+					marked[ b ] = 0;
+					continue;
+				}
+
+				nb = blocks++;
+				first[ nb ] = first[ b ];
+				end[ nb ] = first[ b ] = first[ b ] + marked[ b ];
+				marked[ b ] = 0;
+
+				for( j = first[ nb ]; j < end[ nb ]; j++ )
+					blk[ elems[ j ] ] = nb;
+
+				if( in_work[ b ]
+						|| end[ nb ] - first[ nb ] <= end[ b ] - first[ b ] )
+					work[ work_cnt++ ] = nb;
+				else
+					work[ work_cnt++ ] = b;
+
+				in_work[ work[ work_cnt - 1 ] ] = TRUE;
+			}
+		}
+	}
+
+	VARS( "blocks", "%d", blocks );
+
+	pfree( inv );
+	pfree( inv_idx );
+	pfree( elems );
+	pfree( loc );
+	pfree( first );
+	pfree( end );
+	pfree( marked );
+	pfree( work );
+	pfree( touched );
+	pfree( split );
+	pfree( in_work );
+
+	/* Number the groups in order of their first state, the group of the dead
+		state is dropped */
+	newidx = (int*)pmalloc( blocks * sizeof( int ) );
+	rep = (int*)pmalloc( blocks * sizeof( int ) );
+
+	for( b = 0; b < blocks; b++ )
+		newidx[ b ] = -1;
+
+	for( cnt = s = 0; s < n; s++ )
+	{
+		if( newidx[ blk[ s ] ] < 0 && ( !s || blk[ s ] != blk[ n ] ) )
+		{
+			newidx[ blk[ s ] ] = cnt++;
+			rep[ blk[ s ] ] = s;
+		}
+	}
+
+	/* Put leading group states into new, minimized dfa state machine */
+	min_states = plist_create( sizeof( pregex_dfa_st ), PLIST_MOD_RECYCLE );
+
+	for( s = 0; s < n; s++ )
+	{
+		if( newidx[ blk[ s ] ] < 0 || rep[ blk[ s ] ] != s )
+		{
+			pregex_dfa_delete_state( st[ s ] );
+			continue;
+		}
+
+		for( e = plist_first( st[ s ]->trans ); e; e = next )
+		{
+			next = plist_next( e );
+			tr = (pregex_dfa_tr*)plist_access( e );
+
+			if( blk[ tr->go_to ] == blk[ n ] )
+			{
+				p_ccl_free( tr->ccl );
+				plist_remove( st[ s ]->trans, e );
+			}
+			else
+				tr->go_to = newidx[ blk[ tr->go_to ] ];
+		}
+
+		plist_push( min_states, st[ s ] );
+	}
+
+	pfree( newidx );
+	pfree( rep );
+	pfree( blk );
+	pfree( st );
+
+	/* Replace states by minimized list */
+	plist_free( dfa->states );
+	dfa->states = min_states;
+
+	/* Set default transitions */
+	pregex_dfa_default_trans( dfa );
+
+	RETURN( plist_count( dfa->states ) );
+}
+
+/* !!!OBSOLETE!!! */
+/** Tries to match a pattern using a DFA state machine.
+
+//dfa// is the DFA state machine to be executed.
+//str// is the test string where the DFA should work on.
+//len// is the length of the match, -1 on error or no match.
+
+//flags// are the flags to modify the DFA state machine matching behavior.
+
+Returns 0, if no match was found, else the id of the bestmost (=longest) match.
 */
 int pregex_dfa_match( pregex_dfa* dfa, char* str, size_t* len,
 		int* mflags, prange** ref, int* ref_count, int flags )
@@ -987,6 +1521,13 @@ its value is set to the number of all states. |
 | 7 | Transition: Goto-state |
 | ... | more triples follow for each transition |
 
+A state accepting several patterns with anchors holds the pattern with the
+lowest accepting id in its fields 1 and 2. If it has further patterns, its
+flags contain PREGEX_FLAG_FALLBACK, and the number of further patterns follows
+the transitions, with a pair of accepting id and flags for each pattern. These
+are tried in order by the matchers, when the anchors of the first one don't
+hold.
+
 
 Example for a state machine that matches the regular expression ``@[a-z0-9]+``
 that has match 1 and no references:
@@ -1078,11 +1619,22 @@ int pregex_dfa_to_dfatab( wchar_t*** dfatab, pregex_dfa* dfa )
 
 		VARS( "required( cnt )", "%d", cnt );
 
-		trans[ i ] = (wchar_t*)pmalloc( cnt * sizeof( wchar_t ) );
+		trans[ i ] = (wchar_t*)pmalloc( ( cnt + ( st->fallback ?
+									1 + *st->fallback * 2 : 0 ) )
+										* sizeof( wchar_t ) );
 
 		trans[ i ][ 0 ] = cnt;
 		trans[ i ][ 1 ] = st->accept;
 		trans[ i ][ 2 ] = st->flags;
+
+		/* Further accepting patterns follow the transitions */
+		if( st->fallback )
+		{
+			trans[ i ][ 2 ] |= PREGEX_FLAG_FALLBACK;
+
+			for( j = 0; j < 1 + *st->fallback * 2; j++ )
+				trans[ i ][ cnt + j ] = st->fallback[ j ];
+		}
 		trans[ i ][ 3 ] = st->refs;
 		trans[ i ][ 4 ] = st->def_trans ? st->def_trans->go_to :
 												plist_count( dfa->states );
@@ -1131,6 +1683,10 @@ int pregex_dfa_to_dfatab( wchar_t*** dfatab, pregex_dfa* dfa )
 							trans[i][j+2] );
 			}
 
+			for( j = 1; j < pregex_dfatab_fallback( trans[i] ); j += 2 )
+				fprintf( stderr, " acc=%2d flg=%2x",
+					trans[i][trans[i][0]+j], trans[i][trans[i][0]+j+1] );
+
 			fprintf( stderr, "\n" );
 
 			pfree( trans[i] );
@@ -1144,6 +1700,2603 @@ int pregex_dfa_to_dfatab( wchar_t*** dfatab, pregex_dfa* dfa )
 	RETURN( plist_count( dfa->states ) );
 }
 
+/** Returns the number of bytes used by the //dfatab// with //states// rows,
+as it is constructed by pregex_dfa_to_dfatab(). */
+size_t pregex_dfatab_size( wchar_t** dfatab, int states )
+{
+	size_t	size;
+	int		i;
+
+	if( !( dfatab && states >= 0 ) )
+	{
+		WRONGPARAM;
+		return 0;
+	}
+
+	for( size = states * sizeof( wchar_t* ), i = 0; i < states; i++ )
+		size += ( dfatab[ i ][ 0 ] + pregex_dfatab_fallback( dfatab[ i ] ) )
+					* sizeof( wchar_t );
+
+	return size;
+}
+
+/** Returns the accepting id of the pattern //i// of the dfatab //row//, and
+its flags into //flags//. Pattern 0 is held by the fields 1 and 2 of the row,
+all further ones follow the transitions when the row is flagged by
+PREGEX_FLAG_FALLBACK. A matcher takes the first pattern whose anchors hold.
+
+Returns 0 if there is no such pattern. */
+unsigned int pregex_dfatab_accept( wchar_t* row, int i, int* flags )
+{
+	if( !i )
+	{
+		*flags = row[ 2 ] & ~PREGEX_FLAG_FALLBACK;
+		return row[ 1 ];
+	}
+
+	if( i * 2 >= pregex_dfatab_fallback( row ) )
+		return 0;
+
+	*flags = row[ row[ 0 ] + i * 2 ];
+	return row[ row[ 0 ] + i * 2 - 1 ];
+}
+
+
+/* UTF-8 Byte DFA */
+
+#define PREGEX_UTF8_MAXCHAR	0x10FFFF
+#define PREGEX_UTF8_BUCKETS	256
+
+/* Byte ranges of a UTF-8 encoded character range, leading to a state */
+typedef struct
+{
+	int				len;			/* Number of byte ranges */
+	unsigned char	from	[ 4 ];	/* First bytes */
+	unsigned char	to		[ 4 ];	/* Last bytes */
+	int				go_to;			/* Goto state */
+} pregex_utf8_seq;
+
+/* State of the byte DFA, made up of the byte sequences still to be read */
+typedef struct
+{
+	pregex_utf8_seq*	seqs;		/* Remaining byte sequences */
+	int					cnt;		/* Number of sequences */
+	unsigned int		hash;		/* Hash value of seqs */
+	int					next;		/* Next state in hash bucket + 1 */
+	wchar_t*			row;		/* Compiled dfatab row */
+} pregex_utf8_st;
+
+/* Encodes //ch// as UTF-8 into //buf//, and returns its length. */
+static int pregex_utf8_encode( unsigned char* buf, wchar_t ch )
+{
+	if( ch < 0x80 )
+	{
+		buf[ 0 ] = (unsigned char)ch;
+		return 1;
+	}
+	else if( ch < 0x800 )
+	{
+		buf[ 0 ] = 0xC0 | ( ch >> 6 );
+		buf[ 1 ] = 0x80 | ( ch & 0x3F );
+		return 2;
+	}
+	else if( ch < 0x10000 )
+	{
+		buf[ 0 ] = 0xE0 | ( ch >> 12 );
+		buf[ 1 ] = 0x80 | ( ( ch >> 6 ) & 0x3F );
+		buf[ 2 ] = 0x80 | ( ch & 0x3F );
+		return 3;
+	}
+
+	buf[ 0 ] = 0xF0 | ( ch >> 18 );
+	buf[ 1 ] = 0x80 | ( ( ch >> 12 ) & 0x3F );
+	buf[ 2 ] = 0x80 | ( ( ch >> 6 ) & 0x3F );
+	buf[ 3 ] = 0x80 | ( ch & 0x3F );
+	return 4;
+}
+
+/* Splits the character range //from// to //to// into sequences of byte ranges
+that match exactly the UTF-8 encodings of the range, and pushes them with
+//go_to// to //seqs//. */
+static void pregex_utf8_split( parray* seqs, wchar_t from, wchar_t to,
+								int go_to )
+{
+	static const wchar_t	bounds[]	= { 0x7F, 0x7FF, 0xFFFF };
+	pregex_utf8_seq			seq;
+	unsigned char			buf			[ 4 ];
+	wchar_t					mask;
+	int						i;
+
+	/* Each sequence must have the same encoding length */
+	for( i = 0; i < sizeof( bounds ) / sizeof( *bounds ); i++ )
+		if( from <= bounds[ i ] && to > bounds[ i ] )
+		{
+			pregex_utf8_split( seqs, from, bounds[ i ], go_to );
+			pregex_utf8_split( seqs, bounds[ i ] + 1, to, go_to );
+			return;
+		}
+
+	memset( &seq, 0, sizeof( pregex_utf8_seq ) );
+	seq.len = pregex_utf8_encode( seq.from, from );
+
+	/* Trailing bytes must either cover their full range or share a prefix */
+	for( i = 1; i < seq.len; i++ )
+	{
+		mask = ( 1 << ( 6 * i ) ) - 1;
+
+		if( ( from & ~mask ) == ( to & ~mask ) )
+			continue;
+
+		if( from & mask )
+		{
+			pregex_utf8_split( seqs, from, from | mask, go_to );
+			pregex_utf8_split( seqs, ( from | mask ) + 1, to, go_to );
+			return;
+		}
+
+		if( ( to & mask ) != mask )
+		{
+			pregex_utf8_split( seqs, from, ( to & ~mask ) - 1, go_to );
+			pregex_utf8_split( seqs, to & ~mask, to, go_to );
+			return;
+		}
+	}
+
+	pregex_utf8_encode( buf, to );
+	memcpy( seq.to, buf, seq.len );
+	seq.go_to = go_to;
+
+	parray_push( seqs, &seq );
+}
+
+/* Get or insert the byte DFA state made up of //cnt// sequences //seqs//. */
+static int pregex_utf8_get_state( parray* sts, int* buckets,
+									pregex_utf8_seq* seqs, int cnt )
+{
+	pregex_utf8_st*	st;
+	unsigned int	hash	= cnt;
+	unsigned char*	ptr;
+	int				i;
+
+	for( ptr = (unsigned char*)seqs, i = 0;
+			i < cnt * sizeof( pregex_utf8_seq ); i++ )
+		hash = hash * 31 + ptr[ i ];
+
+	for( i = buckets[ hash % PREGEX_UTF8_BUCKETS ]; i; i = st->next )
+	{
+		st = (pregex_utf8_st*)parray_get( sts, i - 1 );
+
+		if( st->hash == hash && st->cnt == cnt
+				&& !memcmp( st->seqs, seqs, cnt * sizeof( pregex_utf8_seq ) ) )
+			return i - 1;
+	}
+
+	st = (pregex_utf8_st*)parray_malloc( sts );
+	st->seqs = (pregex_utf8_seq*)pmemdup( seqs,
+									cnt * sizeof( pregex_utf8_seq ) );
+	st->cnt = cnt;
+	st->hash = hash;
+
+	st->next = buckets[ hash % PREGEX_UTF8_BUCKETS ];
+	buckets[ hash % PREGEX_UTF8_BUCKETS ] = parray_count( sts );
+
+	return parray_count( sts ) - 1;
+}
+
+/** Rewrites the //dfatab// with //states// rows, as it is constructed by
+pregex_dfa_to_dfatab(), into an equivalent dfatab that runs on the bytes of
+UTF-8 encoded input instead of decoded characters.
+
+Every character range is split into sequences of byte ranges, which are
+connected by intermediate states. The states of the original //dfatab// keep
+their indexes, the intermediate states are appended and neither accept nor
+take references. Intermediate states with equal remaining byte sequences are
+shared. Characters beyond U+10FFFF and malformed UTF-8 never match.
+
+The rows of //dfatab// are replaced. The function returns the new number of
+states, or -1 in error case. */
+int pregex_dfatab_to_utf8( wchar_t*** dfatab, int states )
+{
+	wchar_t**			trans;
+	wchar_t*			row;
+	wchar_t*			ranges;
+	parray*				seqs;
+	parray*				sts;
+	pregex_utf8_st*		st;
+	pregex_utf8_seq*	cur;
+	pregex_utf8_seq*	sub;
+	int					buckets	[ PREGEX_UTF8_BUCKETS ];
+	int					target	[ 256 ];
+	int					cnt;
+	int					subcnt;
+	int					i;
+	int					j;
+	int					b;
+	wchar_t				ch;
+
+	PROC( "pregex_dfatab_to_utf8" );
+	PARMS( "dfatab", "%p", dfatab );
+	PARMS( "states", "%d", states );
+
+	if( !( dfatab && *dfatab && states > 0 ) )
+	{
+		WRONGPARAM;
+		RETURN( -1 );
+	}
+
+	trans = *dfatab;
+	seqs = parray_create( sizeof( pregex_utf8_seq ), 0 );
+	sts = parray_create( sizeof( pregex_utf8_st ), 0 );
+	memset( buckets, 0, sizeof( buckets ) );
+
+	/* The original states keep their indexes */
+	MSG( "Splitting character ranges into byte sequences" );
+
+	for( i = 0; i < states; i++ )
+	{
+		row = trans[ i ];
+		parray_erase( seqs );
+
+		ranges = (wchar_t*)pmalloc( ( ( row[ 0 ] - 5 ) / 3 * 2 + 1 )
+										* sizeof( wchar_t ) );
+
+		for( cnt = 0, j = 5; j < row[ 0 ]; j += 3 )
+		{
+			if( row[ j ] > PREGEX_UTF8_MAXCHAR )
+				continue;
+
+			ranges[ cnt++ ] = row[ j ];
+			ranges[ cnt++ ] = row[ j + 1 ] > PREGEX_UTF8_MAXCHAR ?
+									PREGEX_UTF8_MAXCHAR : row[ j + 1 ];
+
+			if( row[ j + 2 ] < states )
+				pregex_utf8_split( seqs, ranges[ cnt - 2 ],
+										ranges[ cnt - 1 ], row[ j + 2 ] );
+		}
+
+		/* The default transition covers all the gaps between the ranges */
+		if( row[ 4 ] < states )
+		{
+			qsort( ranges, cnt / 2, 2 * sizeof( wchar_t ),
+					pregex_wchar_compare );
+
+			for( ch = 0, j = 0; j < cnt; j += 2 )
+			{
+				if( ranges[ j ] > ch )
+					pregex_utf8_split( seqs, ch, ranges[ j ] - 1, row[ 4 ] );
+
+				if( ranges[ j + 1 ] + 1 > ch )
+					ch = ranges[ j + 1 ] + 1;
+			}
+
+			if( ch <= PREGEX_UTF8_MAXCHAR )
+				pregex_utf8_split( seqs, ch, PREGEX_UTF8_MAXCHAR, row[ 4 ] );
+		}
+
+		pfree( ranges );
+
+		st = (pregex_utf8_st*)parray_malloc( sts );
+		if( ( st->cnt = parray_count( seqs ) ) )
+			st->seqs = (pregex_utf8_seq*)pmemdup( parray_first( seqs ),
+										st->cnt * sizeof( pregex_utf8_seq ) );
+	}
+
+	/* Construct the rows; this appends intermediate states on demand */
+	MSG( "Constructing byte transitions" );
+
+	for( i = 0; i < parray_count( sts ); i++ )
+	{
+		st = (pregex_utf8_st*)parray_get( sts, i );
+		cur = st->seqs;
+		cnt = st->cnt;
+
+		sub = (pregex_utf8_seq*)pmalloc( ( cnt + 1 )
+											* sizeof( pregex_utf8_seq ) );
+
+		for( b = 0; b < 256; b++ )
+		{
+			target[ b ] = -1;
+
+			for( subcnt = 0, j = 0; j < cnt; j++ )
+			{
+				if( b < cur[ j ].from[ 0 ] || b > cur[ j ].to[ 0 ] )
+					continue;
+
+				if( cur[ j ].len == 1 )
+				{
+					target[ b ] = cur[ j ].go_to;
+					continue;
+				}
+
+				memset( &sub[ subcnt ], 0, sizeof( pregex_utf8_seq ) );
+				sub[ subcnt ].len = cur[ j ].len - 1;
+				memcpy( sub[ subcnt ].from, cur[ j ].from + 1,
+							sub[ subcnt ].len );
+				memcpy( sub[ subcnt ].to, cur[ j ].to + 1,
+							sub[ subcnt ].len );
+				sub[ subcnt++ ].go_to = cur[ j ].go_to;
+			}
+
+			if( subcnt )
+				target[ b ] = pregex_utf8_get_state( sts, buckets,
+														sub, subcnt );
+		}
+
+		pfree( sub );
+
+		/* Triples for runs of equal targets */
+		for( cnt = 5, b = 0; b < 256; b++ )
+			if( target[ b ] >= 0 && ( !b || target[ b - 1 ] != target[ b ] ) )
+				cnt += 3;
+
+		row = (wchar_t*)pmalloc( ( cnt + ( i < states ?
+									pregex_dfatab_fallback( trans[ i ] ) : 0 ) )
+										* sizeof( wchar_t ) );
+		row[ 0 ] = cnt;
+
+		if( i < states )
+		{
+			row[ 1 ] = trans[ i ][ 1 ];
+			row[ 2 ] = trans[ i ][ 2 ];
+			row[ 3 ] = trans[ i ][ 3 ];
+
+			memcpy( row + cnt, trans[ i ] + trans[ i ][ 0 ],
+						pregex_dfatab_fallback( trans[ i ] )
+							* sizeof( wchar_t ) );
+		}
+		else
+			row[ 1 ] = row[ 2 ] = row[ 3 ] = 0;
+
+		for( j = 5, b = 0; b < 256; b++ )
+		{
+			if( target[ b ] < 0 )
+				continue;
+
+			if( b && target[ b - 1 ] == target[ b ] )
+				row[ j - 2 ] = b;
+			else
+			{
+				row[ j++ ] = b;
+				row[ j++ ] = b;
+				row[ j++ ] = target[ b ];
+			}
+		}
+
+		/* Get the state again, sts may have been reallocated */
+		st = (pregex_utf8_st*)parray_get( sts, i );
+		st->row = row;
+	}
+
+	/* Replace the dfatab */
+	cnt = parray_count( sts );
+	VARS( "cnt", "%d", cnt );
+
+	for( i = 0; i < states; i++ )
+		pfree( trans[ i ] );
+
+	pfree( trans );
+
+	trans = (wchar_t**)pmalloc( cnt * sizeof( wchar_t* ) );
+
+	for( i = 0; i < cnt; i++ )
+	{
+		st = (pregex_utf8_st*)parray_get( sts, i );
+
+		trans[ i ] = st->row;
+		trans[ i ][ 4 ] = cnt;
+
+		pfree( st->seqs );
+	}
+
+	parray_free( sts );
+	parray_free( seqs );
+
+	*dfatab = trans;
+	RETURN( cnt );
+}
+
+/* Dense DFA Table Structure */
+
+/* Get the goto-state of a dfatab row //row// on character //ch//. */
+static int pregex_dfatab_goto( wchar_t* row, wchar_t ch )
+{
+	int		i;
+
+	for( i = 5; i < row[ 0 ]; i += 3 )
+		if( row[ i ] <= ch && row[ i + 1 ] >= ch )
+			return row[ i + 2 ];
+
+	return row[ 4 ];
+}
+
+/* Set up //accel// from the flagged bytes in //loops//. */
+static void pregex_accel_set( pregex_accel* accel, char* loops )
+{
+	int		i;
+
+	memcpy( accel->stay, loops, sizeof( accel->stay ) );
+
+	for( i = 1; i < 256; i++ )
+		if( !loops[ i ] && accel->cnt++ < 3 )
+			accel->leave[ accel->cnt - 1 ] = (char)i;
+}
+
+/* Detects states of //dense// with a self-loop, and sets up their byte sets
+for skipping over input staying in the state. Two entries are made per state:
+The first one for byte input, the second one for UTF-8 input, where all
+non-ASCII bytes stay in the state only when all non-ASCII characters do. */
+static void pregex_dense_accel( pregex_dense* dense, wchar_t** dfatab )
+{
+	char		loops	[ 256 ];
+	pboolean	u8loop;
+	int			i;
+	int			j;
+	wchar_t		ch;
+
+	for( i = 0; i < dense->states; i++ )
+	{
+		/* End-anchored accepting states, states falling back to further
+			patterns and states ending a search match must see every
+			position */
+		if( ( dfatab[ i ][ 1 ] && dfatab[ i ][ 2 ]
+								& ( PREGEX_FLAG_EOL | PREGEX_FLAG_EOW
+										| PREGEX_FLAG_FALLBACK ) )
+				|| dfatab[ i ][ 2 ] & PREGEX_SEARCH_ENDED )
+			continue;
+
+		for( *loops = 0, j = 0, ch = 1; ch < 256; ch++ )
+			if( ( loops[ ch ] = ( dense->trans[ i * dense->classes
+									+ dense->map[ ch ] ] == i ) ) )
+				j++;
+
+		if( !j )
+			continue;
+
+		if( !dense->accel )
+			dense->accel = (pregex_accel**)pmalloc(
+								dense->states * 2 * sizeof( pregex_accel* ) );
+
+		/* Byte input */
+		dense->accel[ i * 2 ] = (pregex_accel*)pmalloc( sizeof( pregex_accel ) );
+		pregex_accel_set( dense->accel[ i * 2 ], loops );
+
+		/* UTF-8 input */
+		u8loop = dfatab[ i ][ 4 ] == i;
+
+		for( j = 5; u8loop && j < dfatab[ i ][ 0 ]; j += 3 )
+			if( dfatab[ i ][ j + 1 ] >= 0x80 && dfatab[ i ][ j + 2 ] != i )
+				u8loop = FALSE;
+
+		for( ch = 0x80; ch < 256; ch++ )
+			loops[ ch ] = u8loop;
+
+		dense->accel[ i * 2 + 1 ] = (pregex_accel*)pmalloc(
+											sizeof( pregex_accel ) );
+		pregex_accel_set( dense->accel[ i * 2 + 1 ], loops );
+	}
+}
+
+/* Compiles the reference flags of the states in //dfatab// into tag lists of
+//dense//, holding the indexes of the references a state sets, terminated by
+PREGEX_MAXREF. No lists are made when no state takes references.
+
+This only shortens the loop recording the references of a state; references
+stay bound to states, and are not tags of the transitions. */
+static void pregex_dense_tags( pregex_dense* dense, wchar_t** dfatab )
+{
+	unsigned char*	ops;
+	int				cnt		= 0;
+	int				i;
+	int				j;
+
+	for( i = 0; i < dense->states; i++ )
+		for( j = 0; dfatab[ i ][ 3 ] && j <= PREGEX_MAXREF; j++ )
+			if( j == PREGEX_MAXREF || dfatab[ i ][ 3 ] & ( 1 << j ) )
+				cnt++;
+
+	if( !cnt )
+		return;
+
+	/* Pointers and lists share one allocation */
+	dense->tags = (unsigned char**)pmalloc( dense->states
+								* sizeof( unsigned char* ) + cnt );
+	ops = (unsigned char*)( dense->tags + dense->states );
+
+	for( i = 0; i < dense->states; i++ )
+	{
+		if( !dfatab[ i ][ 3 ] )
+			continue;
+
+		dense->tags[ i ] = ops;
+
+		for( j = 0; j < PREGEX_MAXREF; j++ )
+			if( dfatab[ i ][ 3 ] & ( 1 << j ) )
+				*ops++ = (unsigned char)j;
+
+		*ops++ = PREGEX_MAXREF;
+	}
+}
+
+/* Collects the first characters of all character segments of //dfatab//,
+which are ranges where all characters behave equally in every state. */
+static int pregex_dfatab_segments( wchar_t** dfatab, int states,
+										wchar_t** segs )
+{
+	wchar_t*	seg;
+	int			cnt		= 1;
+	int			i;
+	int			j;
+
+	for( i = 0; i < states; i++ )
+		cnt += ( dfatab[ i ][ 0 ] - 5 ) / 3 * 2;
+
+	seg = (wchar_t*)pmalloc( cnt * sizeof( wchar_t ) );
+
+	for( cnt = 1, i = 0; i < states; i++ )
+		for( j = 5; j < dfatab[ i ][ 0 ]; j += 3 )
+		{
+			seg[ cnt++ ] = dfatab[ i ][ j ];
+
+			if( dfatab[ i ][ j + 1 ] < WCHAR_MAX )
+				seg[ cnt++ ] = dfatab[ i ][ j + 1 ] + 1;
+		}
+
+	qsort( seg, cnt, sizeof( wchar_t ), pregex_wchar_compare );
+
+	for( i = j = 1; i < cnt; i++ )
+		if( seg[ i ] != seg[ j - 1 ] )
+			seg[ j++ ] = seg[ i ];
+
+	*segs = seg;
+	return j;
+}
+
+#define PREGEX_COMB_BUCKETS	256
+
+/* Fills //gotos// with the goto-states of //row// for each of the //cnt//
+character segments starting at //segs//. */
+static void pregex_comb_row( wchar_t* row, wchar_t* segs, int cnt, int* gotos )
+{
+	int		lo;
+	int		hi;
+	int		mid;
+	int		i;
+
+	for( i = 0; i < cnt; i++ )
+		gotos[ i ] = row[ 4 ];
+
+	/* Ranges are filled in reverse order, so the first one wins */
+	for( i = row[ 0 ] - 3; i >= 5; i -= 3 )
+	{
+		for( lo = 0, hi = cnt; lo < hi; )
+		{
+			mid = ( lo + hi ) / 2;
+
+			if( segs[ mid ] < row[ i ] )
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+
+		for( ; lo < cnt && segs[ lo ] <= row[ i + 1 ]; lo++ )
+			gotos[ lo ] = row[ i + 2 ];
+	}
+}
+
+/* Computes the goto-states of //row// per class into //line//, using the
+representative segments //rep// of the //classes// classes, and returns the
+most frequent goto-state. //freq// must be zeroed, and is left zeroed. */
+static int pregex_comb_line( wchar_t* row, wchar_t* segs, int cnt,
+								int* rep, int classes, int* gotos, int* line,
+									int* freq )
+{
+	int		k;
+	int		j;
+
+	pregex_comb_row( row, segs, cnt, gotos );
+
+	for( k = 0, j = 0; j < classes; j++ )
+	{
+		line[ j ] = gotos[ rep[ j ] ];
+
+		if( ++freq[ line[ j ] ] > freq[ k ] )
+			k = line[ j ];
+	}
+
+	for( j = 0; j < classes; j++ )
+		freq[ line[ j ] ] = 0;
+
+	return k;
+}
+
+/* Compiles the comb-vector table for the characters up to PCCL_MAX from
+//dfatab// with //states// rows.
+
+The character segments of //dfatab// are merged into classes which behave
+equally in every state, by refining the partition of the segments with the
+goto-states of one row after another. The class map is split into blocks of
+256 characters, and equal blocks are shared.
+
+Every row is then reduced to the entries which differ from its most frequent
+goto-state. When this is a state which mostly loops into itself, like the
+state inside of an identifier, the row is instead reduced to the entries which
+differ from the row of that state, which becomes its template. States with
+equal rows share one row, and the distinct rows are overlaid by first-fit into
+one next-vector, where a check-vector keeps the owning row of every entry.
+
+Returns (pregex_comb*)NULL if the table can't be expressed with 16-bit state
+and class ids. */
+static pregex_comb* pregex_comb_create( wchar_t** dfatab, int states )
+{
+	pregex_comb*	comb;
+	wchar_t*		segs;
+	int*			gotos;
+	int*			cls;
+	int*			rep;
+	int*			hcls;
+	int*			hgoto;
+	int*			hval;
+	int*			freq;
+	int*			line;
+	int*			tline;
+	int*			ent;
+	int*			kdef;
+	int*			base;
+	int*			rcnt;
+	int*			chain;
+	unsigned int*	rhash;
+	unsigned int	hash;
+	uint16_t*		row;
+	uint16_t*		def;
+	uint16_t*		tmpl;
+	uint16_t*		map;
+	uint16_t*		next		= (uint16_t*)NULL;
+	uint16_t*		check		= (uint16_t*)NULL;
+	uint16_t		page		[ PREGEX_COMB_PAGES ];
+	int				bucket		[ PREGEX_COMB_BUCKETS ];
+	int				cnt;
+	int				classes;
+	int				blocks		= 0;
+	int				rows		= 0;
+	int				hsize;
+	int				h;
+	int				i;
+	int				j;
+	int				k;
+	int				n;
+	int				t;
+	int				r;
+	int				b;
+	int				size		= 0;
+	int				alloc		= 0;
+	int				lowfree		= 0;
+	size_t			bytes;
+	char*			ptr;
+
+	if( states >= UINT16_MAX )
+		return (pregex_comb*)NULL;
+
+	/* Segments beyond PCCL_MAX are not part of the table */
+	for( cnt = pregex_dfatab_segments( dfatab, states, &segs );
+			segs[ cnt - 1 ] > PCCL_MAX; cnt-- )
+		;
+
+	gotos = (int*)pmalloc( cnt * sizeof( int ) );
+	cls = (int*)pmalloc( cnt * sizeof( int ) );
+
+	for( hsize = 16; hsize < cnt * 2; hsize *= 2 )
+		;
+
+	hcls = (int*)pmalloc( hsize * sizeof( int ) );
+	hgoto = (int*)pmalloc( hsize * sizeof( int ) );
+	hval = (int*)pmalloc( hsize * sizeof( int ) );
+
+	/* Refine the classes of segments by the goto-states of every row */
+	for( classes = 1, i = 0; i < states && classes < cnt; i++ )
+	{
+		pregex_comb_row( dfatab[ i ], segs, cnt, gotos );
+		memset( hval, -1, hsize * sizeof( int ) );
+
+		for( n = 0, k = 0; k < cnt; k++ )
+		{
+			for( h = ( cls[ k ] * 31 + gotos[ k ] ) & ( hsize - 1 );
+					hval[ h ] >= 0
+						&& !( hcls[ h ] == cls[ k ] && hgoto[ h ] == gotos[ k ] );
+							h = ( h + 1 ) & ( hsize - 1 ) )
+				;
+
+			if( hval[ h ] < 0 )
+			{
+				hcls[ h ] = cls[ k ];
+				hgoto[ h ] = gotos[ k ];
+				hval[ h ] = n++;
+			}
+
+			cls[ k ] = hval[ h ];
+		}
+
+		classes = n;
+	}
+
+	pfree( hcls );
+	pfree( hgoto );
+	pfree( hval );
+
+	if( classes > UINT16_MAX )
+	{
+		pfree( segs );
+		pfree( gotos );
+		pfree( cls );
+		return (pregex_comb*)NULL;
+	}
+
+	/* Build the class map, and share equal blocks */
+	map = (uint16_t*)pmalloc( ( PCCL_MAX + 1 ) * sizeof( uint16_t ) );
+
+	for( k = 0; k < cnt; k++ )
+		for( j = segs[ k ]; j < ( k + 1 < cnt ? segs[ k + 1 ] : PCCL_MAX + 1 );
+				j++ )
+			map[ j ] = (uint16_t)cls[ k ];
+
+	for( i = 0; i < PREGEX_COMB_PAGES; i++ )
+	{
+		for( j = 0; j < blocks; j++ )
+			if( !memcmp( map + j * 256, map + i * 256,
+							256 * sizeof( uint16_t ) ) )
+				break;
+
+		if( j == blocks )
+		{
+			if( j != i )
+				memcpy( map + j * 256, map + i * 256,
+							256 * sizeof( uint16_t ) );
+
+			blocks++;
+		}
+
+		page[ i ] = (uint16_t)j;
+	}
+
+	/* Pick one representative segment per class */
+	rep = (int*)pmalloc( classes * sizeof( int ) );
+
+	for( k = cnt - 1; k >= 0; k-- )
+		rep[ cls[ k ] ] = k;
+
+	/* Find the most frequent goto-state of every row */
+	freq = (int*)pmalloc( ( states + 1 ) * sizeof( int ) );
+	line = (int*)pmalloc( classes * sizeof( int ) );
+	tline = (int*)pmalloc( classes * sizeof( int ) );
+	kdef = (int*)pmalloc( states * sizeof( int ) );
+
+	for( i = 0; i < states; i++ )
+		kdef[ i ] = pregex_comb_line( dfatab[ i ], segs, cnt, rep, classes,
+										gotos, line, freq );
+
+	/* Overlay all distinct rows into the next- and check-vectors */
+	ent = (int*)pmalloc( classes * sizeof( int ) );
+	row = (uint16_t*)pmalloc( states * sizeof( uint16_t ) );
+	base = (int*)pmalloc( states * sizeof( int ) );
+	def = (uint16_t*)pmalloc( states * sizeof( uint16_t ) );
+	tmpl = (uint16_t*)pmalloc( states * sizeof( uint16_t ) );
+	rhash = (unsigned int*)pmalloc( states * sizeof( unsigned int ) );
+	rcnt = (int*)pmalloc( states * sizeof( int ) );
+	chain = (int*)pmalloc( states * sizeof( int ) );
+
+	memset( bucket, -1, sizeof( bucket ) );
+
+	for( i = 0; i < states; i++ )
+	{
+		k = pregex_comb_line( dfatab[ i ], segs, cnt, rep, classes,
+								gotos, line, freq );
+
+		for( n = 0, j = 0; j < classes; j++ )
+			if( line[ j ] != k )
+				ent[ n++ ] = j;
+
+		/* Try the row of the default goto-state as template */
+		t = UINT16_MAX;
+
+		if( n && k < states && k != i && kdef[ k ] == k )
+		{
+			pregex_comb_line( dfatab[ k ], segs, cnt, rep, classes,
+								gotos, tline, freq );
+
+			for( h = 0, j = 0; j < classes && h < n; j++ )
+				if( line[ j ] != tline[ j ] )
+					h++;
+
+			if( h < n )
+			{
+				for( t = k, n = 0, j = 0; j < classes; j++ )
+					if( line[ j ] != tline[ j ] )
+						ent[ n++ ] = j;
+			}
+		}
+
+		for( hash = k * 31 + t, j = 0; j < n; j++ )
+			hash = ( hash * 31 + ent[ j ] ) * 31 + line[ ent[ j ] ];
+
+		/* States with equal rows share them */
+		for( r = bucket[ hash % PREGEX_COMB_BUCKETS ]; r >= 0; r = chain[ r ] )
+		{
+			if( rhash[ r ] != hash || rcnt[ r ] != n
+					|| def[ r ] != k || tmpl[ r ] != t )
+				continue;
+
+			for( j = 0; j < n; j++ )
+				if( check[ base[ r ] + ent[ j ] ] != r
+						|| next[ base[ r ] + ent[ j ] ] != line[ ent[ j ] ] )
+					break;
+
+			if( j == n )
+				break;
+		}
+
+		if( r >= 0 )
+		{
+			row[ i ] = (uint16_t)r;
+			continue;
+		}
+
+		r = rows++;
+		row[ i ] = (uint16_t)r;
+		def[ r ] = (uint16_t)k;
+		tmpl[ r ] = (uint16_t)t;
+		rhash[ r ] = hash;
+		rcnt[ r ] = n;
+		chain[ r ] = bucket[ hash % PREGEX_COMB_BUCKETS ];
+		bucket[ hash % PREGEX_COMB_BUCKETS ] = r;
+
+		/* First-fit displacement */
+		for( b = n && lowfree > ent[ 0 ] ? lowfree - ent[ 0 ] : 0; n; b++ )
+		{
+			for( j = 0; j < n; j++ )
+				if( b + ent[ j ] < size && check[ b + ent[ j ] ] != UINT16_MAX )
+					break;
+
+			if( j == n )
+				break;
+		}
+
+		base[ r ] = b;
+
+		if( b + classes > size )
+		{
+			if( b + classes > alloc )
+			{
+				alloc = ( b + classes ) * 2;
+				next = (uint16_t*)prealloc( next, alloc * sizeof( uint16_t ) );
+				check = (uint16_t*)prealloc( check,
+												alloc * sizeof( uint16_t ) );
+			}
+
+			for( ; size < b + classes; size++ )
+				check[ size ] = UINT16_MAX;
+		}
+
+		for( j = 0; j < n; j++ )
+		{
+			next[ b + ent[ j ] ] = (uint16_t)line[ ent[ j ] ];
+			check[ b + ent[ j ] ] = (uint16_t)r;
+		}
+
+		while( lowfree < size && check[ lowfree ] != UINT16_MAX )
+			lowfree++;
+	}
+
+	/* Put everything into one allocation */
+	bytes = sizeof( pregex_comb ) + rows * sizeof( int )
+				+ ( PREGEX_COMB_PAGES + blocks * 256 + states + rows * 2
+					+ size * 2 ) * sizeof( uint16_t );
+
+	comb = (pregex_comb*)pmalloc( bytes );
+
+	comb->classes = classes;
+	comb->blocks = blocks;
+	comb->rows = rows;
+	comb->size = size;
+	comb->bytes = bytes;
+
+	ptr = (char*)( comb + 1 );
+
+	comb->base = (int*)ptr;
+	memcpy( comb->base, base, rows * sizeof( int ) );
+	ptr += rows * sizeof( int );
+
+	comb->page = (uint16_t*)ptr;
+	memcpy( comb->page, page, sizeof( page ) );
+	ptr += sizeof( page );
+
+	comb->map = (uint16_t*)ptr;
+	memcpy( comb->map, map, blocks * 256 * sizeof( uint16_t ) );
+	ptr += blocks * 256 * sizeof( uint16_t );
+
+	comb->row = (uint16_t*)ptr;
+	memcpy( comb->row, row, states * sizeof( uint16_t ) );
+	ptr += states * sizeof( uint16_t );
+
+	comb->def = (uint16_t*)ptr;
+	memcpy( comb->def, def, rows * sizeof( uint16_t ) );
+	ptr += rows * sizeof( uint16_t );
+
+	comb->tmpl = (uint16_t*)ptr;
+	memcpy( comb->tmpl, tmpl, rows * sizeof( uint16_t ) );
+	ptr += rows * sizeof( uint16_t );
+
+	comb->next = (uint16_t*)ptr;
+	memcpy( comb->next, next, size * sizeof( uint16_t ) );
+	ptr += size * sizeof( uint16_t );
+
+	comb->check = (uint16_t*)ptr;
+	memcpy( comb->check, check, size * sizeof( uint16_t ) );
+
+	pfree( segs );
+	pfree( gotos );
+	pfree( cls );
+	pfree( map );
+	pfree( rep );
+	pfree( freq );
+	pfree( line );
+	pfree( tline );
+	pfree( kdef );
+	pfree( ent );
+	pfree( row );
+	pfree( base );
+	pfree( def );
+	pfree( tmpl );
+	pfree( rhash );
+	pfree( rcnt );
+	pfree( chain );
+	pfree( next );
+	pfree( check );
+
+	return comb;
+}
+
+/* Get the goto-state of //state// with the dfatab row //row// on character
+//ch//, using the comb-vector table //comb// when provided. */
+static int pregex_comb_goto( pregex_comb* comb, wchar_t* row,
+								int state, wchar_t ch )
+{
+	int		c;
+	int		r;
+	int		i;
+
+	if( !comb || (unsigned int)ch > PCCL_MAX )
+		return pregex_dfatab_goto( row, ch );
+
+	c = comb->map[ comb->page[ ch >> 8 ] * 256 + ( ch & 0xFF ) ];
+	r = comb->row[ state ];
+	i = comb->base[ r ] + c;
+
+	if( comb->check[ i ] == r )
+		return comb->next[ i ];
+
+	/* Entries not in the row are taken from its template */
+	if( comb->tmpl[ r ] != UINT16_MAX )
+	{
+		r = comb->row[ comb->tmpl[ r ] ];
+		i = comb->base[ r ] + c;
+
+		if( comb->check[ i ] == r )
+			return comb->next[ i ];
+	}
+
+	return comb->def[ r ];
+}
+
+/** Skips the input at //ptr// over all bytes staying in the state of //accel//.
+//stop// is the end of the input, or (char*)NULL for zero-terminated input.
+Returns the pointer to the first byte leaving the state, which is at least the
+terminating zero-byte or //stop//. */
+char* pregex_accel_skip( pregex_accel* accel, char* ptr, char* stop )
+{
+	/* Bounded input; Nothing behind stop may be read */
+	if( stop )
+	{
+#if defined( __SSE2__ ) && defined( __GNUC__ )
+		if( accel->cnt <= 3 )
+		{
+			char	c1	= accel->cnt ? accel->leave[ 0 ] : 0;
+			char	c2	= accel->cnt > 1 ? accel->leave[ 1 ] : c1;
+			char	c3	= accel->cnt > 2 ? accel->leave[ 2 ] : c1;
+			int		mask;
+			__m128i	v0	= _mm_setzero_si128();
+			__m128i	v1	= _mm_set1_epi8( c1 );
+			__m128i	v2	= _mm_set1_epi8( c2 );
+			__m128i	v3	= _mm_set1_epi8( c3 );
+			__m128i	data;
+
+			for( ; stop - ptr >= 16; ptr += 16 )
+			{
+				data = _mm_loadu_si128( (__m128i*)ptr );
+
+				if( ( mask = _mm_movemask_epi8(
+						_mm_or_si128(
+							_mm_or_si128( _mm_cmpeq_epi8( data, v0 ),
+											_mm_cmpeq_epi8( data, v1 ) ),
+							_mm_or_si128( _mm_cmpeq_epi8( data, v2 ),
+											_mm_cmpeq_epi8( data, v3 ) )
+							) ) ) )
+					return ptr + __builtin_ctz( mask );
+			}
+		}
+#endif
+
+		while( ptr < stop && accel->stay[ (unsigned char)*ptr ] )
+			ptr++;
+
+		return ptr;
+	}
+
+#if defined( __SSE2__ ) && defined( __GNUC__ )
+	/* Few leaving bytes are searched with SIMD compares */
+	if( accel->cnt <= 3 )
+	{
+		char	c1	= accel->cnt ? accel->leave[ 0 ] : 0;
+		char	c2	= accel->cnt > 1 ? accel->leave[ 1 ] : c1;
+		char	c3	= accel->cnt > 2 ? accel->leave[ 2 ] : c1;
+		int		mask;
+
+#ifdef __AVX2__
+		__m256i	v0	= _mm256_setzero_si256();
+		__m256i	v1	= _mm256_set1_epi8( c1 );
+		__m256i	v2	= _mm256_set1_epi8( c2 );
+		__m256i	v3	= _mm256_set1_epi8( c3 );
+		__m256i	data;
+
+		/* Aligned loads never cross a page boundary */
+		for( ; (uintptr_t)ptr & 31; ptr++ )
+			if( !*ptr || *ptr == c1 || *ptr == c2 || *ptr == c3 )
+				return ptr;
+
+		while( TRUE )
+		{
+			data = _mm256_load_si256( (__m256i*)ptr );
+
+			if( ( mask = _mm256_movemask_epi8(
+					_mm256_or_si256(
+						_mm256_or_si256( _mm256_cmpeq_epi8( data, v0 ),
+											_mm256_cmpeq_epi8( data, v1 ) ),
+						_mm256_or_si256( _mm256_cmpeq_epi8( data, v2 ),
+											_mm256_cmpeq_epi8( data, v3 ) )
+						) ) ) )
+				return ptr + __builtin_ctz( mask );
+
+			ptr += 32;
+		}
+#else
+		__m128i	v0	= _mm_setzero_si128();
+		__m128i	v1	= _mm_set1_epi8( c1 );
+		__m128i	v2	= _mm_set1_epi8( c2 );
+		__m128i	v3	= _mm_set1_epi8( c3 );
+		__m128i	data;
+
+		/* Aligned loads never cross a page boundary */
+		for( ; (uintptr_t)ptr & 15; ptr++ )
+			if( !*ptr || *ptr == c1 || *ptr == c2 || *ptr == c3 )
+				return ptr;
+
+		while( TRUE )
+		{
+			data = _mm_load_si128( (__m128i*)ptr );
+
+			if( ( mask = _mm_movemask_epi8(
+					_mm_or_si128(
+						_mm_or_si128( _mm_cmpeq_epi8( data, v0 ),
+										_mm_cmpeq_epi8( data, v1 ) ),
+						_mm_or_si128( _mm_cmpeq_epi8( data, v2 ),
+										_mm_cmpeq_epi8( data, v3 ) )
+						) ) ) )
+				return ptr + __builtin_ctz( mask );
+
+			ptr += 16;
+		}
+#endif
+	}
+#endif
+
+	while( accel->stay[ (unsigned char)*ptr ] )
+		ptr++;
+
+	return ptr;
+}
+
+/** Compiles a dense transition table from the //dfatab// with //states// rows,
+as it is constructed by pregex_dfa_to_dfatab().
+
+All characters in the range from 0 to 255 are grouped into character classes
+first, where characters of one class have the same transition behavior in every
+state of the DFA. Every state is then stored as a flat row of goto-states,
+indexed by the character class, and a 256-entry character to class map is
+provided, so that a transition can be obtained with one lookup.
+
+Characters beyond this range are not covered by the byte map. When the DFA
+makes any transition on them, a comb-vector table (pregex_comb) is compiled for
+the characters up to PCCL_MAX: Its character classes are mapped by shared
+blocks of 256 characters, and its rows are stored as displacements into one
+vector of 16-bit goto-states, with a check-vector of the owning rows, all
+in one allocation. Each transition is obtained in constant time this way,
+instead of searching the transition triples of the //dfatab//. The comb-vector
+table is only kept when it is smaller than the //dfatab//.
+
+Returns a pointer to the allocated pregex_dense-object, which must be released
+using pregex_dense_free(). The function returns (pregex_dense*)NULL if no dense
+table can be constructed, e.g. when the DFA has too many states.
+*/
+pregex_dense* pregex_dense_create( wchar_t** dfatab, int states )
+{
+	pregex_dense*	dense;
+	uint16_t*		seg_trans;
+	char			border	[ 256 ];
+	unsigned char	seg		[ 256 ];
+	int				cls		[ 256 ];
+	unsigned int	hash	[ 256 ];
+	int				segs;
+	int				i;
+	int				j;
+	int				k;
+	wchar_t			ch;
+	pboolean		wide	= FALSE;
+
+	PROC( "pregex_dense_create" );
+	PARMS( "dfatab", "%p", dfatab );
+	PARMS( "states", "%d", states );
+
+	if( !( dfatab && states > 0 ) )
+	{
+		WRONGPARAM;
+		RETURN( (pregex_dense*)NULL );
+	}
+
+	if( states > UINT16_MAX )
+	{
+		MSG( "Too many states for a dense table" );
+		RETURN( (pregex_dense*)NULL );
+	}
+
+	/* Mark the borders of all character ranges */
+	memset( border, 0, sizeof( border ) );
+	*border = 1;
+
+	for( i = 0; i < states; i++ )
+		for( j = 5; j < dfatab[ i ][ 0 ]; j += 3 )
+		{
+			if( dfatab[ i ][ j ] < 256 )
+				border[ dfatab[ i ][ j ] ] = 1;
+
+			if( dfatab[ i ][ j + 1 ] < 255 )
+				border[ dfatab[ i ][ j + 1 ] + 1 ] = 1;
+			else if( dfatab[ i ][ j + 1 ] > 255 )
+				wide = TRUE;
+		}
+
+	/* Every border opens a new segment of equivalent characters */
+	for( ch = 0, segs = 0; ch < 256; ch++ )
+	{
+		if( border[ ch ] )
+			segs++;
+
+		seg[ ch ] = segs - 1;
+	}
+
+	VARS( "segs", "%d", segs );
+
+	/* Construct a transition column for every segment */
+	seg_trans = (uint16_t*)pmalloc( states * segs * sizeof( uint16_t ) );
+
+	for( ch = 0; ch < 256; ch++ )
+	{
+		if( !border[ ch ] )
+			continue;
+
+		for( i = 0; i < states; i++ )
+			seg_trans[ i * segs + seg[ ch ] ] =
+				(uint16_t)pregex_dfatab_goto( dfatab[ i ], ch );
+	}
+
+	/* Merge equal columns into one character class */
+	dense = (pregex_dense*)pmalloc( sizeof( pregex_dense ) );
+	dense->states = states;
+
+	for( j = 0; j < segs; j++ )
+	{
+		for( hash[ j ] = 0, i = 0; i < states; i++ )
+			hash[ j ] = hash[ j ] * 31 + seg_trans[ i * segs + j ];
+
+		for( k = 0; k < j; k++ )
+		{
+			if( cls[ k ] != k || hash[ k ] != hash[ j ] )
+				continue;
+
+			for( i = 0; i < states; i++ )
+				if( seg_trans[ i * segs + k ] != seg_trans[ i * segs + j ] )
+					break;
+
+			if( i == states )
+				break;
+		}
+
+		cls[ j ] = k;
+	}
+
+	/* Renumber the classes, and build the character map */
+	for( j = 0; j < segs; j++ )
+		if( cls[ j ] == j )
+			cls[ j ] = dense->classes++;
+		else
+			cls[ j ] = cls[ cls[ j ] ];
+
+	VARS( "dense->classes", "%d", dense->classes );
+
+	for( ch = 0; ch < 256; ch++ )
+		dense->map[ ch ] = (unsigned char)cls[ seg[ ch ] ];
+
+	/* Fill the final transition matrix */
+	dense->trans = (uint16_t*)pmalloc( states * dense->classes
+											* sizeof( uint16_t ) );
+
+	for( j = 0; j < segs; j++ )
+		for( i = 0; i < states; i++ )
+			dense->trans[ i * dense->classes + cls[ j ] ] =
+				seg_trans[ i * segs + j ];
+
+	pfree( seg_trans );
+
+	/* Detect self-loop states */
+	pregex_dense_accel( dense, dfatab );
+
+	/* Compile reference tags */
+	pregex_dense_tags( dense, dfatab );
+
+	/* Compile the table for characters beyond 255; Small dfatabs are
+		searched fast enough, so it is only kept when it's smaller */
+	if( wide && ( dense->comb = pregex_comb_create( dfatab, states ) ) )
+	{
+		VARS( "dfatab bytes", "%ld",
+				(long)pregex_dfatab_size( dfatab, states ) );
+		VARS( "dense->comb->bytes", "%ld", (long)dense->comb->bytes );
+
+		if( dense->comb->bytes >= pregex_dfatab_size( dfatab, states ) )
+			dense->comb = pfree( dense->comb );
+	}
+
+	RETURN( dense );
+}
+
+/** Frees a dense transition table //dense//.
+
+Always returns (pregex_dense*)NULL. */
+pregex_dense* pregex_dense_free( pregex_dense* dense )
+{
+	int		i;
+
+	if( !dense )
+		return (pregex_dense*)NULL;
+
+	if( dense->accel )
+	{
+		for( i = 0; i < dense->states * 2; i++ )
+			pfree( dense->accel[ i ] );
+
+		pfree( dense->accel );
+	}
+
+	pfree( dense->comb );
+	pfree( dense->tags );
+	pfree( dense->trans );
+	pfree( dense );
+
+	return (pregex_dense*)NULL;
+}
+
+/** Returns the goto-state from //state// on character //ch// within the
+//dfatab// with //states// rows. If //dense// is provided, it is used for
+characters that are covered by the dense table.
+
+Returns //states// if there is no transition on //ch//. */
+int pregex_dfatab_next( wchar_t** dfatab, int states, pregex_dense* dense,
+							int state, wchar_t ch )
+{
+	if( dense && (unsigned int)ch < 256 )
+		return dense->trans[ state * dense->classes + dense->map[ ch ] ];
+
+	return pregex_comb_goto( dense ? dense->comb : (pregex_comb*)NULL,
+								dfatab[ state ], state, ch );
+}
+
+/** Tries to match the DFA provided by the //dfatab// with //states// rows at
+pointer //start//. //dense// is the optional dense transition table compiled
+from //dfatab//, which is used for a faster transition lookup.
+
+//stop// is the end of the input, or (char*)NULL for zero-terminated input.
+//ref// is an optional array of PREGEX_MAXREF references receiving the
+reference positions of the match.
+//flags// are the runtime flags (PREGEX_RUN_*) to be used.
+
+If the DFA can be matched, the function returns the match ID of the accepting
+state, and //end// receives the pointer to the last matched character.
+Otherwise, the function returns 0.
+*/
+int pregex_dfatab_match( wchar_t** dfatab, int states, pregex_dense* dense,
+							char* start, char* stop, char** end,
+								prange* ref, int flags )
+{
+	int				i;
+	int				state		= 0;
+	int				next_state;
+	int				id			= 0;
+	int				aflags;
+	unsigned int	acc;
+	char*			match		= (char*)NULL;
+	char*			ptr			= start;
+	char*			next;
+	wchar_t			ch;
+	pregex_accel*	accel;
+	unsigned char**	tags		= (unsigned char**)NULL;
+	unsigned char*	tag;
+
+	PROC( "pregex_dfatab_match" );
+	PARMS( "dfatab", "%p", dfatab );
+	PARMS( "states", "%d", states );
+	PARMS( "dense", "%p", dense );
+	PARMS( "start", "%s", start );
+	PARMS( "stop", "%p", stop );
+	PARMS( "end", "%p", end );
+	PARMS( "ref", "%p", ref );
+	PARMS( "flags", "%d", flags );
+
+	if( ref )
+	{
+		memset( ref, 0, PREGEX_MAXREF * sizeof( prange ) );
+
+		/* Use the tag lists; without any, there's nothing to record */
+		if( dense && !( tags = dense->tags ) )
+			ref = (prange*)NULL;
+	}
+
+	while( TRUE )
+	{
+		/* State accepts, and the anchors of one of its patterns hold? */
+		acc = 0;
+
+		if( dfatab[ state ][ 1 ] )
+			for( i = 0; ( acc = pregex_dfatab_accept( dfatab[ state ], i,
+														&aflags ) ); i++ )
+				if( !( aflags & PREGEX_FLAG_ANCHORS )
+						|| pregex_anchor_accept( aflags, ptr, stop, flags ) )
+					break;
+
+		if( acc )
+		{
+			MSG( "This state accepts the input" );
+			match = ptr;
+			id = acc;
+
+			if( ( flags & PREGEX_RUN_NONGREEDY
+					|| aflags & PREGEX_FLAG_NONGREEDY ) )
+			{
+				if( flags & PREGEX_RUN_DEBUG )
+					fprintf( stderr,
+						"state %d accepted %d, end of recognition\n",
+							state, id );
+
+				break;
+			}
+		}
+
+		/* References */
+		if( !ref )
+			;
+		else if( tags )
+		{
+			for( tag = tags[ state ]; tag && *tag < PREGEX_MAXREF; tag++ )
+			{
+				if( !ref[ *tag ].start )
+					ref[ *tag ].start = ptr;
+
+				ref[ *tag ].end = ptr;
+			}
+		}
+		else if( dfatab[ state ][ 3 ] )
+		{
+			for( i = 0; i < PREGEX_MAXREF; i++ )
+			{
+				if( dfatab[ state ][ 3 ] & ( 1 << i ) )
+				{
+					if( !ref[ i ].start )
+						ref[ i ].start = ptr;
+
+					ref[ i ].end = ptr;
+				}
+			}
+		}
+
+		/* Skip over input staying in a self-loop state */
+		if( dense && dense->accel && !( flags & PREGEX_RUN_WCHAR )
+				&& ( accel = dense->accel[ state * 2
+									+ !( flags & PREGEX_RUN_UCHAR ) ] )
+				&& ( next = pregex_accel_skip( accel, ptr, stop ) ) > ptr )
+		{
+			ptr = next;
+			continue;
+		}
+
+		/* Get next character; bytes are read in place */
+		if( ( flags & ( PREGEX_RUN_WCHAR | PREGEX_RUN_UCHAR ) )
+				== PREGEX_RUN_UCHAR )
+		{
+			if( stop ? ptr >= stop : !*ptr )
+				break;
+
+			ch = (unsigned char)*ptr++;
+		}
+		else if( !pregex_getchar( &ptr, stop, &ch, flags ) )
+			break;
+
+		/* Find transition according to current character */
+		if( dense && (unsigned int)ch < 256 )
+			next_state = dense->trans[ state * dense->classes
+											+ dense->map[ ch ] ];
+		else
+			next_state = pregex_comb_goto( dense ? dense->comb
+												: (pregex_comb*)NULL,
+											dfatab[ state ], state, ch );
+
+		if( next_state == states )
+			break;
+
+		if( flags & PREGEX_RUN_DEBUG )
+		{
+			if( flags & PREGEX_RUN_WCHAR )
+				fprintf( stderr,
+					"state %d, wchar_t %d (>%lc<), next state %d\n",
+						state, ch, ch, next_state );
+			else
+				fprintf( stderr,
+					"state %d, char %d (>%c<), next state %d\n",
+						state, ch, ch, next_state );
+		}
+
+		state = next_state;
+	}
+
+	if( match && end )
+		*end = match;
+
+	RETURN( match ? id : 0 );
+}
+
+
+/* Search Machine */
+
+/* Search machine state during construction */
+typedef struct
+{
+	int*			set;		/* Ordered set of elements */
+	int				cnt;		/* Number of elements in set */
+	pboolean		matched;	/* A match has already been seen */
+	pboolean		ended;		/* A match ended in front of the character
+									leading into the state */
+	pboolean		idle;		/* No match is running, except one starting
+									behind the character */
+	int				init;		/* Anchor class of an initial state (+1) */
+
+	unsigned int	hash;		/* Hash value of the state */
+	int				next;		/* Next state in same hash bucket (+1) */
+
+	int*			gotos;		/* Goto-state for every character segment */
+} pregex_search_st;
+
+#define PREGEX_SEARCH_BUCKETS	256
+
+/* Search machine construction modes */
+#define PREGEX_SEARCH_FORWARD	0	/* Forward search DFA */
+#define PREGEX_SEARCH_REVERSE	1	/* Reverse DFA, anchored at the match end */
+#define PREGEX_SEARCH_BACKWARD	2	/* Backward search DFA */
+
+/* Search machine construction context */
+typedef struct
+{
+	wchar_t**		dfatab;		/* The dfatab */
+	int				states;		/* Number of dfatab states */
+	int				mode;		/* Construction mode */
+	int				flags;		/* Runtime flags */
+	int				ctx;		/* Number of anchor contexts per state */
+	int				ends;		/* Any end anchors in the dfatab */
+	int*			viable;		/* Anchor contexts a match can still be
+									accepted with, per dfatab state */
+} pregex_search_ctx;
+
+/* Returns the accepting id of the pattern //i// of the dfatab state //q//,
+and its flags into //flags//. With PREGEX_RUN_NOANCHORS, the anchors are
+removed, and only the first pattern is taken. Returns 0 if there is no such
+pattern. */
+static unsigned int pregex_search_pattern( pregex_search_ctx* ctx, int q,
+											int i, int* flags )
+{
+	unsigned int	accept;
+
+	if( i && ctx->flags & PREGEX_RUN_NOANCHORS )
+		return 0;
+
+	if( ( accept = pregex_dfatab_accept( ctx->dfatab[ q ], i, flags ) )
+			&& ctx->flags & PREGEX_RUN_NOANCHORS )
+		*flags &= ~PREGEX_FLAG_ANCHORS;
+
+	return accept;
+}
+
+/* Returns the begin anchors with the index //a//, as kept by the elements of
+the reverse and backward construction. */
+static int pregex_search_begins( int a )
+{
+	return ( a & 1 ? PREGEX_FLAG_BOL : 0 ) | ( a & 2 ? PREGEX_FLAG_BOW : 0 );
+}
+
+/* Returns the contexts of the elements of the dfatab state //q//, whose
+patterns end in front of a character of anchor class //next//, as a bit mask.
+This is 0 if //q// doesn't accept, or the end anchors of none of its patterns
+hold there. */
+static int pregex_search_accept( pregex_search_ctx* ctx, int q, int next )
+{
+	int		mask	= 0;
+	int		flags;
+	int		i;
+
+	for( i = 0; pregex_search_pattern( ctx, q, i, &flags ); i++ )
+	{
+		if( !pregex_anchor_test( flags & ( PREGEX_FLAG_EOL | PREGEX_FLAG_EOW ),
+									PREGEX_ANCHOR_LINE, next ) )
+			continue;
+
+		if( ctx->ctx == 1 )
+			mask |= 1;
+		else
+			mask |= 1 << ( ( flags & PREGEX_FLAG_BOL ? 1 : 0 )
+							+ ( flags & PREGEX_FLAG_BOW ? 2 : 0 ) );
+	}
+
+	return mask;
+}
+
+/* Checks if the element //e// of the forward construction is a match, which
+accepts unconditionally by one of its patterns. */
+static pboolean pregex_search_valid( pregex_search_ctx* ctx, int e )
+{
+	int		flags;
+	int		i;
+
+	for( i = 0; pregex_search_pattern( ctx, e / ctx->ctx, i, &flags ); i++ )
+		if( !( flags & ( PREGEX_FLAG_EOL | PREGEX_FLAG_EOW ) )
+				&& pregex_anchor_test( flags, e % ctx->ctx,
+										PREGEX_ANCHOR_LINE ) )
+			return TRUE;
+
+	return FALSE;
+}
+
+/* Checks if the element //e// of the forward construction is a match, which
+ends in front of a character of anchor class //next// by one of its patterns
+with end anchors. */
+static pboolean pregex_search_ends( pregex_search_ctx* ctx, int e, int next )
+{
+	int		flags;
+	int		i;
+
+	for( i = 0; pregex_search_pattern( ctx, e / ctx->ctx, i, &flags ); i++ )
+		if( flags & ( PREGEX_FLAG_EOL | PREGEX_FLAG_EOW )
+				&& pregex_anchor_test( flags, e % ctx->ctx, next ) )
+			return TRUE;
+
+	return FALSE;
+}
+
+/* Checks if the element //e// of the forward construction is a nongreedy
+match in front of a character of anchor class //next//, taking the first
+pattern whose anchors hold there, like the matchers do. */
+static pboolean pregex_search_nongreedy( pregex_search_ctx* ctx, int e,
+											int next )
+{
+	int		flags;
+	int		i;
+
+	for( i = 0; pregex_search_pattern( ctx, e / ctx->ctx, i, &flags ); i++ )
+		if( pregex_anchor_test( flags, e % ctx->ctx, next ) )
+			return ctx->flags & PREGEX_RUN_NONGREEDY
+					|| flags & PREGEX_FLAG_NONGREEDY;
+
+	return FALSE;
+}
+
+/* Computes the anchor contexts of the forward construction for every dfatab
+state, with which a match running through the state can still be accepted.
+//tab// holds the goto-states of all states for the //segs// character
+segments. */
+static int* pregex_search_viable( pregex_search_ctx* ctx, int* tab, int segs )
+{
+	int*		viable;
+	pboolean	changed		= TRUE;
+	int			flags;
+	int			i;
+	int			j;
+	int			k;
+	int			q;
+
+	viable = (int*)pmalloc( ctx->states * sizeof( int ) );
+
+	for( q = 0; q < ctx->states; q++ )
+		for( i = 0; pregex_search_pattern( ctx, q, i, &flags ); i++ )
+			for( j = 0; j < ctx->ctx; j++ )
+				if( ctx->ctx == 1
+						|| pregex_anchor_test( flags & ( PREGEX_FLAG_BOL
+															| PREGEX_FLAG_BOW ),
+												j, PREGEX_ANCHOR_LINE ) )
+					viable[ q ] |= 1 << j;
+
+	/* A state takes the contexts of the states it leads into */
+	while( changed )
+	{
+		changed = FALSE;
+
+		for( q = ctx->states - 1; q >= 0; q-- )
+			for( k = 0; k < segs; k++ )
+				if( ( i = tab[ k * ctx->states + q ] ) < ctx->states
+						&& viable[ i ] & ~viable[ q ] )
+				{
+					viable[ q ] |= viable[ i ];
+					changed = TRUE;
+				}
+	}
+
+	return viable;
+}
+
+/* Get or insert the search state made up of //set//, //matched//, //ended//,
+//idle// and //init//. */
+static int pregex_search_get_state( parray* sts, int* buckets,
+										int* set, int cnt, pboolean matched,
+											pboolean ended, pboolean idle,
+												int init )
+{
+	pregex_search_st*	st;
+	unsigned int		hash	= matched | ended << 1 | idle << 2 | init << 3;
+	int					i;
+
+	for( i = 0; i < cnt; i++ )
+		hash = hash * 31 + set[ i ];
+
+	for( i = buckets[ hash % PREGEX_SEARCH_BUCKETS ]; i; i = st->next )
+	{
+		st = (pregex_search_st*)parray_get( sts, i - 1 );
+
+		if( st->hash == hash && st->cnt == cnt && st->matched == matched
+				&& st->ended == ended && st->idle == idle && st->init == init
+				&& !memcmp( st->set, set, cnt * sizeof( int ) ) )
+			return i - 1;
+	}
+
+	if( parray_count( sts ) >= PREGEX_SEARCH_MAXSTATES )
+		return -1;
+
+	st = (pregex_search_st*)parray_malloc( sts );
+	st->set = cnt ? (int*)pmemdup( set, cnt * sizeof( int ) ) : (int*)NULL;
+	st->cnt = cnt;
+	st->matched = matched;
+	st->ended = ended;
+	st->idle = idle;
+	st->init = init;
+	st->hash = hash;
+
+	st->next = buckets[ hash % PREGEX_SEARCH_BUCKETS ];
+	buckets[ hash % PREGEX_SEARCH_BUCKETS ] = parray_count( sts );
+
+	return parray_count( sts ) - 1;
+}
+
+/* Computes the successor set of //st// on a character of anchor class //cls//
+into //set//, where //gotos// holds the goto-state of every dfatab state on
+that character.
+
+An element of a set is a dfatab state and an anchor context, as
+//state * ctx->ctx + context//. Without anchors, there is only one context.
+
+In forward mode, the set holds the states of all running matches in order of
+their starting positions, with the anchor class of the character in front of
+the start as context. Later starting matches are cut off when a match is
+found, and a new match is started at every position until then. Matches that
+can't be accepted with their context anymore are dropped. A match whose end
+anchors hold in front of the character ends there, which is flagged by
+//ended//. //idle// is set when no match is running, except the one started
+behind the character.
+
+In reverse mode, the set holds all states that lead into the states of //st//
+on the character, with the begin anchors of an accepting pattern of the state
+the path ends in as context. The backward mode additionally adds all accepting
+patterns whose end anchors hold in front of the character, so that a new match
+is ended at every position. */
+static int pregex_search_next( pregex_search_ctx* ctx, pregex_search_st* st,
+								int* gotos, int cls, int* set, char* member,
+									pboolean* matched, pboolean* ended,
+										pboolean* idle )
+{
+	int			states	= ctx->states;
+	int			cnt		= 0;
+	int			stcnt	= st->cnt;
+	int			a;
+	int			i;
+	int			j;
+	int			q;
+
+	*ended = FALSE;
+	*idle = FALSE;
+
+	if( ctx->mode != PREGEX_SEARCH_FORWARD )
+	{
+		for( i = 0; i < st->cnt; i++ )
+			member[ st->set[ i ] ] = 1;
+
+		for( i = 0; i < states; i++ )
+		{
+			a = ctx->mode == PREGEX_SEARCH_BACKWARD
+					? pregex_search_accept( ctx, i, cls ) : 0;
+
+			q = gotos[ i ];
+
+			for( j = 0; j < ctx->ctx; j++ )
+				if( a & ( 1 << j )
+						|| ( q < states && member[ q * ctx->ctx + j ] ) )
+					set[ cnt++ ] = i * ctx->ctx + j;
+		}
+
+		for( i = 0; i < st->cnt; i++ )
+			member[ st->set[ i ] ] = 0;
+
+		*matched = FALSE;
+		return cnt;
+	}
+
+	/* The first match whose end anchors hold in front of the character ends
+		here, and cuts off all matches starting behind it */
+	if( ctx->ends )
+		for( i = 0; i < stcnt; i++ )
+			if( pregex_search_ends( ctx, st->set[ i ], cls ) )
+			{
+				stcnt = i + 1;
+				*ended = TRUE;
+				break;
+			}
+
+	for( i = 0; i < stcnt; i++ )
+	{
+		q = st->set[ i ] / ctx->ctx;
+
+		/* Nongreedy matches end with their first accepting state */
+		if( pregex_search_nongreedy( ctx, st->set[ i ], cls ) )
+			continue;
+
+		if( ( q = gotos[ q ] ) < states
+				&& ctx->viable[ q ] & ( 1 << st->set[ i ] % ctx->ctx )
+				&& !member[ ( q = q * ctx->ctx + st->set[ i ] % ctx->ctx ) ] )
+		{
+			member[ q ] = 1;
+			set[ cnt++ ] = q;
+		}
+	}
+
+	for( i = 0; i < cnt; i++ )
+		member[ set[ i ] ] = 0;
+
+	*matched = st->matched || *ended;
+
+	/* Cut off all matches starting behind the first one accepting here */
+	for( i = 0; i < cnt; i++ )
+		if( pregex_search_valid( ctx, set[ i ] ) )
+		{
+			cnt = i + 1;
+			*matched = TRUE;
+			break;
+		}
+
+	/* Start a new match, as long as nothing was matched */
+	if( !*matched )
+	{
+		*idle = !cnt;
+		q = ctx->ctx > 1 ? cls : 0;
+
+		for( i = 0; i < cnt; i++ )
+			if( set[ i ] == q )
+				break;
+
+		if( i == cnt && *ctx->viable & ( 1 << q ) )
+			set[ cnt++ ] = q;
+	}
+
+	return cnt;
+}
+
+/* Returns the row flags of the search state //st//. */
+static int pregex_search_flags( pregex_search_ctx* ctx, pregex_search_st* st )
+{
+	int		flags	= ( st->ended ? PREGEX_SEARCH_ENDED : 0 )
+						| ( st->idle ? PREGEX_SEARCH_IDLE : 0 );
+	int		i;
+	int		q;
+	int		cls;
+
+	for( i = 0; i < st->cnt; i++ )
+	{
+		q = st->set[ i ] / ctx->ctx;
+
+		/* Forward: A match waiting for its end anchors ends with the input */
+		if( ctx->mode == PREGEX_SEARCH_FORWARD )
+		{
+			if( pregex_search_ends( ctx, st->set[ i ], PREGEX_ANCHOR_LINE ) )
+				flags |= PREGEX_SEARCH_ATEOF;
+		}
+		/* Reverse: Anchor classes a match may begin behind */
+		else if( !q )
+		{
+			for( cls = 0; cls < PREGEX_ANCHOR_CLASSES; cls++ )
+				if( pregex_anchor_test( ctx->ctx > 1 ? pregex_search_begins(
+												st->set[ i ] % ctx->ctx ) : 0,
+											cls, PREGEX_ANCHOR_LINE ) )
+					flags |= PREGEX_SEARCH_BEGINS( cls );
+		}
+	}
+
+	return flags;
+}
+
+/* Returns the anchor class of the character //ch// as it is read by a search
+machine for the runtime //flags//. The search machine distinguishes word
+characters up to 0xFF only, see pregex_search_create(), and up to 0x7F when
+matching UTF-8 on bytes. All characters above are of class
+PREGEX_ANCHOR_OTHER. */
+static int pregex_search_class( wchar_t ch, int flags )
+{
+	if( ch > ( flags & PREGEX_RUN_UCHAR && flags & PREGEX_COMP_UTF8
+				? 0x7F : 0xFF ) )
+		return PREGEX_ANCHOR_OTHER;
+
+	return pregex_anchor_class( ch );
+}
+
+/* Returns the number of character segments of //dfatab// into //segs//, and
+their anchor classes for the runtime //flags// into //segcls//. The segments
+are additionally split at line breaks when there are any //anchors//, and at
+the borders of the word characters when there are word anchors, so that all
+characters of a segment are of the same anchor class, as far as it matters. */
+static int pregex_search_segments( wchar_t** dfatab, int states, int flags,
+									int anchors, wchar_t** segs, int** segcls )
+{
+	static wchar_t	lines[]	= { '\n', '\n' + 1, '\r', '\r' + 1 };
+	int				ch;
+	int				cnt;
+	int				cls;
+	int				prev;
+	int				i;
+	int				j;
+
+	cnt = pregex_dfatab_segments( dfatab, states, segs );
+
+	if( anchors )
+	{
+		*segs = (wchar_t*)prealloc( *segs, ( cnt + 256 + 1
+							+ sizeof( lines ) / sizeof( *lines ) )
+								* sizeof( wchar_t ) );
+
+		memcpy( *segs + cnt, lines, sizeof( lines ) );
+		cnt += sizeof( lines ) / sizeof( *lines );
+
+		if( anchors & ( PREGEX_FLAG_BOW | PREGEX_FLAG_EOW ) )
+			for( ch = 0, prev = -1; ch <= 0x100; ch++ )
+				if( ( cls = pregex_search_class( ch, flags ) ) != prev )
+				{
+					(*segs)[ cnt++ ] = ch;
+					prev = cls;
+				}
+
+		qsort( *segs, cnt, sizeof( wchar_t ), pregex_wchar_compare );
+
+		for( i = j = 1; i < cnt; i++ )
+			if( (*segs)[ i ] != (*segs)[ j - 1 ] )
+				(*segs)[ j++ ] = (*segs)[ i ];
+
+		cnt = j;
+	}
+
+	*segcls = (int*)pmalloc( cnt * sizeof( int ) );
+
+	for( i = 0; i < cnt; i++ )
+		(*segcls)[ i ] = pregex_search_class( (*segs)[ i ], flags );
+
+	return cnt;
+}
+
+/* Constructs the forward search DFA, the reverse DFA or the backward search
+DFA according to //mode// from //dfatab// into a new dfatab //search//.
+Returns the number of states, or -1 when the construction exceeds
+PREGEX_SEARCH_MAXSTATES states.
+
+When the dfatab has anchors, the character segments are split by anchor
+classes, and the elements carry an anchor context. The forward search DFA then
+gets an initial state for the anchor class of the character in front of the
+input when there are begin anchors, and the reverse DFA one for the anchor
+class of the character behind the match when there are end anchors. These are
+the first rows, and flagged by PREGEX_SEARCH_CLASSES. */
+static int pregex_search_construct( wchar_t*** search, wchar_t** dfatab,
+										int states, int mode, int flags )
+{
+	pregex_search_ctx	ctx;
+	parray*				sts;
+	pregex_search_st*	st;
+	wchar_t*			segs;
+	wchar_t*			row;
+	int					segs_cnt;
+	int*				segcls;
+	int					buckets		[ PREGEX_SEARCH_BUCKETS ];
+	int*				set;
+	int*				gotos;
+	int*				tab;
+	char*				member;
+	pboolean			matched		= FALSE;
+	pboolean			ended		= FALSE;
+	pboolean			idle		= FALSE;
+	pboolean			failed		= FALSE;
+	int					begins		= 0;
+	int					classes		= 1;
+	int					cnt			= 0;
+	int					cls;
+	int					i;
+	int					j;
+	int					k;
+	int					def;
+
+	ctx.dfatab = dfatab;
+	ctx.states = states;
+	ctx.mode = mode;
+	ctx.flags = flags;
+	ctx.ends = 0;
+
+	for( i = 0; i < states; i++ )
+		for( j = 0; pregex_search_pattern( &ctx, i, j, &k ); j++ )
+		{
+			begins |= k & ( PREGEX_FLAG_BOL | PREGEX_FLAG_BOW );
+			ctx.ends |= k & ( PREGEX_FLAG_EOL | PREGEX_FLAG_EOW );
+		}
+
+	/* Forward elements carry the anchor class in front of their start,
+		reverse elements the begin anchors of their accepting pattern */
+	if( !begins )
+		ctx.ctx = 1;
+	else if( mode == PREGEX_SEARCH_FORWARD )
+		ctx.ctx = PREGEX_ANCHOR_CLASSES;
+	else
+		ctx.ctx = 4;
+
+	if( ( mode == PREGEX_SEARCH_FORWARD && begins )
+			|| ( mode == PREGEX_SEARCH_REVERSE && ctx.ends ) )
+		classes = PREGEX_ANCHOR_CLASSES;
+
+	segs_cnt = pregex_search_segments( dfatab, states, flags,
+										begins | ctx.ends, &segs, &segcls );
+
+	set = (int*)pmalloc( ( states * ctx.ctx + 1 ) * sizeof( int ) );
+	member = (char*)pmalloc( states * ctx.ctx * sizeof( char ) );
+	memset( buckets, 0, sizeof( buckets ) );
+
+	/* Look up the goto-states of all dfatab states once per segment */
+	tab = (int*)pmalloc( segs_cnt * states * sizeof( int ) );
+	gotos = (int*)pmalloc( segs_cnt * sizeof( int ) );
+
+	for( i = 0; i < states; i++ )
+	{
+		pregex_comb_row( dfatab[ i ], segs, segs_cnt, gotos );
+
+		for( k = 0; k < segs_cnt; k++ )
+			tab[ k * states + i ] = gotos[ k ];
+	}
+
+	pfree( gotos );
+
+	ctx.viable = mode == PREGEX_SEARCH_FORWARD
+					? pregex_search_viable( &ctx, tab, segs_cnt )
+					: (int*)NULL;
+
+	sts = parray_create( sizeof( pregex_search_st ), 0 );
+
+	/* Initial states, for every anchor class */
+	for( cls = 0; cls < classes; cls++ )
+	{
+		cnt = 0;
+
+		if( mode != PREGEX_SEARCH_FORWARD )
+		{
+			for( i = 0; i < states; i++ )
+				if( ( k = pregex_search_accept( &ctx, i, cls ) ) )
+					for( j = 0; j < ctx.ctx; j++ )
+						if( k & ( 1 << j ) )
+							set[ cnt++ ] = i * ctx.ctx + j;
+		}
+		else if( *ctx.viable & ( 1 << cls ) )
+			set[ cnt++ ] = cls;
+
+		pregex_search_get_state( sts, buckets, set, cnt, FALSE, FALSE,
+									mode == PREGEX_SEARCH_FORWARD,
+										classes > 1 ? cls + 1 : 0 );
+	}
+
+	/* Construct all reachable states */
+	for( i = 0; i < parray_count( sts ); i++ )
+	{
+		gotos = (int*)pmalloc( segs_cnt * sizeof( int ) );
+
+		for( k = 0; k < segs_cnt; k++ )
+		{
+			st = (pregex_search_st*)parray_get( sts, i );
+
+			/* An empty set is dead, unless the backward search DFA may still
+				end a new match, or the forward search DFA start one */
+			if( !( cnt = pregex_search_next( &ctx, st, tab + k * states,
+												segcls[ k ], set, member,
+													&matched, &ended, &idle ) )
+					&& !ended && mode != PREGEX_SEARCH_BACKWARD
+					&& !idle )
+				gotos[ k ] = -1;
+			else if( ( gotos[ k ] = pregex_search_get_state(
+										sts, buckets, set, cnt,
+											matched, ended, idle, 0 ) ) < 0 )
+				break;
+		}
+
+		st = (pregex_search_st*)parray_get( sts, i );
+		st->gotos = gotos;
+
+		/* Too many states, give up */
+		if( k < segs_cnt )
+		{
+			failed = TRUE;
+			break;
+		}
+	}
+
+	/* Turn states into dfatab rows */
+	if( !failed )
+	{
+		cnt = parray_count( sts );
+		*search = (wchar_t**)pmalloc( cnt * sizeof( wchar_t* ) );
+
+		for( i = 0; i < cnt; i++ )
+		{
+			st = (pregex_search_st*)parray_get( sts, i );
+
+			for( k = 0; k < segs_cnt; k++ )
+				if( st->gotos[ k ] < 0 )
+					st->gotos[ k ] = cnt;
+
+			def = st->gotos[ segs_cnt - 1 ];
+
+			for( j = 5, k = 0; k < segs_cnt; k++ )
+				if( st->gotos[ k ] != def
+						&& ( !k || st->gotos[ k - 1 ] != st->gotos[ k ] ) )
+					j += 3;
+
+			row = (*search)[ i ] = (wchar_t*)pmalloc( j * sizeof( wchar_t ) );
+			row[ 0 ] = j;
+
+			if( !st->cnt )
+				row[ 1 ] = 0;
+			else if( mode != PREGEX_SEARCH_FORWARD )
+				row[ 1 ] = *st->set < ctx.ctx;
+			else
+				row[ 1 ] = pregex_search_valid( &ctx,
+									st->set[ st->cnt - 1 ] ) ? 1 : 0;
+
+			row[ 2 ] = pregex_search_flags( &ctx, st );
+
+			if( !i && classes > 1 )
+				row[ 2 ] |= PREGEX_SEARCH_CLASSES;
+
+			row[ 4 ] = def;
+
+			for( j = 5, k = 0; k < segs_cnt; k++ )
+			{
+				if( st->gotos[ k ] == def )
+					continue;
+
+				if( !k || st->gotos[ k - 1 ] != st->gotos[ k ] )
+				{
+					row[ j ] = segs[ k ];
+					row[ j + 2 ] = st->gotos[ k ];
+					j += 3;
+				}
+
+				row[ j - 2 ] = segs[ k + 1 ] - 1;
+			}
+		}
+	}
+	else
+		cnt = -1;
+
+	for( i = 0; i < parray_count( sts ); i++ )
+	{
+		st = (pregex_search_st*)parray_get( sts, i );
+		pfree( st->set );
+		pfree( st->gotos );
+	}
+
+	parray_free( sts );
+	pfree( segs );
+	pfree( segcls );
+	pfree( tab );
+	pfree( set );
+	pfree( member );
+	pfree( ctx.viable );
+
+	return cnt;
+}
+
+/* Reads the character in front of //ptr//, not going before //start//, and
+moves //ptr// onto it. Input ends at //stop//, and is processed according to
+the runtime //flags//. */
+static wchar_t pregex_search_prevchar( char** ptr, char* start, char* stop,
+										int flags )
+{
+	wchar_t		ch;
+#ifdef UTF8
+	char*		next;
+#endif
+
+	if( flags & PREGEX_RUN_WCHAR )
+	{
+		*ptr -= sizeof( wchar_t );
+		ch = *( (wchar_t*)*ptr );
+	}
+	else if( ( flags & PREGEX_RUN_UCHAR ) )
+		ch = (unsigned char)*--(*ptr);
+	else
+	{
+#ifdef UTF8
+		next = *ptr;
+
+		while( --(*ptr) > start && ( **ptr & 0xC0 ) == 0x80 )
+			;
+
+		/* A sequence cut by stop was read bytewise */
+		if( stop && *ptr + u8_seqlen( *ptr ) > stop )
+			ch = (unsigned char)*( *ptr = next - 1 );
+		else
+			ch = u8_char( *ptr );
+#else
+		ch = *--(*ptr);
+#endif
+	}
+
+	return ch;
+}
+
+/* Checks if a match found by the reverse or backward DFA in a row with the
+row flags //rflags// may begin at //ptr//, in the input that starts at
+//start// and is processed according to the runtime //flags//. */
+static pboolean pregex_search_begin( int rflags, char* start, char* ptr,
+										int flags )
+{
+	if( ( rflags & ( PREGEX_SEARCH_BEGINS( PREGEX_ANCHOR_LINE )
+						| PREGEX_SEARCH_BEGINS( PREGEX_ANCHOR_WORD )
+						| PREGEX_SEARCH_BEGINS( PREGEX_ANCHOR_OTHER ) ) )
+			== ( PREGEX_SEARCH_BEGINS( PREGEX_ANCHOR_LINE )
+						| PREGEX_SEARCH_BEGINS( PREGEX_ANCHOR_WORD )
+						| PREGEX_SEARCH_BEGINS( PREGEX_ANCHOR_OTHER ) ) )
+		return TRUE;
+
+	return rflags & PREGEX_SEARCH_BEGINS(
+						pregex_anchor_before( start, ptr, flags ) )
+				? TRUE : FALSE;
+}
+
+/** Compiles an unanchored search machine from the //dfatab// with //states//
+rows, for the runtime //flags// it will be executed with.
+
+The search machine consists of two DFAs. The forward search DFA runs all
+matches starting at any input position simultaneously, which is the same as
+an implicit leading ``.*?`` in front of the expression. It is executed in one
+pass, and stops when the leftmost match has ended. A reverse DFA is run
+backwards from this end, to recover the start position of the match.
+
+Returns a pointer to the allocated pregex_search-object, which must be released
+using pregex_search_free(). The function returns (pregex_search*)NULL if the
+DFA matches the empty string, or the search machine gets too large. It is
+neither compiled for word anchors when there are word characters beyond 0xFF
+according to pregex_anchor_wide(), or the DFA runs on the bytes of UTF-8
+sequences. Matches must then be found by trying the DFA at every position.
+*/
+pregex_search* pregex_search_create( wchar_t** dfatab, int states, int flags )
+{
+	pregex_search*	search;
+	int				aflags;
+	int				i;
+	int				j;
+
+	PROC( "pregex_search_create" );
+	PARMS( "dfatab", "%p", dfatab );
+	PARMS( "states", "%d", states );
+	PARMS( "flags", "%d", flags );
+
+	if( !( dfatab && states > 0 ) )
+	{
+		WRONGPARAM;
+		RETURN( (pregex_search*)NULL );
+	}
+
+	if( dfatab[ 0 ][ 1 ] )
+	{
+		MSG( "DFA matches the empty string" );
+		RETURN( (pregex_search*)NULL );
+	}
+
+	/* Word characters are distinguished up to 0xFF only, and bytes of UTF-8
+		sequences can't tell whether they belong to a word */
+	if( !( flags & PREGEX_RUN_NOANCHORS )
+			&& ( flags & PREGEX_RUN_UCHAR ? flags & PREGEX_COMP_UTF8
+											: pregex_anchor_wide() ) )
+	{
+		for( i = 0; i < states; i++ )
+			for( j = 0; pregex_dfatab_accept( dfatab[ i ], j, &aflags ); j++ )
+				if( aflags & ( PREGEX_FLAG_BOW | PREGEX_FLAG_EOW ) )
+				{
+					MSG( "Word anchors on characters beyond 0xFF" );
+					RETURN( (pregex_search*)NULL );
+				}
+	}
+
+	search = (pregex_search*)pmalloc( sizeof( pregex_search ) );
+	search->flags = flags;
+
+	if( ( search->trans_cnt = pregex_search_construct(
+					&search->trans, dfatab, states,
+						PREGEX_SEARCH_FORWARD, flags ) ) < 0
+		|| ( search->rtrans_cnt = pregex_search_construct(
+					&search->rtrans, dfatab, states,
+						PREGEX_SEARCH_REVERSE, flags ) ) < 0 )
+		RETURN( pregex_search_free( search ) );
+
+	VARS( "search->trans_cnt", "%d", search->trans_cnt );
+	VARS( "search->rtrans_cnt", "%d", search->rtrans_cnt );
+
+	search->dense = pregex_dense_create( search->trans, search->trans_cnt );
+	search->rdense = pregex_dense_create( search->rtrans, search->rtrans_cnt );
+
+	RETURN( search );
+}
+
+/** Adds the backward search DFA to the search machine //search//, which was
+compiled from the //dfatab// with //states// rows.
+
+The backward search DFA is run from right to left, and runs all matches ending
+at any input position simultaneously, which is the same as an implicit
+trailing ``.*?`` behind the expression. It stops at the rightmost position
+where a match begins, and is used by pregex_search_rfind().
+
+Returns TRUE on success, and FALSE if the backward search DFA gets too large.
+Backward searches must then be done by trying the DFA at every position.
+*/
+pboolean pregex_search_backward( pregex_search* search, wchar_t** dfatab,
+									int states )
+{
+	PROC( "pregex_search_backward" );
+	PARMS( "search", "%p", search );
+	PARMS( "dfatab", "%p", dfatab );
+	PARMS( "states", "%d", states );
+
+	if( !( search && dfatab && states > 0 ) )
+	{
+		WRONGPARAM;
+		RETURN( FALSE );
+	}
+
+	if( search->btrans )
+		RETURN( TRUE );
+
+	if( ( search->btrans_cnt = pregex_search_construct( &search->btrans,
+									dfatab, states, PREGEX_SEARCH_BACKWARD,
+										search->flags ) ) < 0 )
+	{
+		search->btrans_cnt = 0;
+		RETURN( FALSE );
+	}
+
+	VARS( "search->btrans_cnt", "%d", search->btrans_cnt );
+
+	search->bdense = pregex_dense_create( search->btrans, search->btrans_cnt );
+
+	RETURN( TRUE );
+}
+
+/** Frees a search machine //search//.
+
+Always returns (pregex_search*)NULL. */
+pregex_search* pregex_search_free( pregex_search* search )
+{
+	int		i;
+
+	if( !search )
+		return (pregex_search*)NULL;
+
+	for( i = 0; i < search->trans_cnt; i++ )
+		pfree( search->trans[ i ] );
+
+	for( i = 0; i < search->rtrans_cnt; i++ )
+		pfree( search->rtrans[ i ] );
+
+	for( i = 0; i < search->btrans_cnt; i++ )
+		pfree( search->btrans[ i ] );
+
+	pfree( search->trans );
+	pfree( search->rtrans );
+	pfree( search->btrans );
+
+	pregex_dense_free( search->dense );
+	pregex_dense_free( search->rdense );
+	pregex_dense_free( search->bdense );
+
+	pfree( search );
+
+	return (pregex_search*)NULL;
+}
+
+/** Searches for the leftmost match of the search machine //search// in the
+string //start//, which is processed according to the runtime //flags//.
+//stop// is the end of the input, or (char*)NULL for zero-terminated input.
+The character in front of //start// is described by the runtime flags
+PREGEX_RUN_NOTBOL and PREGEX_RUN_NOTBOW, for the anchors of the expression.
+
+//limit// is optional. When provided, only matches beginning in front of
+//limit// are searched for, and the search gives up as soon as no such match is
+running anymore behind //limit//. A match found may still begin at //limit// or
+behind, and must then be ignored by the caller.
+
+If a match is found, the function returns TRUE, and //mstart// receives the
+pointer where the match begins. The match itself must be run afterwards with
+the anchored DFA on //mstart//, to obtain its end, match ID and references.
+*/
+pboolean pregex_search_find( pregex_search* search, char* start, char* stop,
+								char* limit, char** mstart, int flags )
+{
+	int				state		= 0;
+	int				next_state;
+	char*			ptr			= start;
+	char*			end			= (char*)NULL;
+	char*			last;
+	char*			next;
+	char*			skip;
+	wchar_t			ch;
+	pregex_accel*	accel;
+
+	PROC( "pregex_search_find" );
+	PARMS( "search", "%p", search );
+	PARMS( "start", "%s", start );
+	PARMS( "stop", "%p", stop );
+	PARMS( "limit", "%p", limit );
+	PARMS( "mstart", "%p", mstart );
+	PARMS( "flags", "%d", flags );
+
+	if( !( search && start && mstart ) )
+	{
+		WRONGPARAM;
+		RETURN( FALSE );
+	}
+
+	/* Initial state for the character in front of the input */
+	if( search->trans[ 0 ][ 2 ] & PREGEX_SEARCH_CLASSES )
+		state = pregex_anchor_before( start, start, flags );
+
+	/* Forward pass: Find the end of the leftmost match */
+	while( TRUE )
+	{
+		/* No match beginning in front of limit is running anymore */
+		if( limit && search->trans[ state ][ 2 ] & PREGEX_SEARCH_IDLE )
+		{
+			if( ptr >= limit )
+			{
+				if( !end )
+					RETURN( FALSE );
+
+				break;
+			}
+
+			skip = limit;
+		}
+		else
+			skip = stop;
+
+		if( search->trans[ state ][ 1 ] )
+			end = ptr;
+
+		/* Skip over input staying in a self-loop state */
+		if( search->dense && search->dense->accel
+				&& !( flags & PREGEX_RUN_WCHAR )
+				&& ( accel = search->dense->accel[ state * 2
+									+ !( flags & PREGEX_RUN_UCHAR ) ] )
+				&& ( next = pregex_accel_skip( accel, ptr, skip ) ) > ptr )
+		{
+			ptr = next;
+			continue;
+		}
+
+		/* Get next character */
+		last = ptr;
+
+		if( !pregex_getchar( &ptr, stop, &ch, flags ) )
+		{
+			/* A match waiting for its end anchors ends with the input */
+			if( search->trans[ state ][ 2 ] & PREGEX_SEARCH_ATEOF )
+				end = last;
+
+			break;
+		}
+
+		if( search->dense && (unsigned int)ch < 256 )
+			next_state = search->dense->trans[ state * search->dense->classes
+												+ search->dense->map[ ch ] ];
+		else
+			next_state = pregex_comb_goto( search->dense ? search->dense->comb
+												: (pregex_comb*)NULL,
+											search->trans[ state ], state, ch );
+
+		if( next_state == search->trans_cnt )
+			break;
+
+		state = next_state;
+
+		/* A match ended in front of this character */
+		if( search->trans[ state ][ 2 ] & PREGEX_SEARCH_ENDED )
+			end = last;
+	}
+
+	if( !end )
+		RETURN( FALSE );
+
+	VARS( "end", "%s", end );
+
+	RETURN( pregex_search_start( search, start, stop, end, mstart, flags ) );
+}
+
+/** Finds the start of the leftmost match of the search machine //search//
+that ends at //end//, by running the reverse DFA from //end// back to //start//.
+The input ends at //stop//, or is zero-terminated if (char*)NULL, and is
+processed according to the runtime //flags//, which describe the character in
+front of //start// by PREGEX_RUN_NOTBOL and PREGEX_RUN_NOTBOW.
+
+//end// is the end of the leftmost match in the input from //start//, as found
+by the forward search DFA. This is done by pregex_search_find(), or by a caller
+running the forward search DFA itself.
+
+If the match is found, the function returns TRUE, and //mstart// receives the
+pointer where the match begins.
+*/
+pboolean pregex_search_start( pregex_search* search, char* start, char* stop,
+								char* end, char** mstart, int flags )
+{
+	int				state		= 0;
+	int				next_state;
+	char*			ptr;
+	wchar_t			ch;
+
+	PROC( "pregex_search_start" );
+	PARMS( "search", "%p", search );
+	PARMS( "start", "%p", start );
+	PARMS( "stop", "%p", stop );
+	PARMS( "end", "%p", end );
+	PARMS( "mstart", "%p", mstart );
+	PARMS( "flags", "%d", flags );
+
+	if( !( search && start && end >= start && mstart ) )
+	{
+		WRONGPARAM;
+		RETURN( FALSE );
+	}
+
+	*mstart = ptr = end;
+
+	/* Initial state for the character behind the match */
+	if( search->rtrans[ 0 ][ 2 ] & PREGEX_SEARCH_CLASSES )
+		state = pregex_anchor_after( end, stop, flags );
+
+	while( ptr > start )
+	{
+		/* Get previous character */
+		ch = pregex_search_prevchar( &ptr, start, stop, flags );
+
+		if( search->rdense && (unsigned int)ch < 256 )
+			next_state = search->rdense->trans[ state * search->rdense->classes
+												+ search->rdense->map[ ch ] ];
+		else
+			next_state = pregex_comb_goto( search->rdense
+												? search->rdense->comb
+												: (pregex_comb*)NULL,
+											search->rtrans[ state ], state, ch );
+
+		if( next_state == search->rtrans_cnt )
+			break;
+
+		state = next_state;
+
+		if( search->rtrans[ state ][ 1 ]
+				&& pregex_search_begin( search->rtrans[ state ][ 2 ],
+											start, ptr, flags ) )
+			*mstart = ptr;
+	}
+
+	VARS( "*mstart", "%s", *mstart );
+	RETURN( *mstart < end );
+}
+
+/** Searches backwards for the rightmost match of the search machine //search//
+in the input from //start// to //stop//, which is processed according to the
+runtime //flags//. The backward search DFA must have been added to //search//
+by pregex_search_backward() before.
+
+The input is read once from //stop// towards //start//. If a match is found,
+the function returns TRUE, and //mstart// receives the pointer where the
+rightmost match begins. The match itself must be run afterwards with the
+anchored DFA on //mstart//, limited to //stop//.
+*/
+pboolean pregex_search_rfind( pregex_search* search, char* start, char* stop,
+								char** mstart, int flags )
+{
+	int				state		= 0;
+	int				next_state;
+	char*			ptr			= stop;
+	wchar_t			ch;
+
+	PROC( "pregex_search_rfind" );
+	PARMS( "search", "%p", search );
+	PARMS( "start", "%p", start );
+	PARMS( "stop", "%p", stop );
+	PARMS( "mstart", "%p", mstart );
+	PARMS( "flags", "%d", flags );
+
+	if( !( search && search->btrans && start && stop && mstart ) )
+	{
+		WRONGPARAM;
+		RETURN( FALSE );
+	}
+
+	while( ptr > start )
+	{
+		/* Get previous character */
+		ch = pregex_search_prevchar( &ptr, start, stop, flags );
+
+		if( search->bdense && (unsigned int)ch < 256 )
+			next_state = search->bdense->trans[ state * search->bdense->classes
+												+ search->bdense->map[ ch ] ];
+		else
+			next_state = pregex_comb_goto( search->bdense
+												? search->bdense->comb
+												: (pregex_comb*)NULL,
+											search->btrans[ state ], state, ch );
+
+		if( next_state == search->btrans_cnt )
+			break;
+
+		state = next_state;
+
+		if( search->btrans[ state ][ 1 ]
+				&& pregex_search_begin( search->btrans[ state ][ 2 ],
+											start, ptr, flags ) )
+		{
+			*mstart = ptr;
+
+			VARS( "*mstart", "%p", *mstart );
+			RETURN( TRUE );
+		}
+	}
+
+	RETURN( FALSE );
+}
+
 
 /*COD_ON*/
 
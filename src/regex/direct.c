@@ -10,8 +10,242 @@ Usage:	Direct regular expression access functions running an internal pregex
 		object.
 ----------------------------------------------------------------------------- */
 
+/* windows.h comes first, as phorward.h redefines its BOOLEAN */
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
 #include "phorward.h"
 
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+/* Cached regular expression of the pregex_q*() functions */
+typedef struct
+{
+	char*			pat;		/* Copy of the pattern */
+	int				flags;		/* Flags the pattern was compiled with */
+	pregex*			regex;		/* Compiled regular expression */
+
+	int				used;		/* Number of calls running the object */
+	pboolean		evicted;	/* Removed from the cache while in use */
+	unsigned long	tick;		/* Time of the recent use */
+} pregex_qentry;
+
+/* Cache of compiled regular expressions, see pregex_qcache() */
+static pregex_qentry**	pregex_qents;
+static size_t			pregex_qsize;
+static size_t			pregex_qcnt;
+static unsigned long	pregex_qtick;
+static size_t			pregex_qhits;
+static size_t			pregex_qmisses;
+static size_t			pregex_qevictions;
+
+#ifndef _WIN32
+static pthread_mutex_t	pregex_qmutex	= PTHREAD_MUTEX_INITIALIZER;
+#define pregex_qlock()		pthread_mutex_lock( &pregex_qmutex )
+#define pregex_qunlock()	pthread_mutex_unlock( &pregex_qmutex )
+#else
+static SRWLOCK			pregex_qmutex	= SRWLOCK_INIT;
+#define pregex_qlock()		AcquireSRWLockExclusive( &pregex_qmutex )
+#define pregex_qunlock()	ReleaseSRWLockExclusive( &pregex_qmutex )
+#endif
+
+/* Frees the cache entry //ent//; The cache must be locked. */
+static void pregex_qentry_free( pregex_qentry* ent )
+{
+	pregex_free( ent->regex );
+	pfree( ent->pat );
+	pfree( ent );
+}
+
+/* Removes the least recently used entry from the cache, and frees it unless it
+is in use; The cache must be locked. */
+static void pregex_qentry_evict( void )
+{
+	pregex_qentry*	ent;
+	size_t			lru;
+	size_t			i;
+
+	for( lru = 0, i = 1; i < pregex_qcnt; i++ )
+		if( pregex_qents[ i ]->tick < pregex_qents[ lru ]->tick )
+			lru = i;
+
+	ent = pregex_qents[ lru ];
+	pregex_qents[ lru ] = pregex_qents[ --pregex_qcnt ];
+	pregex_qevictions++;
+
+	if( ent->used )
+		ent->evicted = TRUE;
+	else
+		pregex_qentry_free( ent );
+}
+
+/* Finds and uses the entry for //pat// and //flags// in the cache; The cache
+must be locked. */
+static pregex_qentry* pregex_qentry_get( char* pat, int flags )
+{
+	pregex_qentry*	ent;
+	size_t			i;
+
+	for( i = 0; i < pregex_qcnt; i++ )
+	{
+		ent = pregex_qents[ i ];
+
+		if( ent->flags == flags
+				&& ( ( flags & PREGEX_COMP_WCHAR )
+						? !wcscmp( (wchar_t*)ent->pat, (wchar_t*)pat )
+						: !strcmp( ent->pat, pat ) ) )
+		{
+			ent->used++;
+			ent->tick = ++pregex_qtick;
+			return ent;
+		}
+	}
+
+	return (pregex_qentry*)NULL;
+}
+
+/* Returns the compiled regular expression for //pat// and //flags//, either
+from the cache or newly created. //ent// receives the cache entry, and must be
+passed to pregex_qrelease() afterwards. */
+static pregex* pregex_qacquire( char* pat, int flags, pregex_qentry** ent )
+{
+	pregex*		regex;
+
+	*ent = (pregex_qentry*)NULL;
+
+	/* Pattern objects and lazy DFAs can't be cached */
+	if( flags & ( PREGEX_COMP_PTN | PREGEX_COMP_LAZY ) )
+		return pregex_create( pat, flags );
+
+	pregex_qlock();
+
+	/* The size is changed by pregex_qcache() under the lock */
+	if( !pregex_qsize )
+	{
+		pregex_qunlock();
+		return pregex_create( pat, flags );
+	}
+
+	if( ( *ent = pregex_qentry_get( pat, flags ) ) )
+	{
+		pregex_qhits++;
+		pregex_qunlock();
+
+		return (*ent)->regex;
+	}
+
+	pregex_qmisses++;
+	pregex_qunlock();
+
+	/* Compile outside of the lock */
+	if( !( regex = pregex_create( pat, flags ) ) )
+		return (pregex*)NULL;
+
+	pregex_qlock();
+
+	/* Another call may have cached it meanwhile */
+	if( ( *ent = pregex_qentry_get( pat, flags ) ) )
+	{
+		pregex_qunlock();
+		pregex_free( regex );
+
+		return (*ent)->regex;
+	}
+
+	if( pregex_qsize )
+	{
+		if( pregex_qcnt >= pregex_qsize )
+			pregex_qentry_evict();
+
+		*ent = (pregex_qentry*)pmalloc( sizeof( pregex_qentry ) );
+		(*ent)->pat = ( flags & PREGEX_COMP_WCHAR )
+						? (char*)pwcsdup( (wchar_t*)pat ) : pstrdup( pat );
+		(*ent)->flags = flags;
+		(*ent)->regex = regex;
+		(*ent)->used = 1;
+		(*ent)->tick = ++pregex_qtick;
+
+		pregex_qents[ pregex_qcnt++ ] = *ent;
+	}
+
+	pregex_qunlock();
+	return regex;
+}
+
+/* Releases //regex// obtained from pregex_qacquire() with its entry //ent//. */
+static void pregex_qrelease( pregex* regex, pregex_qentry* ent )
+{
+	if( !ent )
+	{
+		pregex_free( regex );
+		return;
+	}
+
+	pregex_qlock();
+
+	if( !--ent->used && ent->evicted )
+		pregex_qentry_free( ent );
+
+	pregex_qunlock();
+}
+
+/** Sets the number of compiled regular expressions kept by pregex_qmatch(),
+pregex_qsplit() and pregex_qreplace() to //size//.
+
+By default, these functions compile their pattern on every call. With a cache,
+the recently used objects are kept by pattern and flags, and the least recently
+used object is dropped when the cache is full. A //size// of 0 disables the
+cache and releases all cached objects. Patterns with PREGEX_COMP_PTN or
+PREGEX_COMP_LAZY are never cached.
+
+The cache can be used by several threads at once.
+*/
+void pregex_qcache( size_t size )
+{
+	PROC( "pregex_qcache" );
+	PARMS( "size", "%ld", size );
+
+	pregex_qlock();
+
+	while( pregex_qcnt > size )
+		pregex_qentry_evict();
+
+	if( size )
+		pregex_qents = (pregex_qentry**)prealloc( pregex_qents,
+										size * sizeof( pregex_qentry* ) );
+	else
+		pregex_qents = (pregex_qentry**)pfree( pregex_qents );
+
+	pregex_qsize = size;
+
+	pregex_qunlock();
+
+	VOIDRET;
+}
+
+/** Returns the counters of the cache set up by pregex_qcache().
+
+//hits// receives the number of calls served from the cache, //misses// the
+number of patterns compiled, and //evictions// the number of objects dropped.
+Each of them is optional.
+*/
+void pregex_qcache_stats( size_t* hits, size_t* misses, size_t* evictions )
+{
+	pregex_qlock();
+
+	if( hits )
+		*hits = pregex_qhits;
+	if( misses )
+		*misses = pregex_qmisses;
+	if( evictions )
+		*evictions = pregex_qevictions;
+
+	pregex_qunlock();
+}
+
 /** Performs a regular expression match on a string, and returns an array of
 matches via prange-structures, which hold pointers to the begin- and
 end-addresses of all matches.
@@ -32,8 +266,11 @@ returned array //matches//. If the value is negative, an error occured.
 */
 int pregex_qmatch( char* regex, char* str, int flags, parray** matches )
 {
-	int			count;
-	pregex*		re;
+	int				count;
+	pregex*			re;
+	pregex_qentry*	ent;
+	pregex_iter		it;
+	prange			m;
 
 	PROC( "pregex_qmatch" );
 	PARMS( "regex", "%s", pstrget( regex ) );
@@ -47,11 +284,29 @@ int pregex_qmatch( char* regex, char* str, int flags, parray** matches )
 		RETURN( -1 );
 	}
 
-	if( !( re = pregex_create( regex, flags ) ) )
+	/* References are not used, so small patterns run a bit-parallel NFA */
+	if( !( re = pregex_qacquire( regex, flags | PREGEX_COMP_BITNFA
+											| PREGEX_RUN_NOREF, &ent ) ) )
 		RETURN( -1 );
 
-	count = pregex_findall( re, str, matches );
-	pregex_free( re );
+	if( matches )
+		*matches = (parray*)NULL;
+
+	/* The iterator doesn't touch the object, which may be shared */
+	pregex_iter_init( &it, re, str, (char*)NULL );
+
+	for( count = 0; pregex_iter_next( &it, &m ); count++ )
+	{
+		if( !matches )
+			continue;
+
+		if( !*matches )
+			*matches = parray_create( sizeof( prange ), 0 );
+
+		parray_push( *matches, &m );
+	}
+
+	pregex_qrelease( re, ent );
 
 	VARS( "count", "%d", count );
 	RETURN( count );
@@ -76,8 +331,12 @@ the returned array //matches//. If the value is negative, an error occured.
 */
 int pregex_qsplit( char* regex, char* str, int flags, parray** matches )
 {
-	int			count;
-	pregex*		re;
+	int				count;
+	pregex*			re;
+	pregex_qentry*	ent;
+	prange			m;
+	char*			begin	= str;
+	char*			next;
 
 	PROC( "pregex_qsplit" );
 	PARMS( "regex", "%s", pstrget( regex ) );
@@ -91,11 +350,43 @@ int pregex_qsplit( char* regex, char* str, int flags, parray** matches )
 		RETURN( -1 );
 	}
 
-	if( !( re = pregex_create( regex, flags ) ) )
+	/* References are not used, so small patterns run a bit-parallel NFA */
+	if( !( re = pregex_qacquire( regex, flags | PREGEX_COMP_BITNFA
+											| PREGEX_RUN_NOREF, &ent ) ) )
 		RETURN( -1 );
 
-	count = pregex_splitall( re, str, matches );
-	pregex_free( re );
+	if( matches )
+		*matches = (parray*)NULL;
+
+	/* Empty pieces are counted, but not returned */
+	for( count = 0; str; count++ )
+	{
+		m.id = 0;
+		m.start = str;
+
+		if( !( m.end = pregex_find_in( re, begin, str, (char*)NULL, &next,
+										(prange*)NULL ) ) )
+		{
+			if( re->flags & PREGEX_RUN_WCHAR )
+				m.end = (char*)( (wchar_t*)str + wcslen( (wchar_t*)str ) );
+			else
+				m.end = str + strlen( str );
+
+			next = (char*)NULL;
+		}
+
+		if( matches && m.end > m.start )
+		{
+			if( !*matches )
+				*matches = parray_create( sizeof( prange ), 0 );
+
+			parray_push( *matches, &m );
+		}
+
+		str = next;
+	}
+
+	pregex_qrelease( re, ent );
 
 	VARS( "count", "%d", count );
 	RETURN( count );
@@ -123,6 +414,7 @@ char* pregex_qreplace( char* regex, char* str, char* replace, int flags )
 {
 	char*			ret;
 	pregex*			re;
+	pregex_qentry*	ent;
 
 	PROC( "pregex_qreplace" );
 	PARMS( "regex", "%s", pstrget( regex ) );
@@ -136,19 +428,13 @@ char* pregex_qreplace( char* regex, char* str, char* replace, int flags )
 		RETURN( (char*)NULL );
 	}
 
-	if( !( re = pregex_create( regex, flags ) ) )
-	{
-		pregex_free( re );
+	/* Small patterns without references run a bit-parallel NFA */
+	if( !( re = pregex_qacquire( regex, flags | PREGEX_COMP_BITNFA, &ent ) ) )
 		RETURN( (char*)NULL );
-	}
-
-	if( !( ret = pregex_replace( re, str, replace ) ) )
-	{
-		pregex_free( re );
-		RETURN( (char*)NULL );
-	}
 
-	pregex_free( re );
+	/* pregex_replace() doesn't touch the object, which may be shared */
+	ret = pregex_replace( re, str, replace );
+	pregex_qrelease( re, ent );
 
 	VARS( "ret", "%s", ret );
 	RETURN( ret );
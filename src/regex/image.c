@@ -0,0 +1,617 @@
+/* -MODULE----------------------------------------------------------------------
+Phorward Foundation Toolkit
+Copyright (C) 2006-2018 by Phorward Software Technologies, Jan Max Meyer
+http://www.phorward-software.com ++ contact<at>phorward<dash>software<dot>com
+All rights reserved. See LICENSE for more information.
+
+File:	image.c
+Author:	Jan Max Meyer
+Usage:	Saving and loading compiled pregex and plex objects as binary images.
+----------------------------------------------------------------------------- */
+
+#include "phorward.h"
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#endif
+
+/* Image kinds */
+#define PREGEX_IMAGE_REGEX		1
+#define PREGEX_IMAGE_LEX		2
+
+/* Tables within an image */
+#define PREGEX_IMAGE_TRANS		0	/* DFA transitions */
+#define PREGEX_IMAGE_STRANS		1	/* Forward search DFA transitions */
+#define PREGEX_IMAGE_RTRANS		2	/* Reverse DFA transitions */
+#define PREGEX_IMAGE_BTRANS		3	/* Backward search DFA transitions */
+#define PREGEX_IMAGE_TABLES		4
+
+#define PREGEX_IMAGE_ALIGN( n )	( ( (n) + 7 ) & ~( (size_t)7 ) )
+
+/* Image header; All offsets are relative to the begin of the image */
+typedef struct
+{
+	char			magic		[ 8 ];
+								/* PREGEX_IMAGE_MAGIC */
+	uint32_t		version;	/* PREGEX_IMAGE_VERSION */
+	uint32_t		order;		/* Byte order mark 0x01020304 */
+	uint32_t		wchar;		/* sizeof( wchar_t ) */
+	uint32_t		kind;		/* PREGEX_IMAGE_REGEX or PREGEX_IMAGE_LEX */
+	uint32_t		size;		/* Image size in bytes */
+	int32_t			flags;		/* Flags of the object */
+	int32_t			sflags;		/* Flags of the search machine */
+	uint32_t		prefix;		/* Offset of the required prefix, or 0 */
+	uint32_t		factor;		/* Offset of the required factor, or 0 */
+	uint32_t		rows		[ PREGEX_IMAGE_TABLES ];
+								/* Number of rows per table */
+	uint32_t		tables		[ PREGEX_IMAGE_TABLES ];
+								/* Offset of the row offsets per table */
+} pregex_image_head;
+
+/*NO_DOC*/
+/* No documentation for the internal functions, see the interface below. */
+
+/* Writes the dfatab //trans// with //trans_cnt// rows, the search machine
+//search// and the literals //prefix// and //factor// as image of //kind// with
+//flags// into the file //path//. */
+static pboolean pregex_image_save( char* path, int kind, int flags,
+									wchar_t** trans, int trans_cnt,
+										pregex_search* search,
+											char* prefix, char* factor )
+{
+	pregex_image_head*	head;
+	wchar_t**			tabs	[ PREGEX_IMAGE_TABLES ];
+	int					cnts	[ PREGEX_IMAGE_TABLES ];
+	uint32_t*			offs;
+	char*				data;
+	size_t				size;
+	FILE*				f;
+	int					i;
+	int					j;
+	pboolean			ret;
+
+	tabs[ PREGEX_IMAGE_TRANS ] = trans;
+	cnts[ PREGEX_IMAGE_TRANS ] = trans_cnt;
+
+	tabs[ PREGEX_IMAGE_STRANS ] = search ? search->trans : (wchar_t**)NULL;
+	cnts[ PREGEX_IMAGE_STRANS ] = search ? search->trans_cnt : 0;
+	tabs[ PREGEX_IMAGE_RTRANS ] = search ? search->rtrans : (wchar_t**)NULL;
+	cnts[ PREGEX_IMAGE_RTRANS ] = search ? search->rtrans_cnt : 0;
+	tabs[ PREGEX_IMAGE_BTRANS ] = search ? search->btrans : (wchar_t**)NULL;
+	cnts[ PREGEX_IMAGE_BTRANS ] = search ? search->btrans_cnt : 0;
+
+	/* Compute the image size */
+	size = PREGEX_IMAGE_ALIGN( sizeof( pregex_image_head ) );
+
+	for( i = 0; i < PREGEX_IMAGE_TABLES; i++ )
+	{
+		size += PREGEX_IMAGE_ALIGN( cnts[ i ] * sizeof( uint32_t ) );
+
+		for( j = 0; j < cnts[ i ]; j++ )
+			size += PREGEX_IMAGE_ALIGN( ( tabs[ i ][ j ][ 0 ]
+								+ pregex_dfatab_fallback( tabs[ i ][ j ] ) )
+									* sizeof( wchar_t ) );
+	}
+
+	if( prefix )
+		size += strlen( prefix ) + 1;
+	if( factor )
+		size += strlen( factor ) + 1;
+
+	if( size > UINT32_MAX )
+	{
+		/* Image too large */
+		return FALSE;
+	}
+
+	/* Fill the image */
+	data = (char*)pmalloc( size );
+	head = (pregex_image_head*)data;
+
+	memcpy( head->magic, PREGEX_IMAGE_MAGIC, sizeof( head->magic ) );
+	head->version = PREGEX_IMAGE_VERSION;
+	head->order = 0x01020304;
+	head->wchar = sizeof( wchar_t );
+	head->kind = kind;
+	head->size = size;
+	head->flags = flags;
+	head->sflags = search ? search->flags : 0;
+
+	size = PREGEX_IMAGE_ALIGN( sizeof( pregex_image_head ) );
+
+	for( i = 0; i < PREGEX_IMAGE_TABLES; i++ )
+	{
+		head->rows[ i ] = cnts[ i ];
+		head->tables[ i ] = size;
+
+		offs = (uint32_t*)( data + size );
+		size += PREGEX_IMAGE_ALIGN( cnts[ i ] * sizeof( uint32_t ) );
+
+		for( j = 0; j < cnts[ i ]; j++ )
+		{
+			offs[ j ] = size;
+			memcpy( data + size, tabs[ i ][ j ],
+						( tabs[ i ][ j ][ 0 ]
+							+ pregex_dfatab_fallback( tabs[ i ][ j ] ) )
+								* sizeof( wchar_t ) );
+
+			size += PREGEX_IMAGE_ALIGN( ( tabs[ i ][ j ][ 0 ]
+								+ pregex_dfatab_fallback( tabs[ i ][ j ] ) )
+									* sizeof( wchar_t ) );
+		}
+	}
+
+	if( prefix )
+	{
+		head->prefix = size;
+		strcpy( data + size, prefix );
+		size += strlen( prefix ) + 1;
+	}
+
+	if( factor )
+	{
+		head->factor = size;
+		strcpy( data + size, factor );
+		size += strlen( factor ) + 1;
+	}
+
+	/* Write it */
+	if( !( f = fopen( path, "wb" ) ) )
+	{
+		/* File could not be opened */
+		pfree( data );
+		return FALSE;
+	}
+
+	ret = fwrite( data, sizeof( char ), size, f ) == size;
+
+	if( fclose( f ) )
+		ret = FALSE;
+
+	pfree( data );
+	return ret;
+}
+
+/* Loads the image of //kind// from file //path//. The file is mapped into
+memory where possible, else it is read. */
+static pregex_image* pregex_image_load( char* path, int kind )
+{
+	pregex_image*		image;
+	pregex_image_head*	head;
+#ifndef _WIN32
+	struct stat			st;
+	int					fd;
+#else
+	FILE*				f;
+	long				size;
+#endif
+
+	image = (pregex_image*)pmalloc( sizeof( pregex_image ) );
+
+#ifndef _WIN32
+	if( ( fd = open( path, O_RDONLY ) ) < 0 )
+	{
+		/* File could not be opened */
+		pfree( image );
+		return (pregex_image*)NULL;
+	}
+
+	if( fstat( fd, &st ) < 0
+			|| (size_t)st.st_size < sizeof( pregex_image_head )
+			|| ( image->data = (char*)mmap( NULL, st.st_size, PROT_READ,
+									MAP_PRIVATE, fd, 0 ) ) == MAP_FAILED )
+	{
+		/* File could not be mapped */
+		close( fd );
+		pfree( image );
+		return (pregex_image*)NULL;
+	}
+
+	close( fd );
+
+	image->size = st.st_size;
+	image->mapped = TRUE;
+#else
+	if( !( f = fopen( path, "rb" ) ) )
+	{
+		/* File could not be opened */
+		pfree( image );
+		return (pregex_image*)NULL;
+	}
+
+	fseek( f, 0L, SEEK_END );
+
+	if( ( size = ftell( f ) ) < (long)sizeof( pregex_image_head ) )
+	{
+		/* File too small */
+		fclose( f );
+		pfree( image );
+		return (pregex_image*)NULL;
+	}
+
+	fseek( f, 0L, SEEK_SET );
+
+	image->size = size;
+	image->data = (char*)pmalloc( image->size );
+
+	if( fread( image->data, sizeof( char ), image->size, f ) != image->size )
+	{
+		/* File could not be read */
+		fclose( f );
+		return pregex_image_free( image, (int*)NULL, (pregex_search*)NULL );
+	}
+
+	fclose( f );
+#endif
+
+	/* Check the header */
+	head = (pregex_image_head*)image->data;
+
+	if( memcmp( head->magic, PREGEX_IMAGE_MAGIC, sizeof( head->magic ) )
+			|| head->version != PREGEX_IMAGE_VERSION
+			|| head->order != 0x01020304
+			|| head->wchar != sizeof( wchar_t )
+			|| head->kind != kind
+			|| head->size != image->size )
+	{
+		/* Not a valid image of this kind, version or platform */
+		return pregex_image_free( image, (int*)NULL, (pregex_search*)NULL );
+	}
+
+	return image;
+}
+
+/* Sets up the row pointers of //table// from //image// into //trans//. All rows
+are checked to stay within the image with their further accepting patterns,
+and to contain only valid character ranges and goto-states.
+Returns the number of rows, 0 if the table is empty, or -1 on error. */
+static int pregex_image_table( pregex_image* image, int table,
+									wchar_t*** trans )
+{
+	pregex_image_head*	head	= (pregex_image_head*)image->data;
+	uint32_t*			offs;
+	wchar_t*			row;
+	size_t				off;
+	size_t				rows;
+	size_t				i;
+	size_t				j;
+
+	*trans = (wchar_t**)NULL;
+
+	if( !( rows = head->rows[ table ] ) )
+		return 0;
+
+	if( head->tables[ table ] % sizeof( uint32_t )
+			|| rows > INT_MAX
+			|| head->tables[ table ] > image->size
+			|| rows > ( image->size - head->tables[ table ] )
+							/ sizeof( uint32_t ) )
+		return -1;
+
+	offs = (uint32_t*)( image->data + head->tables[ table ] );
+	*trans = (wchar_t**)pmalloc( rows * sizeof( wchar_t* ) );
+
+	for( i = 0; i < rows; i++ )
+	{
+		off = offs[ i ];
+
+		if( off % sizeof( wchar_t ) || off > image->size
+				|| image->size - off < 5 * sizeof( wchar_t ) )
+			break;
+
+		row = (wchar_t*)( image->data + off );
+
+		if( row[ 0 ] < 5 || ( row[ 0 ] - 5 ) % 3
+				|| (size_t)row[ 0 ] > ( image->size - off ) / sizeof( wchar_t )
+				|| (size_t)row[ 4 ] > rows )
+			break;
+
+		for( j = 5; j < (size_t)row[ 0 ]; j += 3 )
+			if( row[ j ] < 0 || row[ j ] > row[ j + 1 ]
+					|| (size_t)row[ j + 2 ] > rows )
+				break;
+
+		if( j < (size_t)row[ 0 ] )
+			break;
+
+		/* Further accepting patterns behind the transitions */
+		if( row[ 2 ] & PREGEX_FLAG_FALLBACK
+				&& ( (size_t)row[ 0 ] + 1
+						> ( image->size - off ) / sizeof( wchar_t )
+					|| row[ row[ 0 ] ] < 1
+					|| (size_t)row[ row[ 0 ] ]
+						> ( ( image->size - off ) / sizeof( wchar_t )
+								- row[ 0 ] - 1 ) / 2 ) )
+			break;
+
+		( *trans )[ i ] = row;
+	}
+
+	if( i < rows )
+	{
+		/* Invalid row in image */
+		*trans = pfree( *trans );
+		return -1;
+	}
+
+	return (int)rows;
+}
+
+/* Sets up the dfatab //trans// with //trans_cnt// rows, its dense table
+//dense// and the search machine //search// from //image//. */
+static pboolean pregex_image_machine( pregex_image* image,
+										wchar_t*** trans, int* trans_cnt,
+											pregex_dense** dense,
+												pregex_search** search )
+{
+	pregex_image_head*	head	= (pregex_image_head*)image->data;
+	pregex_search*		srch;
+
+	if( ( *trans_cnt = pregex_image_table( image, PREGEX_IMAGE_TRANS,
+												trans ) ) <= 0 )
+	{
+		*trans_cnt = 0;
+		return FALSE;
+	}
+
+	*dense = pregex_dense_create( *trans, *trans_cnt );
+
+	if( head->rows[ PREGEX_IMAGE_STRANS ] && head->rows[ PREGEX_IMAGE_RTRANS ] )
+	{
+		srch = *search = (pregex_search*)pmalloc( sizeof( pregex_search ) );
+		srch->flags = head->sflags;
+
+		if( ( srch->trans_cnt = pregex_image_table( image,
+									PREGEX_IMAGE_STRANS, &srch->trans ) ) < 0
+			|| ( srch->rtrans_cnt = pregex_image_table( image,
+									PREGEX_IMAGE_RTRANS, &srch->rtrans ) ) < 0 )
+		{
+			srch->trans_cnt = srch->rtrans_cnt = 0;
+			return FALSE;
+		}
+
+		srch->dense = pregex_dense_create( srch->trans, srch->trans_cnt );
+		srch->rdense = pregex_dense_create( srch->rtrans, srch->rtrans_cnt );
+
+		/* The backward search DFA is optional */
+		if( head->rows[ PREGEX_IMAGE_BTRANS ] )
+		{
+			if( ( srch->btrans_cnt = pregex_image_table( image,
+									PREGEX_IMAGE_BTRANS, &srch->btrans ) ) < 0 )
+			{
+				srch->btrans_cnt = 0;
+				return FALSE;
+			}
+
+			srch->bdense = pregex_dense_create( srch->btrans,
+												srch->btrans_cnt );
+		}
+	}
+
+	return TRUE;
+}
+
+/* Copies the string at offset //off// of //image//, if there is one. */
+static char* pregex_image_string( pregex_image* image, uint32_t off )
+{
+	if( !off || off >= image->size
+			|| !memchr( image->data + off, '\0', image->size - off ) )
+		return (char*)NULL;
+
+	return pstrdup( image->data + off );
+}
+
+/** Frees the image //image//.
+
+The rows of the DFA tables of an object loaded from //image// are part of the
+image. //trans_cnt// and the row counts of //search// are reset, so that they
+are not freed with the object. Both can be left empty.
+
+Always returns (pregex_image*)NULL. */
+pregex_image* pregex_image_free( pregex_image* image, int* trans_cnt,
+									pregex_search* search )
+{
+	if( !image )
+		return (pregex_image*)NULL;
+
+	if( trans_cnt )
+		*trans_cnt = 0;
+
+	if( search )
+		search->trans_cnt = search->rtrans_cnt = search->btrans_cnt = 0;
+
+#ifndef _WIN32
+	if( image->mapped )
+		munmap( image->data, image->size );
+	else
+#endif
+		pfree( image->data );
+
+	pfree( image );
+
+	return (pregex_image*)NULL;
+}
+
+/*COD_ON*/
+
+/** Saves the compiled regular expression //regex// as binary image into the
+file //path//.
+
+The image contains the DFA table with all ID, flag and reference columns, the
+search machine and the required literals of //regex//, but not the pattern.
+Its format is versioned and position-independent, but bound to the byte order
+and wchar_t size of the platform. Objects using PREGEX_COMP_LAZY or
+PREGEX_COMP_BITNFA are compiled into a DFA table for the image.
+
+Returns TRUE on success, FALSE if the image could not be written.
+*/
+pboolean pregex_save( pregex* regex, char* path )
+{
+	wchar_t**		trans;
+	int				trans_cnt;
+	pregex_search*	search;
+	pboolean		ret;
+	int				i;
+
+	PROC( "pregex_save" );
+	PARMS( "regex", "%p", regex );
+	PARMS( "path", "%s", path );
+
+	if( !( regex && path && *path ) )
+	{
+		WRONGPARAM;
+		RETURN( FALSE );
+	}
+
+	trans = regex->trans;
+	trans_cnt = regex->trans_cnt;
+	search = regex->search;
+
+	/* Lazy DFAs and bit-parallel NFAs have no dfatab, compile it now */
+	if( !trans_cnt )
+	{
+		if( ( trans_cnt = pregex_ptn_to_dfatab( &trans, regex->ptn ) ) <= 0 )
+			RETURN( FALSE );
+
+		if( ( search = pregex_search_create( trans, trans_cnt,
+												regex->flags ) ) )
+			pregex_search_backward( search, trans, trans_cnt );
+	}
+
+	ret = pregex_image_save( path, PREGEX_IMAGE_REGEX, regex->flags,
+								trans, trans_cnt, search,
+									regex->prefix, regex->factor );
+
+	if( trans != regex->trans )
+	{
+		for( i = 0; i < trans_cnt; i++ )
+			pfree( trans[ i ] );
+
+		pfree( trans );
+		pregex_search_free( search );
+	}
+
+	RETURN( ret );
+}
+
+/** Loads a compiled regular expression from the binary image in file //path//,
+as written by pregex_save().
+
+The file is mapped into memory, and the regular expression is matched directly
+from the mapped DFA tables. Only the dense transition tables are constructed
+on load.
+
+Returns a pointer to the pregex-object, which must be freed using pregex_free().
+Returns (pregex*)NULL if the file is not a valid image for this platform.
+*/
+pregex* pregex_load( char* path )
+{
+	pregex*				regex;
+	pregex_image*		image;
+	pregex_image_head*	head;
+
+	PROC( "pregex_load" );
+	PARMS( "path", "%s", path );
+
+	if( !( path && *path ) )
+	{
+		WRONGPARAM;
+		RETURN( (pregex*)NULL );
+	}
+
+	if( !( image = pregex_image_load( path, PREGEX_IMAGE_REGEX ) ) )
+		RETURN( (pregex*)NULL );
+
+	head = (pregex_image_head*)image->data;
+
+	regex = (pregex*)pmalloc( sizeof( pregex ) );
+	regex->flags = head->flags;
+	regex->image = image;
+
+	if( !pregex_image_machine( image, &regex->trans, &regex->trans_cnt,
+								&regex->dense, &regex->search ) )
+		RETURN( pregex_free( regex ) );
+
+	regex->prefix = pregex_image_string( image, head->prefix );
+	regex->factor = pregex_image_string( image, head->factor );
+
+	RETURN( regex );
+}
+
+/** Saves the compiled lexical analyzer //lex// as binary image into the file
+//path//.
+
+The lexer is prepared first, if required. The image contains the DFA table
+with all ID, flag and reference columns and the search machine, but not the
+patterns. Lexers using PREGEX_COMP_LAZY can't be saved.
+
+Returns TRUE on success, FALSE if the image could not be written.
+*/
+pboolean plex_save( plex* lex, char* path )
+{
+	PROC( "plex_save" );
+	PARMS( "lex", "%p", lex );
+	PARMS( "path", "%s", path );
+
+	if( !( lex && path && *path ) )
+	{
+		WRONGPARAM;
+		RETURN( FALSE );
+	}
+
+	if( !lex->trans_cnt && !lex->lazy && !plex_prepare( lex ) )
+		RETURN( FALSE );
+
+	if( lex->lazy )
+	{
+		MSG( "Lazy DFAs can't be saved" );
+		RETURN( FALSE );
+	}
+
+	RETURN( pregex_image_save( path, PREGEX_IMAGE_LEX, lex->flags,
+								lex->trans, lex->trans_cnt, lex->search,
+									(char*)NULL, (char*)NULL ) );
+}
+
+/** Loads a compiled lexical analyzer from the binary image in file //path//,
+as written by plex_save().
+
+The file is mapped into memory, and the lexer runs directly on the mapped DFA
+tables. Only the dense transition tables are constructed on load. Patterns
+defined later with plex_define() replace the loaded lexer on the next
+plex_prepare().
+
+Returns a pointer to the plex-object, which must be freed using plex_free().
+Returns (plex*)NULL if the file is not a valid image for this platform.
+*/
+plex* plex_load( char* path )
+{
+	plex*				lex;
+	pregex_image*		image;
+	pregex_image_head*	head;
+
+	PROC( "plex_load" );
+	PARMS( "path", "%s", path );
+
+	if( !( path && *path ) )
+	{
+		WRONGPARAM;
+		RETURN( (plex*)NULL );
+	}
+
+	if( !( image = pregex_image_load( path, PREGEX_IMAGE_LEX ) ) )
+		RETURN( (plex*)NULL );
+
+	head = (pregex_image_head*)image->data;
+
+	lex = plex_create( head->flags );
+	lex->image = image;
+
+	if( !pregex_image_machine( image, &lex->trans, &lex->trans_cnt,
+								&lex->dense, &lex->search ) )
+		RETURN( plex_free( lex ) );
+
+	RETURN( lex );
+}
@@ -0,0 +1,385 @@
+/* -MODULE----------------------------------------------------------------------
+Phorward Foundation Toolkit
+Copyright (C) 2006-2018 by Phorward Software Technologies, Jan Max Meyer
+http://www.phorward-software.com ++ contact<at>phorward<dash>software<dot>com
+All rights reserved. See LICENSE for more information.
+
+File:	lazy.c
+Author:	Jan Max Meyer
+Usage:	Lazy DFA, constructing its states on demand from a NFA.
+----------------------------------------------------------------------------- */
+
+#include "phorward.h"
+
+/*NO_DOC*/
+/* No documentation for the entire module, all here is only used internally. */
+
+/* Compare two int for qsort() */
+static int pregex_lazy_compare( const void* l, const void* r )
+{
+	return *( (int*)l ) - *( (int*)r );
+}
+
+/** Creates a lazy DFA from the NFA //nfa//.
+
+The lazy DFA constructs its states only when they are reached by the input,
+and caches them in a table of at most PREGEX_LAZY_MAXSTATES states, which is
+flushed when it is full. //nfa// is taken by the lazy DFA, and is freed with
+it.
+
+Returns a pointer to the allocated pregex_lazy-object, which must be released
+using pregex_lazy_free().
+*/
+pregex_lazy* pregex_lazy_create( pregex_nfa* nfa )
+{
+	pregex_lazy*	lazy;
+
+	PROC( "pregex_lazy_create" );
+	PARMS( "nfa", "%p", nfa );
+
+	if( !( nfa && plist_count( nfa->states ) ) )
+	{
+		WRONGPARAM;
+		RETURN( (pregex_lazy*)NULL );
+	}
+
+	lazy = (pregex_lazy*)pmalloc( sizeof( pregex_lazy ) );
+	lazy->nfa = nfa;
+
+	/* Number the NFA states */
+	pregex_nfa_index( nfa );
+
+	/* Working area */
+	lazy->work = pregex_nfa_set_create( nfa->cnt );
+
+	VARS( "nfa->cnt", "%d", nfa->cnt );
+	RETURN( lazy );
+}
+
+/* Flushes all cached states of //lazy//. */
+static void pregex_lazy_flush( pregex_lazy* lazy )
+{
+	int		i;
+
+	for( i = 0; i < lazy->states_cnt; i++ )
+	{
+		pfree( lazy->states[ i ].set );
+		pfree( lazy->states[ i ].fallback );
+	}
+
+	lazy->states_cnt = 0;
+	memset( lazy->buckets, 0, sizeof( lazy->buckets ) );
+}
+
+/** Frees the lazy DFA //lazy// including its NFA.
+
+Always returns (pregex_lazy*)NULL. */
+pregex_lazy* pregex_lazy_free( pregex_lazy* lazy )
+{
+	if( !lazy )
+		return (pregex_lazy*)NULL;
+
+	pregex_lazy_flush( lazy );
+	pfree( lazy->states );
+
+	pregex_nfa_free( lazy->nfa );
+	pregex_nfa_set_free( lazy->work );
+
+	pfree( lazy );
+
+	return (pregex_lazy*)NULL;
+}
+
+/* Moves the NFA state set //set// with //cnt// states on character //ch//,
+and performs the epsilon closure. The result is stored in lazy->work, and the
+number of its states is returned. */
+static int pregex_lazy_move( pregex_lazy* lazy, int* set, int cnt, wchar_t ch )
+{
+	if( pregex_nfa_move( lazy->nfa, lazy->work, set, cnt, ch, ch ) <= 0 )
+		return 0;
+
+	return pregex_nfa_epsilon_closure( lazy->nfa, lazy->work,
+										(unsigned int*)NULL, (int*)NULL );
+}
+
+/* Determines accept, flags and refs of the NFA state set //set// into //st//,
+the same way as pregex_dfa_from_nfa() does. */
+static void pregex_lazy_describe( pregex_lazy* lazy, pregex_lazy_st* st,
+									int* set, int cnt )
+{
+	pregex_nfa_st*	nfa_st;
+	int				i;
+
+	st->accept = 0;
+	st->flags = 0;
+	st->fallback = pfree( st->fallback );
+	st->refs = 0;
+
+	for( i = 0; i < cnt; i++ )
+	{
+		nfa_st = lazy->nfa->index[ set[ i ] ];
+
+		pregex_accept_add( &st->accept, &st->flags, &st->fallback,
+							nfa_st->accept, nfa_st->flags );
+
+		st->refs |= nfa_st->refs;
+	}
+}
+
+/* Get or insert the state for the NFA state set in lazy->work with //cnt//
+states; the set is sorted in place, which invalidates it for further
+insertions. A full cache is flushed before insertion. */
+static int pregex_lazy_get_state( pregex_lazy* lazy, int cnt )
+{
+	pregex_lazy_st*	st;
+	int*			set		= lazy->work->dense;
+	unsigned int	hash	= 0;
+	int				i;
+
+	qsort( set, cnt, sizeof( int ), pregex_lazy_compare );
+
+	for( i = 0; i < cnt; i++ )
+		hash = hash * 31 + set[ i ];
+
+	for( i = lazy->buckets[ hash % PREGEX_LAZY_BUCKETS ]; i; i = st->next )
+	{
+		st = &lazy->states[ i - 1 ];
+
+		if( st->hash == hash && st->cnt == cnt
+				&& !memcmp( st->set, set, cnt * sizeof( int ) ) )
+			return i - 1;
+	}
+
+	/* Cache is full, flush it */
+	if( lazy->states_cnt == PREGEX_LAZY_MAXSTATES )
+	{
+		pregex_lazy_flush( lazy );
+		lazy->flushes++;
+	}
+
+	if( !lazy->states )
+		lazy->states = (pregex_lazy_st*)pmalloc(
+							PREGEX_LAZY_MAXSTATES * sizeof( pregex_lazy_st ) );
+
+	st = &lazy->states[ lazy->states_cnt++ ];
+	memset( st, 0, sizeof( pregex_lazy_st ) );
+
+	st->set = (int*)pmemdup( set, cnt * sizeof( int ) );
+	st->cnt = cnt;
+	st->hash = hash;
+
+	pregex_lazy_describe( lazy, st, st->set, cnt );
+
+	st->next = lazy->buckets[ hash % PREGEX_LAZY_BUCKETS ];
+	lazy->buckets[ hash % PREGEX_LAZY_BUCKETS ] = lazy->states_cnt;
+
+	return lazy->states_cnt - 1;
+}
+
+/* Get the initial state of //lazy//. */
+static int pregex_lazy_initial( pregex_lazy* lazy )
+{
+	lazy->work->cnt = 0;
+	pregex_nfa_set_add( lazy->work, 0 );
+
+	return pregex_lazy_get_state( lazy,
+				pregex_nfa_epsilon_closure( lazy->nfa, lazy->work,
+											(unsigned int*)NULL, (int*)NULL ) );
+}
+
+/** Checks if the initial state of //lazy// has a transition on //ch//. */
+pboolean pregex_lazy_first( pregex_lazy* lazy, wchar_t ch )
+{
+	pregex_lazy_st*	st;
+	int				state;
+
+	if( !lazy )
+	{
+		WRONGPARAM;
+		return FALSE;
+	}
+
+	state = pregex_lazy_initial( lazy );
+	st = &lazy->states[ state ];
+
+	if( (unsigned int)ch < 256 && st->trans[ ch ] )
+		return st->trans[ ch ] > 0;
+
+	return pregex_lazy_move( lazy, st->set, st->cnt, ch ) > 0;
+}
+
+/** Tries to match the lazy DFA //lazy// at pointer //start//.
+
+//stop// is the end of the input, or (char*)NULL for zero-terminated input.
+//ref// is an optional array of PREGEX_MAXREF references receiving the
+reference positions of the match.
+//flags// are the runtime flags (PREGEX_RUN_*) to be used.
+
+If the lazy DFA can be matched, the function returns the match ID of the
+accepting state, and //end// receives the pointer to the last matched character.
+Otherwise, the function returns 0.
+
+States are constructed and cached as they are reached by the input. When the
+cache is flushed more than once within fewer than PREGEX_LAZY_MINCHARS
+characters, the remaining input is matched by simulating the NFA directly,
+without caching any states.
+*/
+int pregex_lazy_match( pregex_lazy* lazy, char* start, char* stop,
+						char** end, prange* ref, int flags )
+{
+	pregex_lazy_st*	st;
+	pregex_lazy_st	nfa_st;
+	int				i;
+	int				state;
+	int				next_state;
+	int				cnt;
+	int				flushes;
+	int				id			= 0;
+	int				aflags;
+	unsigned int	acc;
+	size_t			chars		= 0;
+	size_t			last_flush	= 0;
+	pboolean		nfa_mode	= FALSE;
+	char*			match		= (char*)NULL;
+	char*			ptr			= start;
+	wchar_t			ch;
+
+	PROC( "pregex_lazy_match" );
+	PARMS( "lazy", "%p", lazy );
+	PARMS( "start", "%s", start );
+	PARMS( "stop", "%p", stop );
+	PARMS( "end", "%p", end );
+	PARMS( "ref", "%p", ref );
+	PARMS( "flags", "%d", flags );
+
+	if( !( lazy && start ) )
+	{
+		WRONGPARAM;
+		RETURN( 0 );
+	}
+
+	if( ref )
+		memset( ref, 0, PREGEX_MAXREF * sizeof( prange ) );
+
+	memset( &nfa_st, 0, sizeof( pregex_lazy_st ) );
+
+	state = pregex_lazy_initial( lazy );
+	st = &lazy->states[ state ];
+	flushes = lazy->flushes;
+
+	while( TRUE )
+	{
+		/* State accepts, and the anchors of one of its patterns hold? */
+		for( i = 0; ( acc = pregex_accept_nth( st->accept, st->flags,
+												st->fallback, i, &aflags ) );
+				i++ )
+			if( pregex_anchor_accept( aflags, ptr, stop, flags ) )
+				break;
+
+		if( acc )
+		{
+			MSG( "This state accepts the input" );
+			match = ptr;
+			id = acc;
+
+			if( flags & PREGEX_RUN_NONGREEDY
+					|| aflags & PREGEX_FLAG_NONGREEDY )
+				break;
+		}
+
+		/* References */
+		if( ref && st->refs )
+		{
+			for( i = 0; i < PREGEX_MAXREF; i++ )
+			{
+				if( st->refs & ( 1 << i ) )
+				{
+					if( !ref[ i ].start )
+						ref[ i ].start = ptr;
+
+					ref[ i ].end = ptr;
+				}
+			}
+		}
+
+		/* Get next character */
+		if( !pregex_getchar( &ptr, stop, &ch, flags ) )
+			break;
+
+		chars++;
+
+		/* Simulate the NFA without caching */
+		if( nfa_mode )
+		{
+			if( !( cnt = pregex_lazy_move( lazy, nfa_st.set, nfa_st.cnt,
+											ch ) ) )
+				break;
+
+			memcpy( nfa_st.set, lazy->work->dense, cnt * sizeof( int ) );
+			nfa_st.cnt = cnt;
+
+			pregex_lazy_describe( lazy, &nfa_st, nfa_st.set, cnt );
+			continue;
+		}
+
+		/* Cached transition */
+		if( (unsigned int)ch < 256 && st->trans[ ch ] )
+		{
+			if( st->trans[ ch ] < 0 )
+				break;
+
+			state = st->trans[ ch ] - 1;
+			st = &lazy->states[ state ];
+			continue;
+		}
+
+		/* Construct the next state */
+		if( !( cnt = pregex_lazy_move( lazy, st->set, st->cnt, ch ) ) )
+		{
+			if( (unsigned int)ch < 256 )
+				st->trans[ ch ] = -1;
+
+			break;
+		}
+
+		next_state = pregex_lazy_get_state( lazy, cnt );
+
+		if( flushes == lazy->flushes )
+		{
+			if( (unsigned int)ch < 256 )
+				st->trans[ ch ] = next_state + 1;
+		}
+		else
+		{
+			/* Cache was flushed; Switch to NFA on high flush rate */
+			if( last_flush && chars - last_flush < PREGEX_LAZY_MINCHARS )
+			{
+				MSG( "Flush rate too high, simulating NFA" );
+
+				nfa_mode = TRUE;
+				nfa_st.set = (int*)pmalloc( lazy->nfa->cnt * sizeof( int ) );
+				nfa_st.cnt = lazy->states[ next_state ].cnt;
+				memcpy( nfa_st.set, lazy->states[ next_state ].set,
+							nfa_st.cnt * sizeof( int ) );
+
+				pregex_lazy_describe( lazy, &nfa_st, nfa_st.set, nfa_st.cnt );
+				st = &nfa_st;
+				continue;
+			}
+
+			last_flush = chars;
+			flushes = lazy->flushes;
+		}
+
+		state = next_state;
+		st = &lazy->states[ state ];
+	}
+
+	pfree( nfa_st.set );
+	pfree( nfa_st.fallback );
+
+	if( match && end )
+		*end = match;
+
+	RETURN( match ? id : 0 );
+}
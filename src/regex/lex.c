@@ -27,8 +27,15 @@ possible |
 | PREGEX_COMP_STATIC | The regular expressions passed should be converted 1:1 \
 as it where a string-constant. Any regex-specific symbols will be ignored and \
 taken as they where escaped. |
+| PREGEX_COMP_LAZY | Construct the DFA states lazily while lexing, within \
+a memory-bounded cache. |
+| PREGEX_COMP_UTF8 | Compile the DFA on the bytes of UTF-8 encoded input, \
+so that lexing runs without decoding characters. Malformed UTF-8 never \
+matches. |
 | PREGEX_RUN_WCHAR | Run regular expressions with wchar_t as input. |
 | PREGEX_RUN_NOANCHORS | Ignore anchors while processing the lexer. |
+| PREGEX_RUN_NOTBOL | The input doesn't start at the begin of a line. |
+| PREGEX_RUN_NOTBOW | The input starts behind a word character. |
 | PREGEX_RUN_NOREF | Don't create references. |
 | PREGEX_RUN_NONGREEDY | Force run lexer nongreedy. |
 | PREGEX_RUN_DEBUG | Debug mode; output some debug to stderr. |
@@ -92,12 +99,17 @@ pboolean plex_reset( plex* lex )
 		RETURN( FALSE );
 	}
 
-	/* Drop out the dfatab */
+	/* Drop out the dfatab; The rows of a loaded image belong to the image */
+	lex->image = pregex_image_free( lex->image, &lex->trans_cnt, lex->search );
+
 	for( i = 0; i < lex->trans_cnt; i++ )
 		pfree( lex->trans[ i ] );
 
 	lex->trans_cnt = 0;
 	lex->trans = pfree( lex->trans );
+	lex->dense = pregex_dense_free( lex->dense );
+	lex->search = pregex_search_free( lex->search );
+	lex->lazy = pregex_lazy_free( lex->lazy );
 
 	RETURN( TRUE );
 }
@@ -106,8 +118,15 @@ pboolean plex_reset( plex* lex )
 pboolean plex_prepare( plex* lex )
 {
 	plistel*	e;
+	pregex_ptn*	ptn;
 	pregex_nfa*	nfa;
 	pregex_dfa*	dfa;
+	pregex_dfa*	lit;
+	pregex_dfa*	un;
+	plist*		literals;
+#ifdef UTF8
+	int			cnt;
+#endif
 
 	PROC( "plex_prepare" );
 	PARMS( "lex", "%p", lex );
@@ -126,29 +145,101 @@ pboolean plex_prepare( plex* lex )
 
 	plex_reset( lex );
 
-	/* Create a NFA from patterns */
+	/* Create a NFA from patterns; Literal patterns are collected separately
+		and turned into a trie directly, when no lazy DFA is used. */
 	nfa = pregex_nfa_create();
+	literals = plist_create( 0, PLIST_MOD_PTR );
 
 	plist_for( lex->ptns, e )
-		if( !pregex_ptn_to_nfa( nfa, (pregex_ptn*)plist_access( e ) ) )
+	{
+		ptn = (pregex_ptn*)plist_access( e );
+
+		if( !( lex->flags & PREGEX_COMP_LAZY )
+				&& pregex_ptn_is_literal( ptn ) )
+			plist_push( literals, ptn );
+		else if( !pregex_ptn_to_nfa( nfa, ptn ) )
 		{
+			plist_free( literals );
 			pregex_nfa_free( nfa );
 			RETURN( FALSE );
 		}
+	}
+
+	/* Construct the DFA while lexing */
+	if( lex->flags & PREGEX_COMP_LAZY )
+	{
+		plist_free( literals );
+
+		if( !( lex->lazy = pregex_lazy_create( nfa ) ) )
+		{
+			pregex_nfa_free( nfa );
+			RETURN( FALSE );
+		}
+
+		RETURN( TRUE );
+	}
 
 	/* Create a minimized DFA from NFA */
 	dfa = pregex_dfa_create();
 
-	if( pregex_dfa_from_nfa( dfa, nfa ) <= 0
-			&& pregex_dfa_minimize( dfa ) <= 0 )
+	if( plist_count( nfa->states ) )
 	{
-		pregex_nfa_free( nfa );
-		pregex_dfa_free( dfa );
-		RETURN( FALSE );
+		if( pregex_dfa_from_nfa( dfa, nfa ) <= 0 )
+		{
+			plist_free( literals );
+			pregex_nfa_free( nfa );
+			pregex_dfa_free( dfa );
+			RETURN( FALSE );
+		}
+
+		if( pregex_dfa_minimize( dfa ) <= 0 )
+		{
+			plist_free( literals );
+			pregex_nfa_free( nfa );
+			pregex_dfa_free( dfa );
+			RETURN( FALSE );
+		}
 	}
 
 	pregex_nfa_free( nfa );
 
+	/* Combine with the trie of the literal patterns */
+	if( plist_count( literals ) )
+	{
+		MSG( "Constructing trie from literal patterns" );
+		lit = pregex_dfa_create();
+
+		if( pregex_dfa_from_literals( lit, literals ) <= 0 )
+		{
+			plist_free( literals );
+			pregex_dfa_free( lit );
+			pregex_dfa_free( dfa );
+			RETURN( FALSE );
+		}
+
+		if( plist_count( dfa->states ) )
+		{
+			un = pregex_dfa_create();
+
+			if( pregex_dfa_union( un, dfa, lit ) <= 0 )
+			{
+				plist_free( literals );
+				pregex_dfa_free( un );
+				pregex_dfa_free( lit );
+				pregex_dfa_free( dfa );
+				RETURN( FALSE );
+			}
+
+			pregex_dfa_free( lit );
+			lit = un;
+		}
+
+		pregex_dfa_free( dfa );
+		dfa = lit;
+	}
+
+	plist_free( literals );
+
 	/* Compile significant DFA table into dfatab array */
 	if( ( lex->trans_cnt = pregex_dfa_to_dfatab( &lex->trans, dfa ) ) <= 0 )
 	{
@@ -158,6 +249,24 @@ pboolean plex_prepare( plex* lex )
 
 	pregex_dfa_free( dfa );
 
+#ifdef UTF8
+	/* Rewrite it to run on UTF-8 bytes */
+	if( lex->flags & PREGEX_COMP_UTF8 && !( lex->flags & PREGEX_RUN_WCHAR ) )
+	{
+		if( ( cnt = pregex_dfatab_to_utf8( &lex->trans,
+											lex->trans_cnt ) ) < 0 )
+			RETURN( FALSE );
+
+		lex->trans_cnt = cnt;
+		lex->flags |= PREGEX_RUN_UCHAR;
+	}
+#endif
+
+	/* Compile dense transition table and search machine */
+	lex->dense = pregex_dense_create( lex->trans, lex->trans_cnt );
+	lex->search = pregex_search_create( lex->trans, lex->trans_cnt,
+											lex->flags );
+
 	RETURN( TRUE );
 }
 
@@ -224,6 +333,19 @@ pregex_ptn* plex_define( plex* lex, char* pat, int match_id, int flags )
 }
 
 
+/* Runs the prepared lexer //lex// at //start//, like plex_lex_r() does, but
+with the runtime //flags//, which describe the character in front of //start//
+for the anchors. */
+static int plex_run( plex* lex, char* start, char* stop, char** end,
+						prange* ref, int flags )
+{
+	if( lex->lazy )
+		return pregex_lazy_match( lex->lazy, start, stop, end, ref, flags );
+
+	return pregex_dfatab_match( lex->trans, lex->trans_cnt, lex->dense,
+									start, stop, end, ref, flags );
+}
+
 /** Performs a lexical analysis using the object //lex// on pointer //start//.
 
 If a token can be matched, the function returns the related id of the matching
@@ -235,18 +357,37 @@ next matching pattern.
 */
 int plex_lex( plex* lex, char* start, char** end )
 {
-	int		i;
-	int		state		= 0;
-	int		next_state;
-	char*	match		= (char*)NULL;
-	char*	ptr			= start;
-	wchar_t	ch			= ' ';
-	int		id			= 0;
-
-	PROC( "plex_lex" );
+	return plex_lex_n( lex, start, (char*)NULL, end );
+}
+
+/** Performs a lexical analysis using the object //lex// on pointer //start//,
+on the input that ends at //stop//.
+
+This works like plex_lex(), but the input doesn't need to be zero-terminated,
+and may contain zero-bytes. If //stop// is (char*)NULL, the input is
+zero-terminated.
+*/
+int plex_lex_n( plex* lex, char* start, char* stop, char** end )
+{
+	return plex_lex_r( lex, start, stop, end, lex ? lex->ref : (prange*)NULL );
+}
+
+/** Performs a lexical analysis using the object //lex// on pointer //start//,
+on the input that ends at //stop//, with a per-call reference array.
+
+This works like plex_lex_n(), but the references of the match are stored into
+//ref//, which is an optional array of PREGEX_MAXREF prange items, instead of
+the references of //lex//. This way, a prepared //lex// can be used by several
+threads simultaneously, as long as it isn't compiled with PREGEX_COMP_LAZY.
+*/
+int plex_lex_r( plex* lex, char* start, char* stop, char** end, prange* ref )
+{
+	PROC( "plex_lex_r" );
 	PARMS( "lex", "%p", lex );
-	PARMS( "start", "%s", start );
+	PARMS( "start", "%p", start );
+	PARMS( "stop", "%p", stop );
 	PARMS( "end", "%p", end );
+	PARMS( "ref", "%p", ref );
 
 	if( !( lex && start ) )
 	{
@@ -254,113 +395,10 @@ int plex_lex( plex* lex, char* start, char** end )
 		RETURN( 0 );
 	}
 
-	if( !lex->trans_cnt )
+	if( !lex->trans_cnt && !lex->lazy )
 		plex_prepare( lex );
 
-	memset( lex->ref, 0, PREGEX_MAXREF * sizeof( prange ) );
-
-	while( ch && state >= 0 )
-	{
-		/* State accepts? */
-		if( lex->trans[ state ][ 1 ] )
-		{
-			MSG( "This state accepts the input" );
-			match = ptr;
-			id = lex->trans[ state ][ 1 ];
-
-			if( lex->flags & PREGEX_RUN_NONGREEDY
-				|| lex->trans[ state ][ 2 ] & PREGEX_FLAG_NONGREEDY )
-				break;
-		}
-
-		/* References */
-		if( lex->trans[ state ][ 3 ] )
-		{
-			for( i = 0; i < PREGEX_MAXREF; i++ )
-			{
-				if( lex->trans[ state ][ 3 ] & ( 1 << i ) )
-				{
-					if( !lex->ref[ i ].start )
-						lex->ref[ i ].start = ptr;
-
-					lex->ref[ i ].end = ptr;
-				}
-			}
-		}
-
-		/* Get next character */
-		if( lex->flags & PREGEX_RUN_WCHAR )
-		{
-			VARS( "pstr", "%ls", (wchar_t*)ptr );
-			ch = *( (wchar_t*)ptr );
-			ptr += sizeof( wchar_t );
-		}
-		else
-		{
-			VARS( "pstr", "%s", ptr );
-
-			if( ( lex->flags & PREGEX_RUN_UCHAR ) )
-				ch = (unsigned char)*ptr++;
-			else
-			{
-#ifdef UTF8
-				ch = u8_char( ptr );
-				ptr += u8_seqlen( ptr );
-#else
-				ch = *ptr++;
-#endif
-			}
-		}
-
-		/* Initialize default transition */
-		next_state = lex->trans[ state ][ 4 ];
-
-		/* Find transition according to current character */
-		for( i = 5; i < lex->trans[ state ][ 0 ]; i += 3 )
-		{
-			if( lex->trans[ state ][ i ] <= ch
-					&& lex->trans[ state ][ i + 1 ] >= ch )
-			{
-				next_state = lex->trans[ state ][ i + 2 ];
-				break;
-			}
-		}
-
-		if( next_state == lex->trans_cnt )
-			break;
-
-		if( lex->flags & PREGEX_RUN_DEBUG )
-		{
-			if( lex->flags & PREGEX_RUN_WCHAR )
-				fprintf( stderr,
-					"state %d, wchar_t %d (>%lc<), next state %d\n",
-						state, ch, ch, next_state );
-			else
-				fprintf( stderr,
-					"state %d, char %d (>%c<), next state %d\n",
-						state, ch, ch, next_state );
-		}
-
-		state = next_state;
-	}
-
-	if( match )
-	{
-		if( end )
-			*end = match;
-
-		/*
-		for( i = 0; i < PREGEX_MAXREF; i++ )
-			if( lex->ref[ i ].start )
-				fprintf( stderr, "%2d: >%.*s<\n",
-					i, lex->ref[ i ].end - lex->ref[ i ].start,
-						lex->ref[ i ].start );
-		*/
-
-		RETURN( id );
-	}
-
-	RETURN( 0 );
+	RETURN( plex_run( lex, start, stop, end, ref, lex->flags ) );
 }
 
 /** Performs lexical analysis using //lex// from begin of pointer //start//, to
@@ -377,64 +415,153 @@ can be omitted by providing NULL-pointers.
 The function returns (char*)NULL in case that there is no match.
 */
 char* plex_next( plex* lex, char* start, unsigned int* id, char** end )
+{
+	return plex_next_n( lex, start, (char*)NULL, id, end );
+}
+
+/** Performs lexical analysis using //lex// from begin of pointer //start//, to
+the next matching token, within the input that ends at //stop//.
+
+This works like plex_next(), but the input doesn't need to be zero-terminated,
+and may contain zero-bytes. If //stop// is (char*)NULL, the input is
+zero-terminated.
+*/
+char* plex_next_n( plex* lex, char* start, char* stop,
+					unsigned int* id, char** end )
+{
+	return plex_next_r( lex, start, stop, id, end,
+							lex ? lex->ref : (prange*)NULL );
+}
+
+/** Performs lexical analysis using //lex// from begin of pointer //start//, to
+the next matching token, within the input that ends at //stop//, with a
+per-call reference array.
+
+This works like plex_next_n(), but the references of the match are stored into
+//ref//, which is an optional array of PREGEX_MAXREF prange items. See
+plex_lex_r() for details.
+*/
+char* plex_next_r( plex* lex, char* start, char* stop,
+					unsigned int* id, char** end, prange* ref )
+{
+	return plex_next_in( lex, start, start, stop, id, end, ref );
+}
+
+/** Performs lexical analysis using //lex// from pointer //start//, to the next
+matching token, where //start// lies within the input that begins at //begin//
+and ends at //stop//.
+
+This works like plex_next_r(), but the anchors of the patterns are checked
+against the input in front of //start//, which is read back to //begin//. See
+pregex_find_in() for details.
+
+Empty matches are skipped, so that a tokenizer always advances.
+*/
+char* plex_next_in( plex* lex, char* begin, char* start, char* stop,
+					unsigned int* id, char** end, prange* ref )
+{
+	return plex_next_before( lex, begin, start, (char*)NULL, stop,
+								id, end, ref );
+}
+
+/** Performs lexical analysis using //lex// from pointer //start//, to the next
+matching token beginning in front of //limit//, where //start// lies within the
+input that begins at //begin// and ends at //stop//.
+
+This works like plex_next_in(), but no token beginning at //limit// or behind
+is searched for. The token found may still end behind //limit//. See
+pregex_find_before() for details.
+*/
+char* plex_next_before( plex* lex, char* begin, char* start, char* limit,
+						char* stop, unsigned int* id, char** end, prange* ref )
 {
 	wchar_t		ch;
 	char*		ptr 	= start;
 	char*		lptr;
-	int			i;
+	char*		mend;
 	int			mid;
+	int			skip	= 0;
 
-	PROC( "plex_next" );
+	PROC( "plex_next_before" );
 	PARMS( "lex", "%p", lex );
-	PARMS( "start", "%s", start );
+	PARMS( "begin", "%p", begin );
+	PARMS( "start", "%p", start );
+	PARMS( "limit", "%p", limit );
+	PARMS( "stop", "%p", stop );
 	PARMS( "end", "%p", end );
+	PARMS( "ref", "%p", ref );
 
-	if( !( lex && start ) )
+	if( !( lex && begin && start && start >= begin ) )
 	{
 		WRONGPARAM;
 		RETURN( (char*)NULL );
 	}
 
-	if( !lex->trans_cnt )
+	if( !lex->trans_cnt && !lex->lazy )
 		plex_prepare( lex );
 
-	do
+	while( TRUE )
 	{
 		lptr = ptr;
 
+		if( limit && lptr >= limit )
+			break;
+
 		/* Get next character */
-		if( lex->flags & PREGEX_RUN_WCHAR )
+		if( !pregex_getchar( &ptr, stop, &ch, lex->flags ) )
+			break;
+
+		/* Check for a transition according to current character */
+		if( lex->lazy ? pregex_lazy_first( lex->lazy, ch )
+				: pregex_dfatab_next( lex->trans, lex->trans_cnt,
+										lex->dense, 0, ch )
+											< lex->trans_cnt )
 		{
-			ch = *( (wchar_t*)ptr );
-			ptr += sizeof( wchar_t );
+			if( ( mid = plex_run( lex, lptr, stop, &mend, ref,
+									pregex_anchor_at( begin, lptr,
+														lex->flags ) ) )
+					&& mend > lptr )
+			{
+				if( id )
+					*id = mid;
+				if( end )
+					*end = mend;
+
+				RETURN( lptr );
+			}
+
+			/* Don't retry the DFA at every position behind a failed run */
+			skip = PREGEX_SEARCH_MINSKIP;
 		}
 		else
+			skip++;
+
+		/* Skip the input that doesn't match using the search machine, which
+			finds the next token in a single pass */
+		if( skip >= PREGEX_SEARCH_MINSKIP && lex->search
+				&& !( ( lex->flags ^ lex->search->flags )
+						& PREGEX_RUN_NONGREEDY ) )
 		{
-#ifdef UTF8
-			ch = u8_char( ptr );
-			ptr += u8_seqlen( ptr );
-#else
-			ch = *ptr++;
-#endif
-		}
+			if( pregex_search_find( lex->search, ptr, stop, limit, &lptr,
+									pregex_anchor_at( begin, ptr,
+														lex->flags ) )
+					&& !( limit && lptr >= limit )
+					&& ( mid = plex_run( lex, lptr, stop, &mend, ref,
+											pregex_anchor_at( begin, lptr,
+															lex->flags ) ) )
+					&& mend > lptr )
+			{
+				if( id )
+					*id = mid;
+				if( end )
+					*end = mend;
 
-		if( !ch )
-			break;
+				RETURN( lptr );
+			}
 
-		/* Find a transition according to current character */
-		for( i = 5; i < lex->trans[ 0 ][ 0 ]; i += 3 )
-			if( ( ( lex->trans[ 0 ][ 4 ] < lex->trans_cnt )
-					|| ( lex->trans[ 0 ][ i ] <= ch
-							&& lex->trans[ 0 ][ i + 1 ] >= ch ) )
-					&& ( mid = plex_lex( lex, lptr, end ) ) )
-					{
-						if( id )
-							*id = mid;
-
-						RETURN( lptr );
-					}
+			break;
+		}
 	}
-	while( ch );
 
 	RETURN( (char*)NULL );
 }
@@ -450,13 +577,28 @@ items of size prange. It returns the total number of matches.
 */
 size_t plex_tokenize( plex* lex, char* start, parray** matches )
 {
+	return plex_tokenize_n( lex, start, (char*)NULL, matches );
+}
+
+/** Tokenizes the input beginning at //start// and ending at //stop// using the
+lexical analyzer //lex//.
+
+This works like plex_tokenize(), but the input doesn't need to be
+zero-terminated, and may contain zero-bytes. If //stop// is (char*)NULL, the
+input is zero-terminated.
+*/
+size_t plex_tokenize_n( plex* lex, char* start, char* stop, parray** matches )
+{
+	char*			begin	= start;
 	char*			end;
 	unsigned int	id;
+	size_t			count	= 0;
 	prange*	r;
 
-	PROC( "plex_tokenize" );
+	PROC( "plex_tokenize_n" );
 	PARMS( "lex", "%p", lex );
-	PARMS( "start", "%s", start );
+	PARMS( "start", "%p", start );
+	PARMS( "stop", "%p", stop );
 	PARMS( "matches", "%p", matches );
 
 	if( !( lex && start ) )
@@ -468,9 +610,10 @@ size_t plex_tokenize( plex* lex, char* start, parray** matches )
 	if( matches )
 		*matches = (parray*)NULL;
 
-	while( start && *start )
+	while( start && ( stop ? start < stop : *start ) )
 	{
-		if( !( start = plex_next( lex, start, &id, &end ) ) )
+		if( !( start = plex_next_in( lex, begin, start, stop, &id, &end,
+										lex->ref ) ) )
 			break;
 
 		if( matches )
@@ -485,7 +628,346 @@ size_t plex_tokenize( plex* lex, char* start, parray** matches )
 		}
 
 		start = end;
+		count++;
 	}
 
-	RETURN( *matches ? parray_count( *matches ) : 0 );
+	RETURN( count );
+}
+
+/** Initializes the match iterator //iter// to tokenize the input from //start//
+to //stop// with the lexical analyzer //lex//, or zero-terminated input when
+//stop// is (char*)NULL.
+
+The iterator allocates nothing, and may be placed on the stack. The tokens are
+then obtained one by one with plex_iter_next(). See pregex_iter_init() for
+details.
+
+Returns TRUE on success, FALSE on wrong parameters.
+*/
+pboolean plex_iter_init( pregex_iter* iter, plex* lex, char* start, char* stop )
+{
+	PROC( "plex_iter_init" );
+	PARMS( "iter", "%p", iter );
+	PARMS( "lex", "%p", lex );
+	PARMS( "start", "%p", start );
+	PARMS( "stop", "%p", stop );
+
+	if( !( iter && lex && start ) )
+	{
+		WRONGPARAM;
+		RETURN( FALSE );
+	}
+
+	memset( iter, 0, sizeof( pregex_iter ) );
+	iter->lex = lex;
+	iter->begin = iter->ptr = start;
+	iter->stop = stop;
+
+	RETURN( TRUE );
+}
+
+/** Finds the next token of the iterator //iter//, which was initialized by
+plex_iter_init(), and stores it with its match ID into //match//.
+
+The tokens are the same as those returned by plex_tokenize_n().
+
+Returns TRUE if a token was found, and FALSE when there are no more tokens.
+*/
+pboolean plex_iter_next( pregex_iter* iter, prange* match )
+{
+	unsigned int	id;
+	char*			start;
+	char*			end;
+
+	if( !( iter && iter->lex && match ) )
+	{
+		WRONGPARAM;
+		return FALSE;
+	}
+
+	if( !( iter->ptr && ( iter->stop ? iter->ptr < iter->stop : *iter->ptr ) )
+			|| !( start = plex_next_in( iter->lex, iter->begin, iter->ptr,
+										iter->stop, &id, &end, iter->ref ) ) )
+	{
+		iter->ptr = (char*)NULL;
+		return FALSE;
+	}
+
+	match->id = id;
+	match->start = start;
+	match->end = iter->ptr = end;
+
+	return TRUE;
+}
+
+/** Generates a direct-coded C scanner from the lexical analyzer //lex// into
+the file //f//.
+
+The scanner is generated as the function
+
+``int name( char* start, char** end, char** ref )``
+
+which matches the input at //start// like plex_lex() does, and returns the
+match ID or 0. //end// receives the end of the match. //ref// is optional, and
+must provide 2 * PREGEX_MAXREF pointers receiving begin and end of every
+reference.
+
+Every DFA state is generated as a label, with its accepting ID and reference
+flags as constants. Short character-ranges are switched, so that the compiler
+can make jump tables from them, and longer ranges are compared. The generated
+code has no dependency to this library.
+
+//name// is the name of the function, and prefix of its helpers. The
+generated code doesn't check anchors, so lexers with anchored patterns are
+only generated when PREGEX_RUN_NOANCHORS is set.
+
+Returns TRUE on success, FALSE if the lexer can't be prepared, uses
+PREGEX_COMP_LAZY or has anchored patterns.
+*/
+pboolean plex_to_c( plex* lex, FILE* f, char* name )
+{
+	wchar_t*	row;
+	char*		used;
+	char*		done;
+	pboolean	refs	= FALSE;
+	pboolean	cases;
+	int			cols	= 0;
+	int			state;
+	int			i;
+	int			j;
+	int			k;
+	wchar_t		ch;
+
+	PROC( "plex_to_c" );
+	PARMS( "lex", "%p", lex );
+	PARMS( "f", "%p", f );
+	PARMS( "name", "%s", name );
+
+	if( !( lex && f && name && *name ) )
+	{
+		WRONGPARAM;
+		RETURN( FALSE );
+	}
+
+	if( !lex->trans_cnt && !lex->lazy && !plex_prepare( lex ) )
+		RETURN( FALSE );
+
+	if( lex->lazy )
+	{
+		MSG( "Lazy DFAs can't be generated" );
+		RETURN( FALSE );
+	}
+
+	if( !( lex->flags & PREGEX_RUN_NOANCHORS ) )
+	{
+		for( state = 0; state < lex->trans_cnt; state++ )
+		{
+			if( lex->trans[ state ][ 2 ] & PREGEX_FLAG_ANCHORS )
+			{
+				MSG( "Anchors can't be generated" );
+				RETURN( FALSE );
+			}
+		}
+	}
+
+	/* Find referenced states, to generate only labels in use, and the
+		maximum number of columns */
+	used = (char*)pmalloc( ( lex->trans_cnt + 1 ) * sizeof( char ) );
+
+	for( state = 0; state < lex->trans_cnt; state++ )
+	{
+		row = lex->trans[ state ];
+
+		if( row[ 3 ] )
+			refs = TRUE;
+
+		if( row[ 0 ] > cols )
+			cols = row[ 0 ];
+
+		used[ row[ 4 ] ] = 1;
+
+		for( i = 5; i < row[ 0 ]; i += 3 )
+			used[ row[ i + 2 ] ] = 1;
+	}
+
+	fprintf( f, "/* Direct-coded scanner with %d states, "
+					"generated by plex_to_c() */\n\n", lex->trans_cnt );
+
+	/* Input decoding */
+	if( lex->flags & PREGEX_RUN_WCHAR )
+		fprintf( f, "#include <stddef.h>\n\n" );
+#ifdef UTF8
+	else if( !( lex->flags & PREGEX_RUN_UCHAR ) )
+		fprintf( f, "/* Reads the next UTF-8 character from *ptr, like u8_char() "
+				"does */\n"
+			"static long %s_utf8( char** ptr )\n"
+			"{\n"
+			"\tstatic const long\toffs[]\t= { 0x0L, 0x3080L, 0xE2080L, "
+				"0x3C82080L };\n"
+			"\tunsigned char*\t\tp\t\t= (unsigned char*)*ptr;\n"
+			"\tlong\t\t\t\tch\t\t= *p++;\n"
+			"\tint\t\t\t\t\tn;\n"
+			"\tint\t\t\t\t\ti;\n"
+			"\n"
+			"\tif( ch >= 0xF8 )\n"
+			"\t{\n"
+			"\t\tn = ch >= 0xFC ? 5 : 4;\n"
+			"\t\tch = ch >= 0xFC ? %ldL : %ldL;\n"
+			"\t}\n"
+			"\telse\n"
+			"\t{\n"
+			"\t\tn = ch >= 0xF0 ? 3 : ch >= 0xE0 ? 2 : ch >= 0xC0 ? 1 : 0;\n"
+			"\n"
+			"\t\tfor( i = 0; i < n; i++ )\n"
+			"\t\t\tch = ( ch << 6 ) + ( *p ? *p++ : 0 );\n"
+			"\n"
+			"\t\tch -= offs[ n ];\n"
+			"\t\tn = 0;\n"
+			"\t}\n"
+			"\n"
+			"\twhile( n-- && *p )\n"
+			"\t\tp++;\n"
+			"\n"
+			"\t*ptr = (char*)p;\n"
+			"\treturn ch;\n"
+			"}\n\n", name,
+				(long)u8_char( "\xFC" ), (long)u8_char( "\xF8" ) );
+#endif
+
+	fprintf( f, "int %s( char* start, char** end, char** ref )\n"
+		"{\n"
+		"\tchar*\tptr\t\t= start;\n"
+		"\tchar*\tmatch\t= (char*)0;\n"
+		"\tint\t\tid\t\t= 0;\n"
+		"\tlong\tch;\n", name );
+
+	if( refs )
+		fprintf( f, "\tint\t\ti;\n"
+			"\n"
+			"\tif( ref )\n"
+			"\t\tfor( i = 0; i < %d; i++ )\n"
+			"\t\t\tref[ i ] = (char*)0;\n", PREGEX_MAXREF * 2 );
+
+	done = (char*)pmalloc( cols * sizeof( char ) );
+
+	for( state = 0; state < lex->trans_cnt; state++ )
+	{
+		row = lex->trans[ state ];
+
+		fprintf( f, "\n" );
+
+		if( used[ state ] )
+			fprintf( f, "state%d:\n", state );
+
+		/* Accepting ID */
+		if( row[ 1 ] )
+		{
+			fprintf( f, "\tmatch = ptr;\n\tid = %d;\n", row[ 1 ] );
+
+			if( lex->flags & PREGEX_RUN_NONGREEDY
+					|| row[ 2 ] & PREGEX_FLAG_NONGREEDY )
+			{
+				fprintf( f, "\tgoto done;\n" );
+				continue;
+			}
+		}
+
+		/* Reference flags */
+		if( row[ 3 ] )
+		{
+			fprintf( f, "\n\tif( ref )\n\t{\n" );
+
+			for( i = 0; i < PREGEX_MAXREF; i++ )
+				if( row[ 3 ] & ( 1 << i ) )
+					fprintf( f, "\t\tif( !ref[ %d ] )\n"
+								"\t\t\tref[ %d ] = ptr;\n"
+								"\n"
+								"\t\tref[ %d ] = ptr;\n",
+									i * 2, i * 2, i * 2 + 1 );
+
+			fprintf( f, "\t}\n\n" );
+		}
+
+		/* Next character */
+		if( lex->flags & PREGEX_RUN_WCHAR )
+			fprintf( f, "\tch = *( (wchar_t*)ptr );\n"
+						"\tptr += sizeof( wchar_t );\n" );
+		else if( lex->flags & PREGEX_RUN_UCHAR )
+			fprintf( f, "\tch = *( (unsigned char*)ptr++ );\n" );
+		else
+#ifdef UTF8
+			fprintf( f, "\tch = %s_utf8( &ptr );\n", name );
+#else
+			fprintf( f, "\tch = *ptr++;\n" );
+#endif
+
+		fprintf( f, "\n\tif( !ch )\n\t\tgoto done;\n\n" );
+
+		/* Short ranges, grouped by goto-state */
+		memset( done, 0, row[ 0 ] * sizeof( char ) );
+		cases = FALSE;
+
+		for( i = 5; i < row[ 0 ]; i += 3 )
+		{
+			if( done[ i ] || row[ i + 1 ] - row[ i ] > 16 )
+				continue;
+
+			if( !cases )
+			{
+				fprintf( f, "\tswitch( ch )\n\t{\n" );
+				cases = TRUE;
+			}
+
+			for( j = i; j < row[ 0 ]; j += 3 )
+			{
+				if( done[ j ] || row[ j + 2 ] != row[ i + 2 ]
+						|| row[ j + 1 ] - row[ j ] > 16 )
+					continue;
+
+				for( ch = row[ j ]; ch <= row[ j + 1 ]; ch++ )
+				{
+					if( ch < 128 && isprint( ch ) && ch != '\''
+							&& ch != '\\' )
+						fprintf( f, "\t\tcase '%c':\n", (char)ch );
+					else
+						fprintf( f, "\t\tcase %d:\n", ch );
+				}
+
+				done[ j ] = 1;
+			}
+
+			fprintf( f, "\t\t\tgoto state%d;\n\n", row[ i + 2 ] );
+		}
+
+		if( cases )
+			fprintf( f, "\t\tdefault:\n\t\t\tbreak;\n\t}\n\n" );
+
+		/* Long ranges */
+		for( k = 5; k < row[ 0 ]; k += 3 )
+		{
+			if( done[ k ] )
+				continue;
+
+			fprintf( f, "\tif( ch >= %d && ch <= %d )\n\t\tgoto state%d;\n\n",
+						row[ k ], row[ k + 1 ], row[ k + 2 ] );
+		}
+
+		/* Default transition */
+		if( row[ 4 ] < lex->trans_cnt )
+			fprintf( f, "\tgoto state%d;\n", row[ 4 ] );
+		else
+			fprintf( f, "\tgoto done;\n" );
+	}
+
+	fprintf( f, "\ndone:\n"
+				"\tif( match && end )\n"
+				"\t\t*end = match;\n"
+				"\n"
+				"\treturn match ? id : 0;\n"
+				"}\n" );
+
+	pfree( used );
+	pfree( done );
+
+	RETURN( TRUE );
 }
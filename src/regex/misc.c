@@ -15,8 +15,7 @@ Usage:	Internal utility and miscelleanous functions for additional usage that
 /*NO_DOC*/
 /* No documentation for the entire module, all here is only interally used. */
 
-/** Performs an anchor checking within a string. It is used by the internal
-matching functions for NFA and DFA state machines.
+/** Performs an anchor checking within a string.
 
 //all// is the entire string. This can be equal to //str//, but is required to
 perform valid line-begin anchor checking. If //all// is (char*)NULL, //str//
@@ -27,120 +26,343 @@ is assumed to be //all//.
 //flags// is the flags configuration, e. g. for wide-character enabled anchor
 checking.
 
+This function is deprecated, as the matchers check the anchors themselves. It
+is kept for existing callers, and uses pregex_anchor_test().
+
 Returns TRUE, if all anchors flagged as //anchors// match, else FALSE.
 */
 pboolean pregex_check_anchors( char* all, char* str, size_t len,
 										int anchors, int flags )
 {
-	wchar_t	ch;
-	int		charsize = sizeof( char );
+	if( flags & PREGEX_RUN_NOANCHORS )
+		return TRUE;
 
-	PROC( "pregex_check_anchors" );
-	if( flags & PREGEX_RUN_WCHAR )
+	if( !( str || len ) )
+		return FALSE;
+
+	if( !all )
+		all = str;
+
+	return pregex_anchor_test( anchors,
+				pregex_anchor_before( all, str, flags ),
+				pregex_anchor_after( str + len * ( flags & PREGEX_RUN_WCHAR
+													? sizeof( wchar_t ) : 1 ),
+										(char*)NULL, flags ) );
+}
+
+/** Returns the anchor class of the character //ch//.
+
+Line breaks are of class PREGEX_ANCHOR_LINE, the alphanumeric characters of
+iswalnum() and the underscore of class PREGEX_ANCHOR_WORD, and all other
+characters of class PREGEX_ANCHOR_OTHER. Characters beyond PCCL_MAX, which
+aren't covered by the character-classes, are of class PREGEX_ANCHOR_OTHER. */
+int pregex_anchor_class( wchar_t ch )
+{
+	if( ch == '\n' || ch == '\r' )
+		return PREGEX_ANCHOR_LINE;
+
+#ifdef UNICODE
+	if( ch == '_' || ( ch <= PCCL_MAX && iswalnum( ch ) ) )
+#else
+	if( ch == '_' || ( ch <= PCCL_MAX && isalnum( ch ) ) )
+#endif
+		return PREGEX_ANCHOR_WORD;
+
+	return PREGEX_ANCHOR_OTHER;
+}
+
+/** Checks for word characters beyond 0xFF up to PCCL_MAX, which are found in
+Unicode locales.
+
+The search machine distinguishes word characters up to 0xFF only, and is not
+used for word anchors when this function returns TRUE. */
+pboolean pregex_anchor_wide( void )
+{
+	wchar_t		ch;
+
+	for( ch = 0x100; ch < PCCL_MAX; ch++ )
+		if( pregex_anchor_class( ch ) == PREGEX_ANCHOR_WORD )
+			return TRUE;
+
+	return pregex_anchor_class( PCCL_MAX ) == PREGEX_ANCHOR_WORD;
+}
+
+/* Checks whether the input is read as UTF-8 sequences according to the
+runtime //flags//, although it is matched on bytes with PREGEX_COMP_UTF8. */
+#define pregex_anchor_utf8( flags ) \
+	( !( (flags) & PREGEX_RUN_WCHAR ) \
+		&& ( !( (flags) & PREGEX_RUN_UCHAR ) || (flags) & PREGEX_COMP_UTF8 ) )
+
+/** Returns the anchor class of the character in front of //ptr//, within the
+input that begins at //begin//, and is processed according to the runtime
+//flags//.
+
+In front of //begin//, the class is taken from the runtime flags
+PREGEX_RUN_NOTBOL and PREGEX_RUN_NOTBOW, and is PREGEX_ANCHOR_LINE when none of
+them is set. UTF-8 sequences are read back to their first byte; a sequence
+that is malformed or begins in front of //begin// is of class
+PREGEX_ANCHOR_OTHER. */
+int pregex_anchor_before( char* begin, char* ptr, int flags )
+{
+#ifdef UTF8
+	char*	seq;
+#endif
+
+	if( ptr <= begin )
 	{
-		PARMS( "all", "%ls", all );
-		PARMS( "str", "%ls", str );
+		if( flags & PREGEX_RUN_NOTBOW )
+			return PREGEX_ANCHOR_WORD;
+
+		return flags & PREGEX_RUN_NOTBOL ? PREGEX_ANCHOR_OTHER
+											: PREGEX_ANCHOR_LINE;
 	}
-	else
+
+	if( flags & PREGEX_RUN_WCHAR )
+		return pregex_anchor_class( ( (wchar_t*)ptr )[ -1 ] );
+
+#ifdef UTF8
+	if( pregex_anchor_utf8( flags ) && ptr[ -1 ] & 0x80 )
 	{
-		PARMS( "all", "%s", all );
-		PARMS( "str", "%s", str );
+		for( seq = ptr - 1; seq > begin && ( *seq & 0xC0 ) == 0x80
+								&& ptr - seq < 4; seq-- )
+			;
+
+		if( ( *seq & 0xC0 ) == 0x80 || seq + u8_seqlen( seq ) != ptr )
+			return PREGEX_ANCHOR_OTHER;
+
+		return pregex_anchor_class( u8_char( seq ) );
 	}
-	PARMS( "anchors", "%d", anchors );
-	PARMS( "flags", "%d", flags );
+#endif
 
-	/* Perform anchor checkings? */
-	if( flags & PREGEX_RUN_NOANCHORS )
+	return pregex_anchor_class( (unsigned char)ptr[ -1 ] );
+}
+
+/** Returns the anchor class of the character at //ptr//, within the input
+that ends at //stop//, or is zero-terminated when //stop// is (char*)NULL.
+The input is processed according to the runtime //flags//.
+
+The end of the input is of class PREGEX_ANCHOR_LINE. */
+int pregex_anchor_after( char* ptr, char* stop, int flags )
+{
+	wchar_t		ch;
+
+	/* Read UTF-8 sequences as characters, even when matching on bytes */
+	if( pregex_anchor_utf8( flags ) )
+		flags &= ~PREGEX_RUN_UCHAR;
+
+	if( !pregex_getchar( &ptr, stop, &ch, flags ) )
+		return PREGEX_ANCHOR_LINE;
+
+	return pregex_anchor_class( ch );
+}
+
+/** Returns the runtime flags PREGEX_RUN_NOTBOL and PREGEX_RUN_NOTBOW, which
+describe a character of anchor class //cls// in front of the input. */
+int pregex_anchor_flags( int cls )
+{
+	if( cls == PREGEX_ANCHOR_WORD )
+		return PREGEX_RUN_NOTBOL | PREGEX_RUN_NOTBOW;
+	else if( cls == PREGEX_ANCHOR_OTHER )
+		return PREGEX_RUN_NOTBOL;
+
+	return 0;
+}
+
+/** Returns the runtime //flags// for a matcher started at //ptr//, within the
+input that begins at //begin//. The flags PREGEX_RUN_NOTBOL and
+PREGEX_RUN_NOTBOW are set according to the character in front of //ptr//, or
+kept from //flags// when //ptr// is //begin//. */
+int pregex_anchor_at( char* begin, char* ptr, int flags )
+{
+	if( ptr <= begin )
+		return flags;
+
+	return ( flags & ~( PREGEX_RUN_NOTBOL | PREGEX_RUN_NOTBOW ) )
+			| pregex_anchor_flags( pregex_anchor_before( begin, ptr, flags ) );
+}
+
+/** Tests the //anchors// (PREGEX_FLAG_BOL, PREGEX_FLAG_EOL, PREGEX_FLAG_BOW
+and PREGEX_FLAG_EOW) of an accepting state for a match, which begins behind a
+character of anchor class //prev//, and ends in front of a character of anchor
+class //next//.
+
+Returns TRUE, if all anchors hold, else FALSE.
+*/
+pboolean pregex_anchor_test( int anchors, int prev, int next )
+{
+	if( anchors & PREGEX_FLAG_BOL && prev != PREGEX_ANCHOR_LINE )
+		return FALSE;
+
+	if( anchors & PREGEX_FLAG_BOW && prev == PREGEX_ANCHOR_WORD )
+		return FALSE;
+
+	if( anchors & PREGEX_FLAG_EOL && next != PREGEX_ANCHOR_LINE )
+		return FALSE;
+
+	if( anchors & PREGEX_FLAG_EOW && next == PREGEX_ANCHOR_WORD )
+		return FALSE;
+
+	return TRUE;
+}
+
+/** Checks the //anchors// of an accepting state, that is reached by a matcher
+at //ptr//. The matcher was started according to the runtime //flags//, which
+describe the character in front of its start, on the input that ends at
+//stop//.
+
+This is used by the matchers when they reach an accepting state, so that a
+match is only taken when its anchors hold. All anchors hold with
+PREGEX_RUN_NOANCHORS.
+
+Returns TRUE, if the state accepts at //ptr//, else FALSE.
+*/
+pboolean pregex_anchor_accept( int anchors, char* ptr, char* stop, int flags )
+{
+	if( !( anchors & PREGEX_FLAG_ANCHORS ) || flags & PREGEX_RUN_NOANCHORS )
+		return TRUE;
+
+	return pregex_anchor_test( anchors, pregex_anchor_before( ptr, ptr, flags ),
+								anchors & ( PREGEX_FLAG_EOL | PREGEX_FLAG_EOW )
+									? pregex_anchor_after( ptr, stop, flags )
+									: PREGEX_ANCHOR_LINE );
+}
+
+/** Adds the accepting id //accept// with its matching //flags// to an
+accepting state, whose first pattern is held by //st_accept// and //st_flags//,
+and all further patterns by //fallback//.
+
+A state accepting several patterns takes the lowest accepting id whose anchors
+hold. The patterns are therefore kept ordered by their accepting id, and a
+pattern without anchors is kept in front of anchored ones with the same id.
+Patterns behind a pattern without anchors never accept, and are dropped.
+//fallback// is (int*)NULL when there are no further patterns, else it holds
+their count, followed by pairs of accepting id and flags. */
+void pregex_accept_add( unsigned int* st_accept, int* st_flags,
+							int** fallback, unsigned int accept, int flags )
+{
+	int*	pat;
+	int		cnt;
+	int		i;
+
+	if( !accept )
+		return;
+
+	/* All patterns as pairs, with room for the new one */
+	cnt = *st_accept ? 1 + ( *fallback ? **fallback : 0 ) : 0;
+	pat = (int*)pmalloc( ( cnt + 1 ) * 2 * sizeof( int ) );
+
+	if( cnt )
 	{
-		MSG( "Anchor checking is disabled through flags, or not required" );
-		RETURN( TRUE );
+		pat[ 0 ] = (int)*st_accept;
+		pat[ 1 ] = *st_flags;
+
+		if( cnt > 1 )
+			memcpy( pat + 2, *fallback + 1, ( cnt - 1 ) * 2 * sizeof( int ) );
 	}
 
-	/* Check parameter integrity */
-	if( !( str || len ) )
+	for( i = 0; i < cnt; i++ )
 	{
-		MSG( "Not enough or wrong parameters!" );
-		RETURN( FALSE );
+		if( (unsigned int)pat[ i * 2 ] == accept && pat[ i * 2 + 1 ] == flags )
+			break;
+
+		if( (unsigned int)pat[ i * 2 ] > accept
+				|| ( (unsigned int)pat[ i * 2 ] == accept
+						&& !( flags & PREGEX_FLAG_ANCHORS )
+						&& pat[ i * 2 + 1 ] & PREGEX_FLAG_ANCHORS ) )
+		{
+			memmove( pat + i * 2 + 2, pat + i * 2,
+						( cnt - i ) * 2 * sizeof( int ) );
+			cnt++;
+			break;
+		}
 	}
 
-	if( !all )
-		all = str;
+	if( i == cnt )
+		cnt++;
 
-	if( flags & PREGEX_RUN_WCHAR )
-		charsize = sizeof( wchar_t );
+	pat[ i * 2 ] = (int)accept;
+	pat[ i * 2 + 1 ] = flags;
+
+	/* Drop the patterns behind the first one without anchors */
+	for( i = 0; i < cnt - 1; i++ )
+		if( !( pat[ i * 2 + 1 ] & PREGEX_FLAG_ANCHORS ) )
+			cnt = i + 1;
+
+	*st_accept = (unsigned int)pat[ 0 ];
+	*st_flags = pat[ 1 ];
+	*fallback = pfree( *fallback );
 
-	/* Begin of line anchor */
-	if( anchors & PREGEX_FLAG_BOL )
+	if( cnt > 1 )
 	{
-		MSG( "Begin of line anchor is set" );
-		if( all < str )
-		{
-			if( flags & PREGEX_RUN_WCHAR )
-			{
-				VARS( "str-1", "%ls", (wchar_t*)( str - 1 ) );
-				ch = *( (wchar_t*)( str - 1 ) );
-			}
-			else
-			{
-				VARS( "str-1", "%s", str-1 );
-				ch = *( str - 1 );
-			}
-
-			VARS( "ch", "%lc", ch );
-			if( ch != '\n' && ch != '\r' )
-				RETURN( FALSE );
-		}
+		*fallback = (int*)pmalloc( ( 1 + ( cnt - 1 ) * 2 ) * sizeof( int ) );
+		**fallback = cnt - 1;
+		memcpy( *fallback + 1, pat + 2, ( cnt - 1 ) * 2 * sizeof( int ) );
 	}
 
-	/* End of Line anchor */
-	if( anchors & PREGEX_FLAG_EOL )
+	pfree( pat );
+}
+
+/** Returns the accepting id of the pattern //i// of an accepting state, as
+it is held by //st_accept//, //st_flags// and //fallback// according to
+pregex_accept_add(), and its flags into //flags//.
+
+Returns 0 if there is no such pattern. */
+unsigned int pregex_accept_nth( unsigned int st_accept, int st_flags,
+									int* fallback, int i, int* flags )
+{
+	if( !i )
 	{
-		MSG( "End of line anchor is set" );
-		if( ( ch = *( str + ( len * charsize ) ) ) )
-		{
-			VARS( "ch", "%lc", ch );
-			if( ch != '\n' && ch != '\r' )
-				RETURN( FALSE );
-		}
+		*flags = st_flags;
+		return st_accept;
 	}
 
-	/* Begin of word anchor */
-	if( anchors & PREGEX_FLAG_BOW )
+	if( !fallback || i > *fallback )
+		return 0;
+
+	*flags = fallback[ i * 2 ];
+	return (unsigned int)fallback[ i * 2 - 1 ];
+}
+
+/** Reads the next character from //ptr// according to the runtime //flags//
+into //ch//, and moves //ptr// behind it.
+
+//stop// is the end of the input. If //stop// is (char*)NULL, the input is
+zero-terminated, else zero characters are read like any other character, and
+a multi-byte sequence cut by //stop// is read as a single byte.
+
+Returns FALSE at the end of the input.
+*/
+pboolean pregex_getchar( char** ptr, char* stop, wchar_t* ch, int flags )
+{
+	if( stop && *ptr >= stop )
+		return FALSE;
+
+	if( flags & PREGEX_RUN_WCHAR )
 	{
-		MSG( "Begin of word anchor is set" );
-		if( all < str )
-		{
-			if( flags & PREGEX_RUN_WCHAR )
-			{
-				VARS( "str-1", "%ls", (wchar_t*)( str - 1 ) );
-				ch = *( (wchar_t*)( str - 1 ) );
-			}
-			else
-			{
-				VARS( "str-1", "%s", str-1 );
-				ch = *( str - 1 );
-			}
-
-			VARS( "ch", "%lc", ch );
-			if( iswalnum( ch ) || ch == '_' )
-				RETURN( FALSE );
-		}
-	}
+		if( stop && *ptr + sizeof( wchar_t ) > stop )
+			return FALSE;
 
-	/* End of word anchor */
-	if( anchors & PREGEX_FLAG_EOW )
+		*ch = *( (wchar_t*)*ptr );
+		*ptr += sizeof( wchar_t );
+	}
+	else if( flags & PREGEX_RUN_UCHAR )
+		*ch = (unsigned char)*( *ptr )++;
+	else
 	{
-		MSG( "End of word anchor is set" );
-		if( ( ch = *( str + ( len * charsize ) ) ) )
+#ifdef UTF8
+		if( stop && *ptr + u8_seqlen( *ptr ) > stop )
+			*ch = (unsigned char)*( *ptr )++;
+		else
 		{
-			VARS( "ch", "%lc", ch );
-			if( iswalnum( ch ) || ch == '_' )
-				RETURN( FALSE );
+			*ch = u8_char( *ptr );
+			*ptr += u8_seqlen( *ptr );
 		}
+#else
+		*ch = *( *ptr )++;
+#endif
 	}
 
-	MSG( "All anchor tests where fine!" );
-	RETURN( TRUE );
+	return stop || *ch;
 }
 
 /*COD_ON*/
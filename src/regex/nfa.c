@@ -35,8 +35,9 @@ pregex_nfa_st* pregex_nfa_create_state(
 	PARMS( "nfa", "%p", nfa );
 	PARMS( "chardef", "%s", chardef ? chardef : "NULL" );
 
-	/* Get new element */
+	/* Get new element; This invalidates the index */
 	ptr = plist_malloc( nfa->states );
+	nfa->cnt = 0;
 
 	/* Define character edge? */
 	if( chardef )
@@ -193,6 +194,8 @@ pboolean pregex_nfa_reset( pregex_nfa* nfa )
 		plist_remove( nfa->states, plist_first( nfa->states ) );
 	}
 
+	nfa->cnt = 0;
+
 	RETURN( TRUE );
 }
 
@@ -216,81 +219,134 @@ pregex_nfa* pregex_nfa_free( pregex_nfa* nfa )
 
 	MSG( "Dropping memory" );
 	plist_free( nfa->states );
+	pfree( nfa->index );
 	pfree( nfa );
 
 	RETURN( (pregex_nfa*)NULL );
 }
 
+/** Numbers the states of //nfa// with dense ids, in the order of the state
+list. The state with id 0 is the initial state.
+
+The index is kept until the NFA is modified, so calling this function on an
+already indexed NFA is cheap.
+
+Returns the number of indexed states.
+*/
+int pregex_nfa_index( pregex_nfa* nfa )
+{
+	plistel*		e;
+	int				i;
+
+	if( !nfa )
+	{
+		WRONGPARAM;
+		return 0;
+	}
+
+	if( nfa->cnt )
+		return nfa->cnt;
+
+	nfa->index = (pregex_nfa_st**)prealloc( nfa->index,
+						plist_count( nfa->states ) * sizeof( pregex_nfa_st* ) );
+
+	for( e = plist_first( nfa->states ), i = 0; e; e = plist_next( e ), i++ )
+	{
+		nfa->index[ i ] = (pregex_nfa_st*)plist_access( e );
+		nfa->index[ i ]->id = i;
+	}
+
+	return nfa->cnt = i;
+}
+
+/** Creates a sparse set for up to //max// NFA state ids.
+
+The set must be released with pregex_nfa_set_free(). */
+pregex_nfa_set* pregex_nfa_set_create( int max )
+{
+	pregex_nfa_set*	set;
+
+	set = (pregex_nfa_set*)pmalloc( sizeof( pregex_nfa_set ) );
+	set->dense = (int*)pmalloc( ( max + 1 ) * sizeof( int ) );
+	set->sparse = (int*)pmalloc( ( max + 1 ) * sizeof( int ) );
+
+	return set;
+}
+
+/** Frees the sparse set //set//.
+
+Always returns (pregex_nfa_set*)NULL. */
+pregex_nfa_set* pregex_nfa_set_free( pregex_nfa_set* set )
+{
+	if( !set )
+		return (pregex_nfa_set*)NULL;
+
+	pfree( set->dense );
+	pfree( set->sparse );
+	pfree( set );
+
+	return (pregex_nfa_set*)NULL;
+}
+
 /** Performs a move operation on a given input character from a set of NFA
 states.
 
-//nfa// is the state machine.
-//hits// must be the pointer to an inizialized list of pointers to
-pregex_nfa_st* that both contains the input seed for the move operation and
-also receives all states that can be reached on the given
-character-range. States from the input configuration will be removed, states
-from the move operation will be inserted.
+//nfa// is the state machine, which must be indexed by pregex_nfa_index().
+//result// is the sparse set receiving all states that can be reached on the
+given character-range. It is cleared before.
+//ids// is the array of //cnt// NFA state ids to move from.
 //from// is the character-range begin from which the move-operation should be
 processed on.
 //to// is the character-range end until the move-operation should be processed.
 
 Returns the number of elements in //result//, or -1 on error.
 */
-int pregex_nfa_move( pregex_nfa* nfa, plist* hits, wchar_t from, wchar_t to )
+int pregex_nfa_move( pregex_nfa* nfa, pregex_nfa_set* result,
+						int* ids, int cnt, wchar_t from, wchar_t to )
 {
-	plistel*		first;
-	plistel*		end;
 	pregex_nfa_st*	st;
+	int				i;
 
 	PROC( "pregex_nfa_move" );
 	PARMS( "nfa", "%p", nfa );
-	PARMS( "hits", "%p", hits );
+	PARMS( "result", "%p", result );
+	PARMS( "ids", "%p", ids );
+	PARMS( "cnt", "%d", cnt );
 	PARMS( "from", "%d", from );
 	PARMS( "to", "%d", to );
 
-	if( !( nfa && hits ) )
+	if( !( nfa && result && ( ids || !cnt ) ) )
 	{
 		WRONGPARAM;
 		RETURN( -1 );
 	}
 
-	if( !( end = plist_last( hits ) ) )
-	{
-		MSG( "Nothing to do, hits is empty" );
-		RETURN( 0 );
-	}
+	result->cnt = 0;
 
 	/* Loop through the input items */
-	do
+	for( i = 0; i < cnt; i++ )
 	{
-		first = plist_first( hits );
-		st = (pregex_nfa_st*)plist_access( first );
+		st = nfa->index[ ids[ i ] ];
 		VARS( "st", "%p", st );
 
-		/* Not an epsilon edge? */
-		if( st->ccl )
+		/* Not an epsilon edge? Fine, test for range! */
+		if( st->ccl && p_ccl_testrange( st->ccl, from, to )
+				&& !pregex_nfa_set_has( result, st->next->id ) )
 		{
-			/* Fine, test for range! */
-			if( p_ccl_testrange( st->ccl, from, to ) )
-			{
-				MSG( "State matches range!" );
-				plist_push( hits, st->next );
-			}
+			MSG( "State matches range!" );
+			pregex_nfa_set_add( result, st->next->id );
 		}
-
-		plist_remove( hits, first );
 	}
-	while( first != end );
 
-	VARS( "plist_count( hits )", "%d", plist_count( hits ) );
-	RETURN( plist_count( hits ) );
+	VARS( "result->cnt", "%d", result->cnt );
+	RETURN( result->cnt );
 }
 
 /** Performs an epsilon closure from a set of NFA states.
 
-//nfa// is the NFA state machine
-//closure// is a list of input NFA states, which will be extended on the closure
-after the function returned.
+//nfa// is the NFA state machine, which must be indexed by pregex_nfa_index().
+//closure// is the sparse set of input NFA states, which will be extended on
+the closure after the function returned.
 //accept// is the return pointer which receives possible information about a
 pattern match. This parameter is optional, and can be left empty by providing
 (unsigned int*)NULL.
@@ -298,16 +354,16 @@ pattern match. This parameter is optional, and can be left empty by providing
 pattern match. This parameter is optional, and can be left empty by providing
 (int*)NULL.
 
-Returns a number of elements in //input//.
+Returns a number of elements in //closure//.
 */
-int pregex_nfa_epsilon_closure( pregex_nfa* nfa, plist* closure,
+int pregex_nfa_epsilon_closure( pregex_nfa* nfa, pregex_nfa_set* closure,
 									unsigned int* accept, int* flags )
 {
 	pregex_nfa_st*	top;
 	pregex_nfa_st*	next;
 	pregex_nfa_st*	last_accept	= (pregex_nfa_st*)NULL;
-	plist*			stack;
-	short			i;
+	int				i;
+	short			j;
 
 	PROC( "pregex_nfa_epsilon_closure" );
 	PARMS( "nfa", "%p", nfa );
@@ -325,11 +381,11 @@ int pregex_nfa_epsilon_closure( pregex_nfa* nfa, plist* closure,
 	if( flags )
 		*flags = 0;
 
-	stack = plist_dup( closure );
-
-	/* Loop through the items */
-	while( plist_pop( stack, &top ) )
+	/* Loop through the items; New items are appended and visited later */
+	for( i = 0; i < closure->cnt; i++ )
 	{
+		top = nfa->index[ closure->dense[ i ] ];
+
 		if( accept && top->accept
 				&& ( !last_accept
 					|| last_accept->accept > top->accept ) )
@@ -337,14 +393,11 @@ int pregex_nfa_epsilon_closure( pregex_nfa* nfa, plist* closure,
 
 		if( !top->ccl )
 		{
-			for( i = 0; i < 2; i++ )
+			for( j = 0; j < 2; j++ )
 			{
-				next = ( !i ? top->next : top->next2 );
-				if( next && !plist_get_by_ptr( closure, next ) )
-				{
-					plist_push( closure, next );
-					plist_push( stack, next );
-				}
+				next = ( !j ? top->next : top->next2 );
+				if( next && !pregex_nfa_set_has( closure, next->id ) )
+					pregex_nfa_set_add( closure, next->id );
 			}
 		}
 		else if( top->next2 )
@@ -357,8 +410,6 @@ int pregex_nfa_epsilon_closure( pregex_nfa* nfa, plist* closure,
 		}
 	}
 
-	stack = plist_free( stack );
-
 	if( accept && last_accept )
 	{
 		*accept = last_accept->accept;
@@ -371,8 +422,8 @@ int pregex_nfa_epsilon_closure( pregex_nfa* nfa, plist* closure,
 		VARS( "*flags", "%d", *flags );
 	}
 
-	VARS( "Closed states", "%d", plist_count( closure ) );
-	RETURN( plist_count( closure ) );
+	VARS( "Closed states", "%d", closure->cnt );
+	RETURN( closure->cnt );
 }
 
 /* !!!OBSOLETE!!! */
@@ -405,7 +456,9 @@ relating to a pattern in //nfa//.
 int pregex_nfa_match( pregex_nfa* nfa, char* str, size_t* len, int* mflags,
 		prange** ref, int* ref_count, int flags )
 {
-	plist*			res;
+	pregex_nfa_set*	res;
+	pregex_nfa_set*	prev;
+	pregex_nfa_set*	swap;
 	char*			pstr		= str;
 	int				plen		= 0;
 	int				last_accept = 0;
@@ -442,11 +495,16 @@ int pregex_nfa_match( pregex_nfa* nfa, char* str, size_t* len, int* mflags,
 	if( mflags )
 		*mflags = PREGEX_FLAG_NONE;
 
-	res = plist_create( 0, PLIST_MOD_PTR | PLIST_MOD_RECYCLE );
-	plist_push( res, plist_access( plist_first( nfa->states ) ) );
+	if( !pregex_nfa_index( nfa ) )
+		RETURN( 0 );
+
+	res = pregex_nfa_set_create( nfa->cnt );
+	prev = pregex_nfa_set_create( nfa->cnt );
+
+	pregex_nfa_set_add( res, 0 );
 
 	/* Run the engine! */
-	while( plist_count( res ) )
+	while( res->cnt )
 	{
 		MSG( "Performing epsilon closure" );
 		if( pregex_nfa_epsilon_closure( nfa, res, &accept, &aflags ) < 0 )
@@ -539,7 +597,12 @@ int pregex_nfa_match( pregex_nfa* nfa, char* str, size_t* len, int* mflags,
 		VARS( "ch", "%d", ch );
 		VARS( "ch", "%lc", ch );
 
-		if( pregex_nfa_move( nfa, res, ch, ch ) < 0 )
+		/* Swap the sets, the previous one is reused as work buffer */
+		swap = prev;
+		prev = res;
+		res = swap;
+
+		if( pregex_nfa_move( nfa, res, prev->dense, prev->cnt, ch, ch ) < 0 )
 		{
 			MSG( "pregex_nfa_move() failed" );
 			break;
@@ -549,7 +612,8 @@ int pregex_nfa_match( pregex_nfa* nfa, char* str, size_t* len, int* mflags,
 		VARS( "plen", "%ld", plen );
 	}
 
-	plist_free( res );
+	pregex_nfa_set_free( res );
+	pregex_nfa_set_free( prev );
 
 	VARS( "*len", "%d", *len );
 	VARS( "last_accept", "%d", last_accept );
@@ -0,0 +1,549 @@
+/* -MODULE----------------------------------------------------------------------
+Phorward Foundation Toolkit
+Copyright (C) 2006-2018 by Phorward Software Technologies, Jan Max Meyer
+http://www.phorward-software.com ++ contact<at>phorward<dash>software<dot>com
+All rights reserved. See LICENSE for more information.
+
+File:	parallel.c
+Author:	Jan Max Meyer
+Usage:	Parallel matching of pregex- and plex-objects on chunks of large
+		input, and on batches of records.
+----------------------------------------------------------------------------- */
+
+#include "phorward.h"
+
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+/* Input chunk scanned by one worker */
+typedef struct
+{
+	pregex*			regex;		/* Regular expression, or NULL */
+	plex*			lex;		/* Lexical analyzer, or NULL */
+
+	char*			input;		/* Begin of the input */
+	char*			begin;		/* Begin of the chunk */
+	char*			end;		/* End of the chunk */
+	char*			stop;		/* End of the input */
+
+	parray*			matches;	/* Matches beginning within the chunk */
+	int				next;		/* Next match to be merged */
+} pregex_chunk;
+
+/* Records matched by one worker */
+typedef struct
+{
+	pregex*			regex;		/* Regular expression, or NULL */
+	plex*			lex;		/* Lexical analyzer, or NULL */
+
+	prange*			records;	/* Records to be matched */
+	prange*			results;	/* Results of the records */
+	size_t			count;		/* Number of records */
+	size_t			matches;	/* Number of matching records */
+} pregex_batch;
+
+/* Finds the next match of the chunk's regex or lexer from //ptr//, which
+begins within the chunk. The match may end behind the chunk. */
+static char* pregex_chunk_next( pregex_chunk* chunk, char* ptr,
+									unsigned int* id, char** end )
+{
+	if( chunk->lex )
+		return plex_next_before( chunk->lex, chunk->input, ptr, chunk->end,
+									chunk->stop, id, end, (prange*)NULL );
+
+	*id = 1;
+	return pregex_find_before( chunk->regex, chunk->input, ptr, chunk->end,
+								chunk->stop, end, (prange*)NULL );
+}
+
+/* Collects all matches beginning within //chunk//, as they are found when
+matching is started at the chunk's begin. */
+static void* pregex_chunk_run( void* arg )
+{
+	pregex_chunk*	chunk	= (pregex_chunk*)arg;
+	char*			ptr		= chunk->begin;
+	char*			start;
+	char*			end;
+	unsigned int	id;
+	prange*			r;
+
+	while( ( start = pregex_chunk_next( chunk, ptr, &id, &end ) ) )
+	{
+		r = (prange*)parray_malloc( chunk->matches );
+		r->id = id;
+		r->start = start;
+		r->end = end;
+
+		ptr = end;
+	}
+
+	return NULL;
+}
+
+/* Appends the match //id//, //start//, //end// to //matches//, if provided. */
+static void pregex_chunk_append( parray** matches,
+									unsigned int id, char* start, char* end )
+{
+	prange*		r;
+
+	if( !matches )
+		return;
+
+	if( !*matches )
+		*matches = parray_create( sizeof( prange ), 0 );
+
+	r = (prange*)parray_malloc( *matches );
+	r->id = id;
+	r->start = start;
+	r->end = end;
+}
+
+/* Merges the matches of //cnt// scanned //chunks// in order, as they are
+found by sequential matching from the begin of the first chunk.
+
+Matching from a position only depends on that position, and on the input
+in front of it for the anchors, which is read back to the input's begin. A
+chunk's matches are therefore taken over as soon as the merged position lies
+between the end of a chunk's match (or the chunk's begin) and the begin of its
+next match. When the merged position lies within a chunk's match instead, which
+happens behind a match that exceeds its chunk, matching continues sequentially
+until both resynchronize. As matches are only searched for in front of the
+chunk's end, there is no further match within a chunk when none is found, and
+merging continues with the next chunk. */
+static size_t pregex_chunk_merge( pregex_chunk* chunks, int cnt,
+									parray** matches )
+{
+	pregex_chunk*	chunk;
+	prange*			r;
+	char*			ptr		= chunks->begin;
+	char*			prev;
+	char*			start;
+	char*			end;
+	unsigned int	id;
+	size_t			count	= 0;
+	int				k		= 0;
+
+	while( TRUE )
+	{
+		while( k + 1 < cnt && ptr >= chunks[ k + 1 ].begin )
+			k++;
+
+		chunk = &chunks[ k ];
+
+		while( ( r = (prange*)parray_get( chunk->matches, chunk->next ) )
+					&& r->start < ptr )
+			chunk->next++;
+
+		prev = chunk->next ? ( (prange*)parray_get(
+						chunk->matches, chunk->next - 1 ) )->end : chunk->begin;
+
+		if( ptr >= prev )
+		{
+			/* Synchronized, take over the chunk's matches */
+			for( ; ( r = (prange*)parray_get( chunk->matches, chunk->next ) );
+					chunk->next++, count++ )
+			{
+				pregex_chunk_append( matches, r->id, r->start, r->end );
+				ptr = r->end;
+			}
+
+			/* The last match exceeds the chunk */
+			if( ptr > chunk->end )
+				continue;
+
+			if( k + 1 == cnt )
+				break;
+
+			ptr = chunks[ k + 1 ].begin;
+			continue;
+		}
+
+		/* Not synchronized, match sequentially */
+		if( !( start = pregex_chunk_next( chunk, ptr, &id, &end ) ) )
+		{
+			if( k + 1 == cnt )
+				break;
+
+			ptr = chunks[ k + 1 ].begin;
+			continue;
+		}
+
+		pregex_chunk_append( matches, id, start, end );
+		count++;
+
+		ptr = end;
+	}
+
+	return count;
+}
+
+/* Returns the number of worker threads to be used for //threads//, which is
+the number of online processors if //threads// is 0 or less. */
+static int pregex_parallel_threads( int threads )
+{
+	if( threads > 0 )
+		return threads;
+
+#ifndef _WIN32
+	return (int)sysconf( _SC_NPROCESSORS_ONLN );
+#else
+	return 1;
+#endif
+}
+
+/* Runs //fn// on each of the //cnt// jobs of //size// bytes at //jobs//, with
+one worker thread per job. The first job is run by the calling thread, and so
+is any job whose thread can't be started.
+
+The threads are started and joined on every call, instead of being kept in a
+pool. Starting a thread takes some ten microseconds, which is small against
+the work of a job: chunks are at least PREGEX_PARALLEL_MINCHUNK bytes, and
+batches at least PREGEX_PARALLEL_MINRECORDS records. */
+static void pregex_parallel_run( void* (*fn)( void* ), void* jobs, size_t size,
+									int cnt )
+{
+	int				i;
+#ifndef _WIN32
+	pthread_t*		tids;
+	pboolean*		started;
+
+	tids = (pthread_t*)pmalloc( cnt * sizeof( pthread_t ) );
+	started = (pboolean*)pmalloc( cnt * sizeof( pboolean ) );
+
+	for( i = 1; i < cnt; i++ )
+		started[ i ] = !pthread_create( &tids[ i ], (pthread_attr_t*)NULL,
+											fn, (char*)jobs + i * size );
+
+	fn( jobs );
+
+	for( i = 1; i < cnt; i++ )
+	{
+		if( started[ i ] )
+			pthread_join( tids[ i ], (void**)NULL );
+		else
+			fn( (char*)jobs + i * size );
+	}
+
+	pfree( tids );
+	pfree( started );
+#else
+	for( i = 0; i < cnt; i++ )
+		fn( (char*)jobs + i * size );
+#endif
+}
+
+/* Runs the chunk-parallel matching for either //regex// or //lex// on the
+input from //start// to //stop//, with at most //threads// workers. */
+static size_t pregex_parallel( pregex* regex, plex* lex,
+								char* start, char* stop, parray** matches,
+									int threads )
+{
+	pregex_chunk*	chunks;
+	char*			last;
+	char*			ptr;
+	size_t			len;
+	size_t			count;
+	int				flags;
+	int				cnt;
+	int				i;
+
+	flags = regex ? regex->flags : lex->flags;
+
+	if( !( last = stop ) )
+	{
+		if( flags & PREGEX_RUN_WCHAR )
+			last = (char*)( (wchar_t*)start + wcslen( (wchar_t*)start ) );
+		else
+			last = start + strlen( start );
+	}
+
+	len = last > start ? last - start : 0;
+	threads = pregex_parallel_threads( threads );
+
+	if( ( cnt = (int)( len / PREGEX_PARALLEL_MINCHUNK ) ) > threads )
+		cnt = threads;
+
+	if( matches )
+		*matches = (parray*)NULL;
+
+	/* Not worth it, or the lazy DFA's state cache can't be shared */
+	if( cnt < 2 || ( regex ? regex->lazy : lex->lazy ) )
+	{
+		if( regex )
+			return pregex_findall_n( regex, start, stop, matches );
+
+		return plex_tokenize_n( lex, start, stop, matches );
+	}
+
+	chunks = (pregex_chunk*)pmalloc( cnt * sizeof( pregex_chunk ) );
+
+	for( ptr = start, i = 0; i < cnt; i++ )
+	{
+		chunks[ i ].regex = regex;
+		chunks[ i ].lex = lex;
+		chunks[ i ].input = start;
+		chunks[ i ].stop = last;
+		chunks[ i ].matches = parray_create( sizeof( prange ), 0 );
+		chunks[ i ].begin = ptr;
+
+		if( i + 1 == cnt )
+			ptr = last;
+		else
+		{
+			ptr = start + len / cnt * ( i + 1 );
+
+			/* Chunks must begin at a character */
+			if( flags & PREGEX_RUN_WCHAR )
+				ptr -= ( ptr - start ) % sizeof( wchar_t );
+#ifdef UTF8
+			else if( !( flags & PREGEX_RUN_UCHAR )
+						|| flags & PREGEX_COMP_UTF8 )
+				while( ptr < last && ( *ptr & 0xC0 ) == 0x80 )
+					ptr++;
+#endif
+		}
+
+		chunks[ i ].end = ptr;
+	}
+
+	pregex_parallel_run( pregex_chunk_run, chunks, sizeof( pregex_chunk ),
+							cnt );
+
+	count = pregex_chunk_merge( chunks, cnt, matches );
+
+	for( i = 0; i < cnt; i++ )
+		parray_free( chunks[ i ].matches );
+
+	pfree( chunks );
+	return count;
+}
+
+/* Matches all records of //batch//. */
+static void* pregex_batch_run( void* arg )
+{
+	pregex_batch*	batch	= (pregex_batch*)arg;
+	char*			start;
+	char*			stop;
+	char*			end;
+	unsigned int	id;
+	size_t			i;
+
+	for( i = 0; i < batch->count; i++ )
+	{
+		start = batch->records[ i ].start;
+		stop = batch->records[ i ].end;
+		end = (char*)NULL;
+
+		if( batch->lex )
+			id = plex_lex_r( batch->lex, start, stop, &end, (prange*)NULL );
+		else
+			id = pregex_match_r( batch->regex, start, stop, &end,
+									(prange*)NULL );
+
+		batch->results[ i ].id = id;
+		batch->results[ i ].start = start;
+		batch->results[ i ].end = id ? end : (char*)NULL;
+
+		if( id )
+			batch->matches++;
+	}
+
+	return NULL;
+}
+
+/* Runs the batch matching for either //regex// or //lex// on //count//
+//records// into //results//, with at most //threads// workers. */
+static size_t pregex_batch_parallel( pregex* regex, plex* lex,
+										prange* records, size_t count,
+											prange* results, int threads )
+{
+	pregex_batch*	batches;
+	size_t			matches		= 0;
+	size_t			size;
+	int				cnt;
+	int				i;
+
+	threads = pregex_parallel_threads( threads );
+
+	if( ( cnt = (int)( ( count + PREGEX_PARALLEL_MINRECORDS - 1 )
+							/ PREGEX_PARALLEL_MINRECORDS ) ) > threads )
+		cnt = threads;
+
+	/* The lazy DFA's state cache can't be shared */
+	if( cnt < 1 || ( regex ? regex->lazy : lex->lazy ) )
+		cnt = 1;
+
+	batches = (pregex_batch*)pmalloc( cnt * sizeof( pregex_batch ) );
+	size = ( count + cnt - 1 ) / cnt;
+
+	for( i = 0; i < cnt; i++ )
+	{
+		batches[ i ].regex = regex;
+		batches[ i ].lex = lex;
+		batches[ i ].records = records + i * size;
+		batches[ i ].results = results + i * size;
+
+		if( i * size < count )
+			batches[ i ].count = count - i * size < size
+									? count - i * size : size;
+	}
+
+	pregex_parallel_run( pregex_batch_run, batches, sizeof( pregex_batch ),
+							cnt );
+
+	for( i = 0; i < cnt; i++ )
+		matches += batches[ i ].matches;
+
+	pfree( batches );
+	return matches;
+}
+
+/** Find all matches for the regular expression //regex// from begin of pointer
+//start//, by scanning chunks of the input in parallel.
+
+The input is split into at most //threads// chunks, which are scanned
+simultaneously by worker threads. If //threads// is 0 or less, the number of
+online processors is used. Chunks are at least PREGEX_PARALLEL_MINCHUNK bytes
+long, so small input is scanned by the calling thread only. The matches found
+in the chunks are merged in order, and resynchronized where a match exceeds its
+chunk, so the result is equal to pregex_findall_n(). A chunk only searches
+for matches beginning within it, and only its last match may be read on behind
+its end.
+
+The worker threads are started on every call. This costs some ten
+microseconds per thread, so many small inputs are better matched with
+pregex_findall_n(), or as records with pregex_match_batch().
+
+//stop// is the end of the input, or (char*)NULL if the input is
+zero-terminated. UTF-8 input must be valid, to be split at character borders.
+Regular expressions compiled with PREGEX_COMP_LAZY are run sequentially, as
+the state cache of their lazy DFA can't be shared.
+
+The function fills the array //matches//, if provided, with items of size
+prange. It returns the total number of matches.
+*/
+int pregex_findall_parallel( pregex* regex, char* start, char* stop,
+								parray** matches, int threads )
+{
+	PROC( "pregex_findall_parallel" );
+	PARMS( "regex", "%p", regex );
+	PARMS( "start", "%p", start );
+	PARMS( "stop", "%p", stop );
+	PARMS( "matches", "%p", matches );
+	PARMS( "threads", "%d", threads );
+
+	if( !( regex && start ) )
+	{
+		WRONGPARAM;
+		RETURN( -1 );
+	}
+
+	RETURN( (int)pregex_parallel( regex, (plex*)NULL,
+									start, stop, matches, threads ) );
+}
+
+/** Tokenizes the input beginning at //start// using the lexical analyzer
+//lex//, by scanning chunks of the input in parallel.
+
+This works like pregex_findall_parallel(), but tokenizes the input like
+plex_tokenize_n() does. //stop// is the end of the input, or (char*)NULL if
+the input is zero-terminated. //threads// is the maximum number of worker
+threads, or 0 for the number of online processors.
+
+The function initializes and fills the array //matches//, if provided, with
+items of size prange. It returns the total number of matches.
+*/
+size_t plex_tokenize_parallel( plex* lex, char* start, char* stop,
+								parray** matches, int threads )
+{
+	PROC( "plex_tokenize_parallel" );
+	PARMS( "lex", "%p", lex );
+	PARMS( "start", "%p", start );
+	PARMS( "stop", "%p", stop );
+	PARMS( "matches", "%p", matches );
+	PARMS( "threads", "%d", threads );
+
+	if( !( lex && start ) )
+	{
+		WRONGPARAM;
+		RETURN( 0 );
+	}
+
+	if( !lex->trans_cnt && !lex->lazy && !plex_prepare( lex ) )
+		RETURN( 0 );
+
+	RETURN( pregex_parallel( (pregex*)NULL, lex,
+								start, stop, matches, threads ) );
+}
+
+/** Matches the regular expression //regex// against a batch of records, which
+are matched by several threads simultaneously.
+
+//records// is an array of //count// prange items, where //start// and //end//
+delimit each record. //end// can be (char*)NULL for a zero-terminated record.
+Every record is matched like pregex_match_n() does, and the result is written
+to the same item of the array //results//, which must provide //count// prange
+items, and may be //records// itself. An item's //id// is 1 on a match, else 0.
+Its //start// is the begin of the record, and its //end// the end of the
+match, or (char*)NULL.
+
+The records are distributed to at most //threads// worker threads, or to one
+thread per online processor if //threads// is 0 or less. Workers get at least
+PREGEX_PARALLEL_MINRECORDS records each. All workers share the compiled
+//regex//, and match with pregex_match_r(). Regular expressions compiled with
+PREGEX_COMP_LAZY are matched by the calling thread only.
+
+The function returns the number of matching records.
+*/
+size_t pregex_match_batch( pregex* regex, prange* records, size_t count,
+							prange* results, int threads )
+{
+	PROC( "pregex_match_batch" );
+	PARMS( "regex", "%p", regex );
+	PARMS( "records", "%p", records );
+	PARMS( "count", "%ld", count );
+	PARMS( "results", "%p", results );
+	PARMS( "threads", "%d", threads );
+
+	if( !( regex && ( records || !count ) && ( results || !count ) ) )
+	{
+		WRONGPARAM;
+		RETURN( 0 );
+	}
+
+	RETURN( pregex_batch_parallel( regex, (plex*)NULL,
+									records, count, results, threads ) );
+}
+
+/** Runs the lexical analyzer //lex// on a batch of records, which are
+analyzed by several threads simultaneously.
+
+This works like pregex_match_batch(), but every record is matched like
+plex_lex_n() does. The //id// of each item in //results// is the id of the
+token matched at the begin of the record, or 0.
+
+The function returns the number of records where a token was matched.
+*/
+size_t plex_lex_batch( plex* lex, prange* records, size_t count,
+						prange* results, int threads )
+{
+	PROC( "plex_lex_batch" );
+	PARMS( "lex", "%p", lex );
+	PARMS( "records", "%p", records );
+	PARMS( "count", "%ld", count );
+	PARMS( "results", "%p", results );
+	PARMS( "threads", "%d", threads );
+
+	if( !( lex && ( records || !count ) && ( results || !count ) ) )
+	{
+		WRONGPARAM;
+		RETURN( 0 );
+	}
+
+	if( !lex->trans_cnt && !lex->lazy && !plex_prepare( lex ) )
+		RETURN( 0 );
+
+	RETURN( pregex_batch_parallel( (pregex*)NULL, lex,
+									records, count, results, threads ) );
+}
@@ -383,6 +383,77 @@ pregex_ptn* pregex_ptn_dup( pregex_ptn* ptn )
 	RETURN( start );
 }
 
+/** Duplicate pattern //ptn// into a reversed copy, which matches all strings
+of //ptn// read from right to left.
+
+The sequences are turned around on every level of the pattern. The accepting
+id and the flags of //ptn// stay at the first element of the reversed
+sequence, where begin- and end-anchors are swapped.
+
+The reversed pattern can be compiled into a reverse automaton with
+pregex_ptn_to_dfatab(), which is run backwards over the input to find where a
+match of //ptn// begins, when its end is known.
+
+Returns the reversed pattern, which must be released using pregex_ptn_free().
+*/
+pregex_ptn* pregex_ptn_reverse( pregex_ptn* ptn )
+{
+	pregex_ptn*		rev		= (pregex_ptn*)NULL;
+	pregex_ptn*		last	= (pregex_ptn*)NULL;
+	pregex_ptn*		dup;
+	unsigned int	accept;
+	int				flags;
+
+	PROC( "pregex_ptn_reverse" );
+	PARMS( "ptn", "%p", ptn );
+
+	for( ; ptn; ptn = ptn->next )
+	{
+		dup = pregex_ptn_create( ptn->type );
+
+		if( ptn->type == PREGEX_PTN_CHAR )
+			dup->ccl = p_ccl_dup( ptn->ccl );
+
+		if( ptn->child[0] )
+			dup->child[0] = pregex_ptn_reverse( ptn->child[0] );
+
+		if( ptn->child[1] )
+			dup->child[1] = pregex_ptn_reverse( ptn->child[1] );
+
+		dup->accept = ptn->accept;
+		dup->flags = ptn->flags;
+
+		if( !last )
+			last = dup;
+
+		dup->next = rev;
+		rev = dup;
+	}
+
+	if( rev )
+	{
+		accept = last->accept;
+		flags = last->flags;
+
+		last->accept = rev->accept;
+		last->flags = rev->flags;
+
+		rev->accept = accept;
+		rev->flags = flags & ~PREGEX_FLAG_ANCHORS;
+
+		if( flags & PREGEX_FLAG_BOL )
+			rev->flags |= PREGEX_FLAG_EOL;
+		if( flags & PREGEX_FLAG_EOL )
+			rev->flags |= PREGEX_FLAG_BOL;
+		if( flags & PREGEX_FLAG_BOW )
+			rev->flags |= PREGEX_FLAG_EOW;
+		if( flags & PREGEX_FLAG_EOW )
+			rev->flags |= PREGEX_FLAG_BOW;
+	}
+
+	RETURN( rev );
+}
+
 /** Releases memory of a pattern including all its subsequent and following
 patterns.
 
@@ -660,6 +731,126 @@ char* pregex_ptn_to_regex( pregex_ptn* ptn )
 	return ptn->str;
 }
 
+/* Internal function for pregex_ptn_to_literals(); Flattens the sequence
+//ptn// into //stream//, where each literal character is a required one, and
+a zero-character breaks the literal. */
+static void pregex_ptn_to_LITERALS( parray* stream, pregex_ptn* ptn )
+{
+	wchar_t		ch;
+
+	for( ; ptn; ptn = ptn->next )
+	{
+		switch( ptn->type )
+		{
+			case PREGEX_PTN_CHAR:
+				if( p_ccl_count( ptn->ccl ) == 1
+						&& p_ccl_get( &ch, (wchar_t*)NULL, ptn->ccl, 0 )
+							&& ch )
+				{
+					parray_push( stream, &ch );
+					continue;
+				}
+				break;
+
+			case PREGEX_PTN_SUB:
+			case PREGEX_PTN_REFSUB:
+				pregex_ptn_to_LITERALS( stream, ptn->child[ 0 ] );
+				continue;
+
+			case PREGEX_PTN_POS:
+				/* The first repetition is required */
+				pregex_ptn_to_LITERALS( stream, ptn->child[ 0 ] );
+				break;
+
+			default:
+				break;
+		}
+
+		ch = 0;
+		parray_push( stream, &ch );
+	}
+}
+
+/** Extracts required literals from the pattern //ptn//.
+
+//prefix// receives a literal string every match of //ptn// must begin with,
+//factor// receives the longest literal string every match of //ptn// must
+contain. Both are returned as allocated wide-character strings, or
+(wchar_t*)NULL if no such literal was found.
+
+These literals can be used to skip input that can't contain any match of
+//ptn//, before the DFA is run.
+
+Returns TRUE if any literal was found, FALSE otherwise.
+*/
+pboolean pregex_ptn_to_literals( pregex_ptn* ptn,
+									wchar_t** prefix, wchar_t** factor )
+{
+	parray*		stream;
+	wchar_t*	str;
+	wchar_t*	start;
+	wchar_t		ch			= 0;
+
+	PROC( "pregex_ptn_to_literals" );
+	PARMS( "ptn", "%p", ptn );
+	PARMS( "prefix", "%p", prefix );
+	PARMS( "factor", "%p", factor );
+
+	if( !( ptn && prefix && factor ) )
+	{
+		WRONGPARAM;
+		RETURN( FALSE );
+	}
+
+	*prefix = *factor = (wchar_t*)NULL;
+
+	stream = parray_create( sizeof( wchar_t ), 0 );
+	pregex_ptn_to_LITERALS( stream, ptn );
+	parray_push( stream, &ch );
+
+	str = (wchar_t*)parray_first( stream );
+
+	/* The first literal is the prefix */
+	if( *str )
+		*prefix = pwcsdup( str );
+
+	/* The longest literal is the factor */
+	for( start = str; start <= (wchar_t*)parray_last( stream );
+			start += wcslen( start ) + 1 )
+	{
+		if( *start && ( !*factor || wcslen( start ) > wcslen( *factor ) ) )
+			*factor = start;
+	}
+
+	if( *factor == str )
+		*factor = (wchar_t*)NULL;
+	else if( *factor )
+		*factor = pwcsdup( *factor );
+
+	parray_free( stream );
+
+	VARS( "*prefix", "%ls", *prefix ? *prefix : L"(null)" );
+	VARS( "*factor", "%ls", *factor ? *factor : L"(null)" );
+
+	RETURN( *prefix || *factor );
+}
+
+/** Checks if the pattern //ptn// is a plain literal, which is a sequence of
+single characters only, as it is constructed with PREGEX_COMP_STATIC.
+
+Returns TRUE if //ptn// is a literal. */
+pboolean pregex_ptn_is_literal( pregex_ptn* ptn )
+{
+	if( !ptn )
+		return FALSE;
+
+	for( ; ptn; ptn = ptn->next )
+		if( ptn->type != PREGEX_PTN_CHAR || p_ccl_count( ptn->ccl ) != 1 )
+			return FALSE;
+
+	return TRUE;
+}
+
 /* Internal function for pregex_ptn_to_nfa() */
 static pboolean pregex_ptn_to_NFA( pregex_nfa* nfa, pregex_ptn* pattern,
 	pregex_nfa_st** start, pregex_nfa_st** end, int* ref_count )
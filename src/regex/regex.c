@@ -11,6 +11,119 @@ Usage:	Interface for pregex-objects serving regular expressions.
 
 #include "phorward.h"
 
+/* Converts the literal //lit// into the input encoding according to the runtime
+//flags//. Returns (char*)NULL if the literal can't be represented. */
+static char* pregex_literal_to_str( wchar_t* lit, int flags )
+{
+	char*	str;
+	char*	ptr;
+#ifdef UTF8
+	int		len;
+#endif
+
+	if( !lit )
+		return (char*)NULL;
+
+	ptr = str = (char*)pmalloc( ( wcslen( lit ) * 6 + 1 ) * sizeof( char ) );
+
+	for( ; *lit; lit++ )
+	{
+		if( flags & PREGEX_RUN_UCHAR )
+		{
+			if( *lit > 0xFF )
+				return (char*)pfree( str );
+
+			*ptr++ = (char)*lit;
+		}
+		else
+		{
+#ifdef UTF8
+			if( !( len = u8_wc_toutf8( ptr, *lit ) ) )
+				return (char*)pfree( str );
+
+			ptr += len;
+#else
+			if( *lit > 0x7F )
+				return (char*)pfree( str );
+
+			*ptr++ = (char)*lit;
+#endif
+		}
+	}
+
+	return str;
+}
+
+/* Finds the literal //lit// in the input //start//, which ends at //stop//, or
+is zero-terminated when //stop// is (char*)NULL. */
+static char* pregex_strstr( char* start, char* stop, char* lit )
+{
+	size_t	len;
+
+	if( !stop )
+	{
+		if( !lit[ 1 ] )
+			return strchr( start, *lit );
+
+		return strstr( start, lit );
+	}
+
+	for( len = strlen( lit ); start + len <= stop
+			&& ( start = (char*)memchr( start, *lit,
+											stop - start - len + 1 ) );
+				start++ )
+		if( !memcmp( start, lit, len ) )
+			return start;
+
+	return (char*)NULL;
+}
+
+/* Returns the end of the input up to //stop//, in which the prefix of //regex//
+is searched for a match beginning in front of //limit//. */
+static char* pregex_prefix_stop( pregex* regex, char* limit, char* stop )
+{
+	size_t	len;
+
+	if( !( limit && stop ) )
+		return stop;
+
+	len = strlen( regex->prefix );
+	return limit + len - 1 < stop ? limit + len - 1 : stop;
+}
+
+/* Skips //start// to the first position where a match of //regex// can begin,
+according to its required literals. //stop// is the end of the input, or
+(char*)NULL, and //limit// the optional position matches must begin in front
+of. Returns (char*)NULL if the input can't contain any match. */
+static char* pregex_prefilter( pregex* regex, char* start, char* limit,
+								char* stop )
+{
+	if( regex->flags & PREGEX_RUN_WCHAR )
+		return start;
+
+	/* A match beginning in front of limit may still end behind it */
+	if( regex->factor && !pregex_strstr( start, stop, regex->factor ) )
+		return (char*)NULL;
+
+	if( regex->prefix )
+		return pregex_strstr( start,
+					pregex_prefix_stop( regex, limit, stop ), regex->prefix );
+
+	return start;
+}
+
+/* Checks if a match of //regex// can begin with character //ch//. */
+static pboolean pregex_first( pregex* regex, wchar_t ch )
+{
+	if( regex->bitnfa )
+		return pregex_bitnfa_first( regex->bitnfa, ch );
+	else if( regex->lazy )
+		return pregex_lazy_first( regex->lazy, ch );
+
+	return pregex_dfatab_next( regex->trans, regex->trans_cnt,
+								regex->dense, 0, ch ) < regex->trans_cnt;
+}
+
 /** Constructor function to create a new pregex object.
 
 //pat// is a string providing a regular expression pattern.
@@ -28,8 +141,17 @@ possible |
 | PREGEX_COMP_STATIC | The regular expression passed should be converted 1:1 as\
 it where a string-constant. Any regex-specific symbols will be ignored and \
 taken as they where escaped. |
+| PREGEX_COMP_LAZY | Construct the DFA states lazily while matching, within \
+a memory-bounded cache. |
+| PREGEX_COMP_BITNFA | Run a bit-parallel NFA instead of compiling a DFA, \
+if the pattern is small enough and no references are required. |
+| PREGEX_COMP_UTF8 | Compile the DFA on the bytes of UTF-8 encoded input, \
+so that matching runs without decoding characters. Malformed UTF-8 never \
+matches. |
 | PREGEX_RUN_WCHAR | Run regular expression with wchar_t as input. |
 | PREGEX_RUN_NOANCHORS | Ignore anchors while processing the regex. |
+| PREGEX_RUN_NOTBOL | The input doesn't start at the begin of a line. |
+| PREGEX_RUN_NOTBOW | The input starts behind a word character. |
 | PREGEX_RUN_NOREF | Don't create references. |
 | PREGEX_RUN_NONGREEDY | Force run regular expression non-greedy. |
 | PREGEX_RUN_DEBUG | Debug mode; output some debug to stderr. |
@@ -42,6 +164,12 @@ pregex* pregex_create( char* pat, int flags )
 {
 	pregex*			regex;
 	pregex_ptn*		ptn;
+	pregex_nfa*		nfa;
+	wchar_t*		prefix;
+	wchar_t*		factor;
+#ifdef UTF8
+	int				cnt;
+#endif
 
 	PROC( "pregex_create" );
 	PARMS( "pat", "%s", pat );
@@ -56,9 +184,67 @@ pregex* pregex_create( char* pat, int flags )
 	regex->ptn = ptn;
 	regex->flags = flags;
 
-	/* Generate a dfatab */
-	if( ( regex->trans_cnt = pregex_ptn_to_dfatab( &regex->trans, ptn ) ) < 0 )
-		RETURN( pregex_free( regex ) );
+	if( flags & PREGEX_COMP_BITNFA
+			&& ( regex->bitnfa = pregex_bitnfa_create( ptn,
+										!( flags & PREGEX_RUN_NOREF ) ) ) )
+		MSG( "Running bit-parallel NFA, no DFA required" );
+	else if( flags & PREGEX_COMP_LAZY )
+	{
+		/* Generate a NFA, the DFA is constructed while matching */
+		nfa = pregex_nfa_create();
+
+		if( !pregex_ptn_to_nfa( nfa, ptn ) )
+		{
+			pregex_nfa_free( nfa );
+			RETURN( pregex_free( regex ) );
+		}
+
+		if( !( regex->lazy = pregex_lazy_create( nfa ) ) )
+		{
+			pregex_nfa_free( nfa );
+			RETURN( pregex_free( regex ) );
+		}
+	}
+	else
+	{
+		/* Generate a dfatab */
+		if( ( regex->trans_cnt = pregex_ptn_to_dfatab(
+										&regex->trans, ptn ) ) < 0 )
+			RETURN( pregex_free( regex ) );
+
+#ifdef UTF8
+		/* Rewrite it to run on UTF-8 bytes */
+		if( flags & PREGEX_COMP_UTF8 && !( flags & PREGEX_RUN_WCHAR ) )
+		{
+			if( ( cnt = pregex_dfatab_to_utf8( &regex->trans,
+												regex->trans_cnt ) ) < 0 )
+				RETURN( pregex_free( regex ) );
+
+			regex->trans_cnt = cnt;
+			regex->flags |= PREGEX_RUN_UCHAR;
+		}
+#endif
+
+		/* Compile dense transition table and search machine */
+		regex->dense = pregex_dense_create( regex->trans, regex->trans_cnt );
+		regex->search = pregex_search_create( regex->trans, regex->trans_cnt,
+												regex->flags );
+
+		if( regex->search )
+			pregex_search_backward( regex->search, regex->trans,
+										regex->trans_cnt );
+	}
+
+	/* Extract required literals, to skip input before running the DFA */
+	if( !( flags & PREGEX_RUN_WCHAR )
+			&& pregex_ptn_to_literals( ptn, &prefix, &factor ) )
+	{
+		regex->prefix = pregex_literal_to_str( prefix, flags );
+		regex->factor = pregex_literal_to_str( factor, flags );
+
+		pfree( prefix );
+		pfree( factor );
+	}
 
 	/* Print dfatab */
 	/* pregex_ptn_to_dfatab( (wchar_t***)NULL, ptn ); */
@@ -85,33 +271,91 @@ pregex* pregex_free( pregex* regex )
 	/* Freeing the pattern definitions */
 	regex->ptn = pregex_ptn_free( regex->ptn );
 
-	/* Drop out the dfatab */
+	/* Drop out the dfatab; The rows of a loaded image belong to the image */
+	regex->image = pregex_image_free( regex->image, &regex->trans_cnt,
+										regex->search );
+
 	for( i = 0; i < regex->trans_cnt; i++ )
 		pfree( regex->trans[ i ] );
 
 	pfree( regex->trans );
+	pregex_dense_free( regex->dense );
+	pregex_search_free( regex->search );
+	pregex_lazy_free( regex->lazy );
+	pregex_bitnfa_free( regex->bitnfa );
+	pfree( regex->prefix );
+	pfree( regex->factor );
 	pfree( regex );
 
 	RETURN( (pregex*)NULL );
 }
 
+/* Runs the matcher of //regex// at //start//, like pregex_match_r() does, but
+with the runtime //flags//, which describe the character in front of //start//
+for the anchors. */
+static pboolean pregex_run( pregex* regex, char* start, char* stop,
+								char** end, prange* ref, int flags )
+{
+	if( regex->bitnfa )
+	{
+		if( ref )
+			memset( ref, 0, PREGEX_MAXREF * sizeof( prange ) );
+
+		return pregex_bitnfa_match( regex->bitnfa, start, stop, end, flags )
+				? TRUE : FALSE;
+	}
+	else if( regex->lazy )
+		return pregex_lazy_match( regex->lazy, start, stop, end, ref, flags )
+				? TRUE : FALSE;
+
+	return pregex_dfatab_match( regex->trans, regex->trans_cnt, regex->dense,
+								start, stop, end, ref, flags ) ? TRUE : FALSE;
+}
+
 /** Tries to match the regular expression //regex// at pointer //start//.
 
 If the expression can be matched, the function returns TRUE and //end// receives
 the pointer to the last matched character. */
 pboolean pregex_match( pregex* regex, char* start, char** end )
 {
-	int		i;
-	int		state		= 0;
-	int		next_state;
-	char*	match		= (char*)NULL;
-	char*	ptr			= start;
-	wchar_t	ch;
+	return pregex_match_n( regex, start, (char*)NULL, end );
+}
+
+/** Tries to match the regular expression //regex// at pointer //start//, on
+the input that ends at //stop//.
+
+The input doesn't need to be zero-terminated, and may contain zero-bytes,
+which are matched like any other character. If //stop// is (char*)NULL, the
+input is zero-terminated, like with pregex_match().
+
+If the expression can be matched, the function returns TRUE and //end// receives
+the pointer to the last matched character. */
+pboolean pregex_match_n( pregex* regex, char* start, char* stop, char** end )
+{
+	return pregex_match_r( regex, start, stop, end,
+							regex ? regex->ref : (prange*)NULL );
+}
+
+/** Tries to match the regular expression //regex// at pointer //start//, on
+the input that ends at //stop//, with a per-call reference array.
+
+This works like pregex_match_n(), but the references of the match are stored
+into //ref//, which is an optional array of PREGEX_MAXREF prange items,
+instead of the references of //regex//. This way, a compiled //regex// can be
+used by several threads simultaneously, as long as it isn't compiled with
+PREGEX_COMP_LAZY, which modifies its state cache while matching.
 
-	PROC( "pregex_match" );
+If the expression can be matched, the function returns TRUE and //end// receives
+the pointer to the last matched character. */
+pboolean pregex_match_r( pregex* regex, char* start, char* stop, char** end,
+							prange* ref )
+{
+	PROC( "pregex_match_r" );
 	PARMS( "regex", "%p", regex );
-	PARMS( "start", "%s", start );
+	PARMS( "start", "%p", start );
+	PARMS( "stop", "%p", stop );
 	PARMS( "end", "%p", end );
+	PARMS( "ref", "%p", ref );
 
 	if( !( regex && start ) )
 	{
@@ -119,188 +363,285 @@ pboolean pregex_match( pregex* regex, char* start, char** end )
 		RETURN( FALSE );
 	}
 
-	memset( regex->ref, 0, PREGEX_MAXREF * sizeof( prange ) );
+	RETURN( pregex_run( regex, start, stop, end, ref, regex->flags ) );
+}
+
+/** Find a match for the regular expression //regex// from begin of pointer
+//start//.
+
+//start// has to be a zero-terminated string or wide-character string (according
+to the configuration of the pregex-object).
+
+If the expression can be matched, the function returns the pointer to the
+position where the match begins. //end// receives the end pointer of the match,
+when provided.
+
+The function returns (char*)NULL in case that there is no match.
+*/
+char* pregex_find( pregex* regex, char* start, char** end )
+{
+	return pregex_find_n( regex, start, (char*)NULL, end );
+}
+
+/** Find a match for the regular expression //regex// from begin of pointer
+//start//, within the input that ends at //stop//.
+
+This works like pregex_find(), but the input doesn't need to be
+zero-terminated, and may contain zero-bytes. If //stop// is (char*)NULL, the
+input is zero-terminated.
+*/
+char* pregex_find_n( pregex* regex, char* start, char* stop, char** end )
+{
+	return pregex_find_r( regex, start, stop, end,
+							regex ? regex->ref : (prange*)NULL );
+}
+
+/** Find a match for the regular expression //regex// from begin of pointer
+//start//, within the input that ends at //stop//, with a per-call reference
+array.
 
-	while( state >= 0 )
+This works like pregex_find_n(), but the references of the match are stored
+into //ref//, which is an optional array of PREGEX_MAXREF prange items. See
+pregex_match_r() for details.
+*/
+char* pregex_find_r( pregex* regex, char* start, char* stop, char** end,
+						prange* ref )
+{
+	return pregex_find_in( regex, start, start, stop, end, ref );
+}
+
+/** Find a match for the regular expression //regex// from pointer //start//,
+which lies within the input that begins at //begin// and ends at //stop//.
+
+This works like pregex_find_r(), but the anchors of the expression are checked
+against the input in front of //start//, which is read back to //begin//. This
+way, a ``^`` or ``\<`` doesn't match at //start// when the search is continued
+behind a previous match in the middle of a line or word. The character in front
+of //begin// is described by the runtime flags PREGEX_RUN_NOTBOL and
+PREGEX_RUN_NOTBOW of //regex//.
+
+Empty matches are skipped, so that pregex_findall() and the iterators always
+advance.
+*/
+char* pregex_find_in( pregex* regex, char* begin, char* start, char* stop,
+						char** end, prange* ref )
+{
+	return pregex_find_before( regex, begin, start, (char*)NULL, stop,
+								end, ref );
+}
+
+/** Find a match for the regular expression //regex// beginning in front of
+//limit//, from pointer //start//, which lies within the input that begins at
+//begin// and ends at //stop//.
+
+This works like pregex_find_in(), but no match beginning at //limit// or behind
+is searched for. The match found may still end behind //limit//. This way, the
+input can be split into chunks which are searched separately, without reading
+further than the last match of a chunk requires. //limit// is optional, and
+must lie within the input.
+
+The function returns (char*)NULL in case that there is no match beginning in
+front of //limit//.
+*/
+char* pregex_find_before( pregex* regex, char* begin, char* start,
+							char* limit, char* stop, char** end, prange* ref )
+{
+	wchar_t		ch;
+	char*		ptr 	= start;
+	char*		lptr;
+	char*		mend;
+	int			skip	= 0;
+
+	PROC( "pregex_find_before" );
+	PARMS( "regex", "%p", regex );
+	PARMS( "begin", "%p", begin );
+	PARMS( "start", "%p", start );
+	PARMS( "limit", "%p", limit );
+	PARMS( "stop", "%p", stop );
+	PARMS( "end", "%p", end );
+	PARMS( "ref", "%p", ref );
+
+	if( !( regex && begin && start && start >= begin ) )
 	{
-		/* State accepts? */
-		if( regex->trans[ state ][ 1 ] )
-		{
-			MSG( "This state accepts the input" );
-			match = ptr;
+		WRONGPARAM;
+		RETURN( (char*)NULL );
+	}
 
-			if( ( regex->flags & PREGEX_RUN_NONGREEDY
-					|| regex->trans[ state ][ 2 ] & PREGEX_FLAG_NONGREEDY ) )
-			{
-				if( regex->flags & PREGEX_RUN_DEBUG )
-					fprintf( stderr,
-						"state %d accepted %d, end of recognition\n",
-							state, regex->trans[ state ][ 1 ] );
+	/* Skip input that can't contain a match */
+	if( !( ptr = pregex_prefilter( regex, start, limit, stop ) ) )
+		RETURN( (char*)NULL );
 
-				break;
-			}
-		}
+	while( TRUE )
+	{
+		/* Jump to the next candidate position */
+		if( regex->prefix
+				&& !( ptr = pregex_strstr( ptr,
+								pregex_prefix_stop( regex, limit, stop ),
+									regex->prefix ) ) )
+			break;
+
+		lptr = ptr;
+
+		if( limit && lptr >= limit )
+			break;
 
-		/* References */
-		if( regex->trans[ state ][ 3 ] )
+		/* Get next character */
+		if( !pregex_getchar( &ptr, stop, &ch, regex->flags ) )
+			break;
+
+		/* Check for a transition according to current character */
+		if( pregex_first( regex, ch ) )
 		{
-			for( i = 0; i < PREGEX_MAXREF; i++ )
+			if( pregex_run( regex, lptr, stop, &mend, ref,
+								pregex_anchor_at( begin, lptr,
+													regex->flags ) )
+					&& mend > lptr )
 			{
-				if( regex->trans[ state ][ 3 ] & ( 1 << i ) )
-				{
-					if( !regex->ref[ i ].start )
-						regex->ref[ i ].start = ptr;
+				if( end )
+					*end = mend;
 
-					regex->ref[ i ].end = ptr;
-				}
+				RETURN( lptr );
 			}
-		}
 
-		/* Get next character */
-		if( regex->flags & PREGEX_RUN_WCHAR )
-		{
-			VARS( "pstr", "%ls", (wchar_t*)ptr );
-			ch = *( (wchar_t*)ptr );
-			ptr += sizeof( wchar_t );
+			/* Don't retry the DFA at every position behind a failed run */
+			skip = PREGEX_SEARCH_MINSKIP;
 		}
 		else
-		{
-			VARS( "pstr", "%s", ptr );
+			skip++;
 
-			if( ( regex->flags & PREGEX_RUN_UCHAR ) )
-				ch = (unsigned char)*ptr++;
-			else
+		/* Skip the input that doesn't match using the search machine, which
+			finds the next match in a single pass */
+		if( skip >= PREGEX_SEARCH_MINSKIP && regex->search
+				&& !( ( regex->flags ^ regex->search->flags )
+						& PREGEX_RUN_NONGREEDY ) )
+		{
+			if( pregex_search_find( regex->search, ptr, stop, limit, &lptr,
+									pregex_anchor_at( begin, ptr,
+														regex->flags ) )
+					&& !( limit && lptr >= limit )
+					&& pregex_run( regex, lptr, stop, &mend, ref,
+									pregex_anchor_at( begin, lptr,
+														regex->flags ) )
+					&& mend > lptr )
 			{
-#ifdef UTF8
-				ch = u8_char( ptr );
-				ptr += u8_seqlen( ptr );
-#else
-				ch = *ptr++;
-#endif
+				if( end )
+					*end = mend;
+
+				RETURN( lptr );
 			}
-		}
 
-		if( !ch )
 			break;
-
-		/* Initialize default transition */
-		next_state = regex->trans[ state ][ 4 ];
-
-		/* Find transition according to current character */
-		for( i = 5; i < regex->trans[ state ][ 0 ]; i += 3 )
-		{
-			if( regex->trans[ state ][ i ] <= ch
-					&& regex->trans[ state ][ i + 1 ] >= ch )
-			{
-				next_state = regex->trans[ state ][ i + 2 ];
-				break;
-			}
 		}
+	}
 
-		if( next_state == regex->trans_cnt )
-			break;
+	RETURN( (char*)NULL );
+}
 
-		if( regex->flags & PREGEX_RUN_DEBUG )
-		{
-			if( regex->flags & PREGEX_RUN_WCHAR )
-				fprintf( stderr,
-					"state %d, wchar_t %d (>%lc<), next state %d\n",
-						state, ch, ch, next_state );
-			else
-				fprintf( stderr,
-					"state %d, char %d (>%c<), next state %d\n",
-						state, ch, ch, next_state );
-		}
+/** Find the last match for the regular expression //regex// within the
+zero-terminated string //start//, by searching backwards from its end.
 
-		state = next_state;
-	}
+If the expression can be matched, the function returns the pointer to the
+position where the rightmost match begins. //end// receives the end pointer of
+the match, when provided.
 
-	if( match )
-	{
-		if( end )
-			*end = match;
+The function returns (char*)NULL in case that there is no match.
+*/
+char* pregex_rfind( pregex* regex, char* start, char** end )
+{
+	char*		stop;
 
-		/*
-		for( i = 0; i < PREGEX_MAXREF; i++ )
-			if( regex->ref[ i ].start )
-				fprintf( stderr, "%2d: >%.*s<\n",
-					i, regex->ref[ i ].end - regex->ref[ i ].start,
-						regex->ref[ i ].start );
-		*/
+	if( !( regex && start ) )
+		return (char*)NULL;
 
-		RETURN( TRUE );
-	}
+	if( regex->flags & PREGEX_RUN_WCHAR )
+		stop = start + wcslen( (wchar_t*)start ) * sizeof( wchar_t );
+	else
+		stop = start + strlen( start );
 
-	RETURN( FALSE );
+	return pregex_rfind_n( regex, start, stop, end );
 }
 
-/** Find a match for the regular expression //regex// from begin of pointer
-//start//.
+/** Find the last match for the regular expression //regex// within the input
+from //start// to //stop//, by searching backwards from //stop//.
 
-//start// has to be a zero-terminated string or wide-character string (according
-to the configuration of the pregex-object).
+This works like pregex_rfind(), but the search starts at any offset //stop//
+of the input, which doesn't need to be zero-terminated. The match begins at
+or behind //start//, and ends at or before //stop//. This way, the tail of a
+log can be searched without reading it from the begin.
+*/
+char* pregex_rfind_n( pregex* regex, char* start, char* stop, char** end )
+{
+	return pregex_rfind_r( regex, start, stop, end,
+							regex ? regex->ref : (prange*)NULL );
+}
 
-If the expression can be matched, the function returns the pointer to the
-position where the match begins. //end// receives the end pointer of the match,
-when provided.
+/** Find the last match for the regular expression //regex// within the input
+from //start// to //stop//, with a per-call reference array.
 
-The function returns (char*)NULL in case that there is no match.
+This works like pregex_rfind_n(), but the references of the match are stored
+into //ref//, which is an optional array of PREGEX_MAXREF prange items. See
+pregex_match_r() for details.
+
+When //regex// has a search machine, the input is read backwards only once, to
+find where the rightmost match begins, and the match is then run forward from
+there. Otherwise, the expression is tried at every position from //stop//
+towards //start//.
 */
-char* pregex_find( pregex* regex, char* start, char** end )
+char* pregex_rfind_r( pregex* regex, char* start, char* stop, char** end,
+						prange* ref )
 {
-	wchar_t		ch;
-	char*		ptr 	= start;
-	char*		lptr;
-	int			i;
+	char*		ptr;
 
-	PROC( "pregex_find" );
+	PROC( "pregex_rfind_r" );
 	PARMS( "regex", "%p", regex );
-	PARMS( "start", "%s", start );
+	PARMS( "start", "%p", start );
+	PARMS( "stop", "%p", stop );
 	PARMS( "end", "%p", end );
+	PARMS( "ref", "%p", ref );
 
-	if( !( regex && start ) )
+	if( !( regex && start && stop && stop >= start ) )
 	{
 		WRONGPARAM;
 		RETURN( (char*)NULL );
 	}
 
-	do
+	/* Single-pass backward search using the search machine */
+	if( regex->search && regex->search->btrans )
 	{
-		lptr = ptr;
+		if( pregex_search_rfind( regex->search, start, stop, &ptr,
+									regex->flags )
+				&& pregex_run( regex, ptr, stop, end, ref,
+								pregex_anchor_at( start, ptr,
+													regex->flags ) ) )
+			RETURN( ptr );
 
-		/* Get next character */
+		RETURN( (char*)NULL );
+	}
+
+	for( ptr = stop; TRUE; )
+	{
+		if( pregex_run( regex, ptr, stop, end, ref,
+							pregex_anchor_at( start, ptr, regex->flags ) ) )
+			RETURN( ptr );
+
+		if( ptr <= start )
+			break;
+
+		/* Step back to the previous character */
 		if( regex->flags & PREGEX_RUN_WCHAR )
-		{
-			ch = *( (wchar_t*)ptr );
-			ptr += sizeof( wchar_t );
-		}
+			ptr -= sizeof( wchar_t );
+		else if( regex->flags & PREGEX_RUN_UCHAR )
+			ptr--;
 		else
 		{
-			if( ( regex->flags & PREGEX_RUN_UCHAR ) )
-				ch = (unsigned char)*ptr++;
-			else
-			{
 #ifdef UTF8
-				ch = u8_char( ptr );
-				ptr += u8_seqlen( ptr );
+			while( --ptr > start && ( *ptr & 0xC0 ) == 0x80 )
+				;
 #else
-				ch = *ptr++;
+			ptr--;
 #endif
-			}
 		}
-
-		if( !ch )
-			break;
-
-		/* Find a transition according to current character */
-		for( i = 5; i < regex->trans[ 0 ][ 0 ]; i += 3 )
-			if( ( ( regex->trans[ 0 ][ 4 ] < regex->trans_cnt )
-					|| ( regex->trans[ 0 ][ i ] <= ch
-							&& regex->trans[ 0 ][ i + 1 ] >= ch ) )
-					&& pregex_match( regex, lptr, end ) )
-						RETURN( lptr );
 	}
-	while( ch );
 
 	RETURN( (char*)NULL );
 }
@@ -316,13 +657,28 @@ prange. It returns the total number of matches.
 */
 int pregex_findall( pregex* regex, char* start, parray** matches )
 {
+	return pregex_findall_n( regex, start, (char*)NULL, matches );
+}
+
+/** Find all matches for the regular expression //regex// from begin of pointer
+//start//, within the input that ends at //stop//.
+
+This works like pregex_findall(), but the input doesn't need to be
+zero-terminated, and may contain zero-bytes. If //stop// is (char*)NULL, the
+input is zero-terminated.
+*/
+int pregex_findall_n( pregex* regex, char* start, char* stop,
+						parray** matches )
+{
+	char*			begin	= start;
 	char*			end;
 	int				count	= 0;
 	prange*	r;
 
-	PROC( "pregex_findall" );
+	PROC( "pregex_findall_n" );
 	PARMS( "regex", "%p", regex );
-	PARMS( "start", "%s", start );
+	PARMS( "start", "%p", start );
+	PARMS( "stop", "%p", stop );
 	PARMS( "matches", "%p", matches );
 
 	if( !( regex && start ) )
@@ -334,7 +690,8 @@ int pregex_findall( pregex* regex, char* start, parray** matches )
 	if( matches )
 		*matches = (parray*)NULL;
 
-	while( ( start = pregex_find( regex, start, &end ) ) )
+	while( ( start = pregex_find_in( regex, begin, start, stop, &end,
+										regex->ref ) ) )
 	{
 		if( matches )
 		{
@@ -364,17 +721,14 @@ to the configuration of the pregex-object).
 //end// receives the last position of the string before the regex.
 //next// receives the pointer of the next split element behind the matched
 substring, so //next// should become the next //start// when pregex_split() is
-called in a loop.
+called in a loop. Empty matches are skipped, like with pregex_find_in().
 
 The function returns (char*)NULL in case that there is no more string to split,
 else it returns //start//.
 */
 char* pregex_split( pregex* regex, char* start, char** end, char** next )
 {
-	wchar_t		ch;
-	char*		ptr 	= start;
 	char*		lptr;
-	int			i;
 
 	PROC( "pregex_split" );
 	PARMS( "regex", "%p", regex );
@@ -390,42 +744,17 @@ char* pregex_split( pregex* regex, char* start, char** end, char** next )
 	if( next )
 		*next = (char*)NULL;
 
-	do
-	{
-		lptr = ptr;
+	lptr = pregex_find_in( regex, start, start, (char*)NULL, next,
+							regex->ref );
 
-		/* Get next character */
+	/* No more match, split until the end of the string */
+	if( !lptr )
+	{
 		if( regex->flags & PREGEX_RUN_WCHAR )
-		{
-			ch = *( (wchar_t*)ptr );
-			ptr += sizeof( wchar_t );
-		}
+			lptr = start + wcslen( (wchar_t*)start ) * sizeof( wchar_t );
 		else
-		{
-			if( ( regex->flags & PREGEX_RUN_UCHAR ) )
-				ch = (unsigned char)*ptr++;
-			else
-			{
-#ifdef UTF8
-				ch = u8_char( ptr );
-				ptr += u8_seqlen( ptr );
-#else
-				ch = *ptr++;
-#endif
-			}
-		}
-
-		if( !ch )
-			break;
-
-		/* Find a transition according to current character */
-		for( i = 5; i < regex->trans[ 0 ][ 0 ]; i += 3 )
-			if( regex->trans[ 0 ][ i ] <= ch
-				&& regex->trans[ 0 ][ i + 1 ] >= ch
-					&& pregex_match( regex, lptr, next ) )
-						ch = 0;
+			lptr = start + strlen( start );
 	}
-	while( ch );
 
 	if( lptr > start )
 	{
@@ -489,6 +818,330 @@ int pregex_splitall( pregex* regex, char* start, parray** matches )
 	RETURN( count );
 }
 
+/** Initializes the match iterator //iter// to run the regular expression
+//regex// on the input from //start// to //stop//, or on zero-terminated input
+when //stop// is (char*)NULL.
+
+The iterator allocates nothing, and may be placed on the stack. Matches are
+then obtained one by one with pregex_iter_next(), or the pieces between the
+matches with pregex_iter_split(). Each iterator records the references of
+its recent match in //iter->ref//, so several iterators may run on the same
+//regex// concurrently, unless it is compiled with PREGEX_COMP_LAZY.
+
+```
+pregex_iter	it;
+prange		m;
+
+pregex_iter_init( &it, r, s, (char*)NULL );
+
+while( pregex_iter_next( &it, &m ) )
+	printf( ">%.*s<\n", m.end - m.start, m.start );
+```
+
+Returns TRUE on success, FALSE on wrong parameters.
+*/
+pboolean pregex_iter_init( pregex_iter* iter, pregex* regex,
+								char* start, char* stop )
+{
+	PROC( "pregex_iter_init" );
+	PARMS( "iter", "%p", iter );
+	PARMS( "regex", "%p", regex );
+	PARMS( "start", "%p", start );
+	PARMS( "stop", "%p", stop );
+
+	if( !( iter && regex && start ) )
+	{
+		WRONGPARAM;
+		RETURN( FALSE );
+	}
+
+	memset( iter, 0, sizeof( pregex_iter ) );
+	iter->regex = regex;
+	iter->begin = iter->ptr = start;
+	iter->stop = stop;
+
+	RETURN( TRUE );
+}
+
+/** Finds the next match of the iterator //iter//, which was initialized by
+pregex_iter_init(), and stores it into //match//.
+
+The matches are the same as those returned by pregex_findall_n(), with an id
+of 1.
+
+Returns TRUE if a match was found, and FALSE when there are no more matches.
+*/
+pboolean pregex_iter_next( pregex_iter* iter, prange* match )
+{
+	char*	start;
+	char*	end;
+
+	if( !( iter && iter->regex && match ) )
+	{
+		WRONGPARAM;
+		return FALSE;
+	}
+
+	if( !iter->ptr || !( start = pregex_find_in( iter->regex, iter->begin,
+										iter->ptr, iter->stop, &end,
+											iter->ref ) ) )
+	{
+		iter->ptr = (char*)NULL;
+		return FALSE;
+	}
+
+	match->id = 1;
+	match->start = start;
+	match->end = iter->ptr = end;
+
+	return TRUE;
+}
+
+/** Returns the next piece of input between the matches of the iterator
+//iter//, which was initialized by pregex_iter_init(), into //match//.
+
+The pieces are the same as those returned by pregex_splitall(), with an id of
+0. Like there, empty pieces are skipped.
+
+Returns TRUE if a piece was found, and FALSE when the input is exhausted.
+*/
+pboolean pregex_iter_split( pregex_iter* iter, prange* match )
+{
+	char*	start;
+	char*	end;
+
+	if( !( iter && iter->regex && match ) )
+	{
+		WRONGPARAM;
+		return FALSE;
+	}
+
+	while( iter->ptr )
+	{
+		match->id = 0;
+		match->start = iter->ptr;
+
+		if( ( start = pregex_find_in( iter->regex, iter->begin, iter->ptr,
+										iter->stop, &end, iter->ref ) ) )
+		{
+			match->end = start;
+			iter->ptr = end;
+		}
+		else
+		{
+			if( iter->stop )
+				match->end = iter->stop;
+			else if( iter->regex->flags & PREGEX_RUN_WCHAR )
+				match->end = (char*)( (wchar_t*)iter->ptr
+										+ wcslen( (wchar_t*)iter->ptr ) );
+			else
+				match->end = iter->ptr + strlen( iter->ptr );
+
+			iter->ptr = (char*)NULL;
+		}
+
+		if( match->end > match->start )
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+/* Output of a replacement, written into a growing buffer, a fixed buffer or
+a file */
+typedef struct
+{
+	char*		buf;		/* Buffer */
+	size_t		size;		/* Size of buf in bytes */
+	size_t		len;		/* Bytes written to buf */
+	size_t		total;		/* Total bytes of the output */
+	size_t		term;		/* Size of the zero-terminator */
+	pboolean	grow;		/* buf is allocated and grows on demand */
+	FILE*		f;			/* Output file, or (FILE*)NULL */
+} pregex_output;
+
+/* Writes //len// bytes from //ptr// to //out//. */
+static pboolean pregex_output_put( pregex_output* out, char* ptr, size_t len )
+{
+	size_t	size;
+
+	if( !len )
+		return TRUE;
+
+	out->total += len;
+
+	if( out->f )
+		return fwrite( ptr, 1, len, out->f ) == len;
+
+	if( out->grow && out->len + len + out->term > out->size )
+	{
+		for( size = out->size ? out->size : 64;
+				size < out->len + len + out->term; size *= 2 )
+			;
+
+		if( !( out->buf = (char*)prealloc( out->buf, size ) ) )
+			return FALSE;
+
+		out->size = size;
+	}
+
+	/* Truncate on a fixed buffer */
+	if( out->len + out->term >= out->size )
+		return TRUE;
+
+	if( len > out->size - out->term - out->len )
+		len = out->size - out->term - out->len;
+
+	memcpy( out->buf + out->len, ptr, len );
+	out->len += len;
+
+	return TRUE;
+}
+
+/* Parses //replacement// into //segs//, a list of prange items. Literal
+segments have an id of 0, references have the id of the reference. A
+//replacement// of (char*)NULL is empty. */
+static void pregex_replace_parse( pregex* regex, char* replacement,
+									parray* segs )
+{
+	prange*		seg;
+	char*		prev;
+	char*		ptr;
+	char*		end;
+	int			ref;
+
+	if( !replacement )
+		return;
+
+	if( regex->flags & PREGEX_RUN_NOREF )
+	{
+		seg = (prange*)parray_malloc( segs );
+		seg->start = replacement;
+
+		if( regex->flags & PREGEX_RUN_WCHAR )
+			seg->end = (char*)( (wchar_t*)replacement
+									+ wcslen( (wchar_t*)replacement ) );
+		else
+			seg->end = replacement + strlen( replacement );
+
+		return;
+	}
+
+	for( prev = ptr = replacement; TRUE; )
+	{
+		end = (char*)NULL;
+
+		if( regex->flags & PREGEX_RUN_WCHAR )
+		{
+			if( !*( (wchar_t*)ptr ) )
+				break;
+
+			if( *( (wchar_t*)ptr ) == L'$'
+					&& iswdigit( *( (wchar_t*)ptr + 1 ) ) )
+				ref = wcstol( (wchar_t*)ptr + 1, (wchar_t**)&end, 0 );
+		}
+		else
+		{
+			if( !*ptr )
+				break;
+
+			if( *ptr == '$' && isdigit( (unsigned char)ptr[ 1 ] ) )
+				ref = strtol( ptr + 1, &end, 0 );
+		}
+
+		if( !end )
+		{
+			ptr += ( regex->flags & PREGEX_RUN_WCHAR ) ? sizeof( wchar_t ) : 1;
+			continue;
+		}
+
+		if( ptr > prev )
+		{
+			seg = (prange*)parray_malloc( segs );
+			seg->start = prev;
+			seg->end = ptr;
+		}
+
+		/* TODO: Ref $0 */
+		if( ref > 0 && ref < PREGEX_MAXREF )
+		{
+			seg = (prange*)parray_malloc( segs );
+			seg->id = ref;
+		}
+
+		prev = ptr = end;
+	}
+
+	if( ptr > prev )
+	{
+		seg = (prange*)parray_malloc( segs );
+		seg->start = prev;
+		seg->end = ptr;
+	}
+}
+
+/* Replaces all matches of //regex// within //str// with //replacement//, and
+writes the result to //out//. */
+static pboolean pregex_replace_out( pregex* regex, char* str,
+										char* replacement, pregex_output* out )
+{
+	prange		ref		[ PREGEX_MAXREF ];
+	parray		segs;
+	prange*		seg;
+	prange*		rg;
+	char*		sstart	= str;
+	char*		start;
+	char*		end;
+	pboolean	ret		= TRUE;
+
+	out->term = ( regex->flags & PREGEX_RUN_WCHAR ) ? sizeof( wchar_t ) : 1;
+
+	/* The replacement is parsed once into its segments */
+	parray_init( &segs, sizeof( prange ), 0 );
+	pregex_replace_parse( regex, replacement, &segs );
+
+	while( ret )
+	{
+		if( !( start = pregex_find_in( regex, str, sstart, (char*)NULL, &end,
+						( regex->flags & PREGEX_RUN_NOREF )
+							? (prange*)NULL : ref ) ) )
+		{
+			if( regex->flags & PREGEX_RUN_WCHAR )
+				start = (char*)( (wchar_t*)sstart +
+									wcslen( (wchar_t*)sstart ) );
+			else
+				start = sstart + strlen( sstart );
+
+			end = (char*)NULL;
+		}
+
+		ret = pregex_output_put( out, sstart, start - sstart );
+
+		if( !end )
+			break;
+
+		for( seg = (prange*)parray_first( &segs ); ret && seg;
+				seg = (prange*)parray_next( &segs, seg ) )
+		{
+			rg = seg->id ? &ref[ seg->id ] : seg;
+
+			if( rg->start )
+				ret = pregex_output_put( out, rg->start,
+											rg->end - rg->start );
+		}
+
+		sstart = end;
+	}
+
+	parray_erase( &segs );
+
+	/* Zero-terminate the buffer */
+	if( ret && !out->f && out->size )
+		memset( out->buf + out->len, 0, out->term );
+
+	return ret;
+}
+
 /** Replaces all matches of a regular expression object within a string //str//
 with //replacement//. Backreferences in //replacement// can be used with //$x//
 for each opening bracket within the regular expression.
@@ -500,21 +1153,15 @@ match of a pattern described in //regex//. The notation //$x// can be used for
 backreferences, where x is the offset of opening brackets in the pattern,
 beginning at 1.
 
+The replacement is parsed once, and the result is built in one buffer growing
+on demand.
+
 The function returns the string with the replaced elements, or (char*)NULL
 in error case.
 */
 char* pregex_replace( pregex* regex, char* str, char* replacement )
 {
-	prange*	refer;
-	char*			ret			= (char*)NULL;
-	char*			sstart		= str;
-	char*			start;
-	char*			end;
-	char*			replace;
-	char*			rprev;
-	char*			rpstr;
-	char*			rstart;
-	int				ref;
+	pregex_output	out;
 
 	PROC( "pregex_replace" );
 	PARMS( "regex", "%p", regex );
@@ -526,7 +1173,7 @@ char* pregex_replace( pregex* regex, char* str, char* replacement )
 	}
 
 #ifdef DEBUG
-	if( regex && regex->flags & PREGEX_RUN_WCHAR )
+	if( regex->flags & PREGEX_RUN_WCHAR )
 	{
 		PARMS( "str", "%ls", pstrget( str ) );
 		PARMS( "replacement", "%ls", pstrget( replacement ) );
@@ -538,259 +1185,96 @@ char* pregex_replace( pregex* regex, char* str, char* replacement )
 	}
 #endif
 
-	MSG( "Starting loop" );
+	memset( &out, 0, sizeof( pregex_output ) );
+	out.grow = TRUE;
 
-	while( TRUE )
+	if( !pregex_replace_out( regex, str, replacement, &out ) )
 	{
-		if( !( start = pregex_find( regex, sstart, &end ) ) )
-		{
-			if( regex->flags & PREGEX_RUN_WCHAR )
-				start = (char*)( (wchar_t*)sstart +
-									wcslen( (wchar_t*)sstart ) );
-			else
-				start = sstart + strlen( sstart );
+		OUTOFMEM;
+		RETURN( (char*)pfree( out.buf ) );
+	}
 
-			end = (char*)NULL;
-		}
+	/* Nothing written, return an empty string */
+	if( !out.buf )
+		out.buf = (char*)pmalloc( out.term );
 
-		if( start > sstart )
-		{
-			MSG( "Extending string" );
-			if( regex->flags & PREGEX_RUN_WCHAR )
-			{
-				if( !( ret = (char*)pwcsncatstr(
-								(wchar_t*)ret, (wchar_t*)sstart,
-									( (wchar_t*)start - (wchar_t*)sstart ) ) ) )
-				{
-					OUTOFMEM;
-					RETURN( (char*)NULL );
-				}
-			}
-			else
-			{
-				if( !( ret = pstrncatstr( ret, sstart, start - sstart ) ) )
-				{
-					OUTOFMEM;
-					RETURN( (char*)NULL );
-				}
-			}
-		}
+#ifdef DEBUG
+	if( regex->flags & PREGEX_RUN_WCHAR )
+		VARS( "ret", "%ls", (wchar_t*)out.buf );
+	else
+		VARS( "ret", "%s", out.buf );
+#endif
 
-		if( !end )
-			break;
+	RETURN( out.buf );
+}
 
-		MSG( "Constructing a replacement" );
-		if( !( regex->flags & PREGEX_RUN_NOREF ) )
-		{
-			rprev = rpstr = replacement;
-			replace = (char*)NULL;
+/** Replaces all matches of a regular expression object within a string //str//
+with //replacement//, and writes the result into the buffer //buf// of //size//
+bytes.
 
-			while( *rpstr )
-			{
-				VARS( "*rpstr", "%c", *rpstr );
-				if( *rpstr == '$' )
-				{
-					rstart = rpstr;
-
-					if( regex->flags & PREGEX_RUN_WCHAR )
-					{
-						wchar_t*		_end;
-						wchar_t*		_rpstr = (wchar_t*)rpstr;
-
-						MSG( "Switching to wide-character mode" );
-
-						if( iswdigit( *( ++_rpstr ) ) )
-						{
-							ref = wcstol( _rpstr, &_end, 0 );
-
-							VARS( "ref", "%d", ref );
-							VARS( "end", "%ls", _end );
-
-							/* Skip length of the number */
-							_rpstr = _end;
-
-							/* Extend first from prev of replacement */
-							if( !( replace = (char*)pwcsncatstr(
-									(wchar_t*)replace, (wchar_t*)rprev,
-										(wchar_t*)rstart - (wchar_t*)rprev ) ) )
-							{
-								OUTOFMEM;
-								RETURN( (char*)NULL );
-							}
-
-							VARS( "replace", "%ls", replace );
-							VARS( "ref", "%d", ref );
-
-							if( ref > 0 && ref < PREGEX_MAXREF )
-								refer = &( regex->ref[ ref ] );
-							/* TODO: Ref $0 */
-							else
-								refer = (prange*)NULL;
-
-							if( refer )
-							{
-								MSG( "There is a reference!" );
-								VARS( "refer->start", "%ls",
-										(wchar_t*)refer->start );
-								VARS( "refer->end", "%ls",
-										(wchar_t*)refer->start );
-
-								if( !( replace = (char*)pwcsncatstr(
-										(wchar_t*)replace,
-											(wchar_t*)refer->start,
-												(wchar_t*)refer->end -
-													(wchar_t*)refer->start ) ) )
-								{
-									OUTOFMEM;
-									RETURN( (char*)NULL );
-								}
-							}
-
-							VARS( "replace", "%ls", (wchar_t*)replace );
-							rprev = rpstr = (char*)_rpstr;
-						}
-						else
-							rpstr = (char*)_rpstr;
-					}
-					else
-					{
-						char*		_end;
-
-						MSG( "Byte-character mode (Standard)" );
-
-						if( isdigit( *( ++rpstr ) ) )
-						{
-							ref = strtol( rpstr, &_end, 0 );
-
-							VARS( "ref", "%d", ref );
-							VARS( "end", "%s", _end );
-
-							/* Skip length of the number */
-							rpstr = _end;
-
-							/* Extend first from prev of replacement */
-							if( !( replace = pstrncatstr( replace,
-										rprev, rstart - rprev ) ) )
-							{
-								OUTOFMEM;
-								RETURN( (char*)NULL );
-							}
-
-							VARS( "replace", "%s", replace );
-							VARS( "ref", "%d", ref );
-
-							if( ref > 0 && ref < PREGEX_MAXREF )
-								refer = &( regex->ref[ ref ] );
-							/* TODO: Ref $0 */
-							else
-								refer = (prange*)NULL;
-
-							if( refer )
-							{
-								MSG( "There is a reference!" );
-								VARS( "refer->start", "%ls",
-										(wchar_t*)refer->start );
-								VARS( "refer->end", "%ls",
-										(wchar_t*)refer->end );
-
-								if( !( replace = (char*)pstrncatstr(
-											replace, refer->start,
-												refer->end - refer->start ) ) )
-								{
-									OUTOFMEM;
-									RETURN( (char*)NULL );
-								}
-							}
-
-							VARS( "replace", "%s", replace );
-							rprev = rpstr;
-						}
-					}
-				}
-				else
-					rpstr += ( regex->flags & PREGEX_RUN_WCHAR )
-								? sizeof( wchar_t ) : 1;
-			}
+This works like pregex_replace(), but doesn't allocate the result. At most
+//size// bytes including the zero-terminator are written, and the result is
+truncated if it doesn't fit. //buf// may be (char*)NULL when //size// is 0.
 
-			VARS( "rpstr", "%p", rpstr );
-			VARS( "rprev", "%p", rprev );
+Returns the size of the entire result in bytes without the zero-terminator,
+so that a result of //size// or more bytes was truncated. This also allows
+to determine the required buffer size first.
+*/
+size_t pregex_replace_buf( pregex* regex, char* str, char* replacement,
+								char* buf, size_t size )
+{
+	pregex_output	out;
 
-#ifdef DEBUG
-			if( regex->flags & PREGEX_RUN_WCHAR )
-			{
-				VARS( "rpstr", "%ls", (wchar_t*)replace );
-				VARS( "rprev", "%ls", (wchar_t*)rprev );
-			}
-			else
-			{
-				VARS( "rpstr", "%s", replace );
-				VARS( "rprev", "%s", rprev );
-			}
-#endif
+	PROC( "pregex_replace_buf" );
+	PARMS( "regex", "%p", regex );
+	PARMS( "buf", "%p", buf );
+	PARMS( "size", "%ld", size );
 
-			if( regex->flags & PREGEX_RUN_WCHAR )
-			{
-				if( rpstr != rprev &&
-						!( replace = (char*)pwcscatstr(
-								(wchar_t*)replace, (wchar_t*)rprev, FALSE ) ) )
-				{
-					OUTOFMEM;
-					RETURN( (char*)NULL );
-				}
-			}
-			else
-			{
-				if( rpstr != rprev && !( replace = pstrcatstr(
-											replace, rprev, FALSE ) ) )
-				{
-					OUTOFMEM;
-					RETURN( (char*)NULL );
-				}
-			}
-		}
-		else
-			replace = replacement;
+	if( !( regex && str && ( buf || !size ) ) )
+	{
+		WRONGPARAM;
+		RETURN( 0 );
+	}
 
-		if( replace )
-		{
-#ifdef DEBUG
-			if( regex->flags & PREGEX_RUN_WCHAR )
-				VARS( "replace", "%ls", (wchar_t*)replace );
-			else
-				VARS( "replace", "%s", replace );
-#endif
-			if( regex->flags & PREGEX_RUN_WCHAR )
-			{
-				if( !( ret = (char*)pwcsncatstr(
-						(wchar_t*)ret, (wchar_t*)replace,
-							pwcslen( (wchar_t*)replace ) ) ) )
-				{
-					OUTOFMEM;
-					RETURN( (char*)NULL );
-				}
-			}
-			else
-			{
-				if( !( ret = pstrncatstr( ret, replace, pstrlen( replace ) ) ) )
-				{
-					OUTOFMEM;
-					RETURN( (char*)NULL );
-				}
-			}
+	memset( &out, 0, sizeof( pregex_output ) );
+	out.buf = buf;
+	out.size = size;
 
-			if( !( regex->flags & PREGEX_RUN_NOREF ) )
-				pfree( replace );
-		}
+	/* Too small for the terminator; ignore the buffer */
+	if( size < ( ( regex->flags & PREGEX_RUN_WCHAR ) ? sizeof( wchar_t ) : 1 ) )
+		out.size = 0;
 
-		sstart = end;
+	pregex_replace_out( regex, str, replacement, &out );
+
+	VARS( "out.total", "%ld", out.total );
+	RETURN( out.total );
+}
+
+/** Replaces all matches of a regular expression object within a string //str//
+with //replacement//, and writes the result to the file //f//.
+
+This works like pregex_replace(), but the result is written directly to //f//
+without being kept in memory. No zero-terminator is written.
+
+Returns TRUE on success, FALSE if an error occurred while writing.
+*/
+pboolean pregex_replace_file( pregex* regex, char* str, char* replacement,
+								FILE* f )
+{
+	pregex_output	out;
+
+	PROC( "pregex_replace_file" );
+	PARMS( "regex", "%p", regex );
+	PARMS( "f", "%p", f );
+
+	if( !( regex && str && f ) )
+	{
+		WRONGPARAM;
+		RETURN( FALSE );
 	}
 
-#ifdef DEBUG
-	if( regex->flags & PREGEX_RUN_WCHAR )
-		VARS( "ret", "%ls", (wchar_t*)ret );
-	else
-		VARS( "ret", "%s", ret );
-#endif
+	memset( &out, 0, sizeof( pregex_output ) );
+	out.f = f;
 
-	RETURN( ret );
+	RETURN( pregex_replace_out( regex, str, replacement, &out ) );
 }
@@ -12,6 +12,17 @@ Usage:	Header for the pregex object and functions.
 /* Defines */
 #define PREGEX_ALLOC_STEP		16
 #define PREGEX_MAXREF			32
+#define PREGEX_SEARCH_MAXSTATES	1024
+#define PREGEX_SEARCH_MINSKIP	8
+#define PREGEX_LAZY_MAXSTATES	512
+#define PREGEX_LAZY_BUCKETS		256
+#define PREGEX_LAZY_MINCHARS	( 2 * PREGEX_LAZY_MAXSTATES )
+#define PREGEX_BITNFA_MAXWORDS	4
+#define PREGEX_IMAGE_MAGIC		"phxregex"
+#define PREGEX_IMAGE_VERSION	3
+#define PREGEX_STREAM_BUFSIZE	65536
+#define PREGEX_PARALLEL_MINCHUNK	65536
+#define PREGEX_PARALLEL_MINRECORDS	1024
 
 /* Regex flags */
 
@@ -34,6 +45,16 @@ Usage:	Header for the pregex object and functions.
 #define PREGEX_COMP_PTN			0x80	/*	The regular expression passed
 											already is a pattern, and shall be
 											integrated. */
+#define PREGEX_COMP_LAZY		0x4000	/*	Construct the DFA lazily while
+											matching, instead of compiling
+											it in advance. */
+#define PREGEX_COMP_BITNFA		0x8000	/*	Run a bit-parallel NFA instead of
+											compiling a DFA, if the pattern is
+											small enough. */
+#define PREGEX_COMP_UTF8		0x10000	/*	Compile the DFA on the bytes of
+											UTF-8 encoded input, so that no
+											characters are decoded while
+											matching. */
 
 /* ---> Part II: Runtime flags */
 #define PREGEX_RUN_WCHAR		0x100	/*	Run regular expression with
@@ -44,6 +65,10 @@ Usage:	Header for the pregex object and functions.
 #define PREGEX_RUN_NONGREEDY	0x1000	/*	Run regular expression nongreedy */
 #define PREGEX_RUN_DEBUG		0x2000 	/*	Debug mode; output some debug to
 											stderr */
+#define PREGEX_RUN_NOTBOL		0x20000	/*	The input doesn't start at the
+											begin of a line */
+#define PREGEX_RUN_NOTBOW		0x40000	/*	The input starts behind a word
+											character */
 
 /* Matching flags */
 #define PREGEX_FLAG_NONE		0x00	/* No flags defined */
@@ -52,6 +77,31 @@ Usage:	Header for the pregex object and functions.
 #define PREGEX_FLAG_BOW			0x04	/* Match at begin of word only */
 #define PREGEX_FLAG_EOW			0x08	/* Match at end of word only */
 #define PREGEX_FLAG_NONGREEDY	0x10	/* Nongreedy match, overwrite mode. */
+#define PREGEX_FLAG_FALLBACK	0x20	/* The dfatab row is followed by further
+											accepting ids and flags */
+#define PREGEX_FLAG_ANCHORS		( PREGEX_FLAG_BOL | PREGEX_FLAG_EOL \
+									| PREGEX_FLAG_BOW | PREGEX_FLAG_EOW )
+										/* All anchor flags */
+
+/* Anchor classes of the characters around a match */
+#define PREGEX_ANCHOR_LINE		0	/* Line break, or no character at the
+										begin or end of the input */
+#define PREGEX_ANCHOR_WORD		1	/* Word character, alphanumeric or _ */
+#define PREGEX_ANCHOR_OTHER		2	/* Any other character */
+#define PREGEX_ANCHOR_CLASSES	3
+
+/* Search machine row flags */
+#define PREGEX_SEARCH_ENDED		0x100	/* A match ended in front of the
+											character leading into the row */
+#define PREGEX_SEARCH_ATEOF		0x200	/* A match ends here, if the input
+											ends */
+#define PREGEX_SEARCH_CLASSES	0x400	/* The first rows are the initial
+											states for every anchor class */
+#define PREGEX_SEARCH_IDLE		0x800	/* No match is running, except one
+											starting at the next character */
+#define PREGEX_SEARCH_BEGINS( cls )	( 0x1000 << ( cls ) )
+										/* A match may begin behind a
+											character of anchor class cls */
 
 /* Regular Expression pattern types */
 enum _regex_ptntype
@@ -69,10 +119,19 @@ enum _regex_ptntype
 /* Typedefs */
 typedef struct	_regex_nfa_st	pregex_nfa_st;
 typedef struct	_regex_nfa		pregex_nfa;
+typedef struct	_regex_nfa_set	pregex_nfa_set;
 
 typedef struct	_regex_dfa_tr	pregex_dfa_tr;
 typedef struct	_regex_dfa_st	pregex_dfa_st;
 typedef struct	_regex_dfa		pregex_dfa;
+typedef struct	_regex_dense	pregex_dense;
+typedef struct	_regex_comb		pregex_comb;
+typedef struct	_regex_accel	pregex_accel;
+typedef struct	_regex_search	pregex_search;
+typedef struct	_regex_lazy_st	pregex_lazy_st;
+typedef struct	_regex_lazy		pregex_lazy;
+typedef struct	_regex_bitnfa	pregex_bitnfa;
+typedef struct	_regex_image	pregex_image;
 
 typedef enum 	_regex_ptntype	pregex_ptntype;
 typedef struct	_regex_ptn		pregex_ptn;
@@ -80,6 +139,10 @@ typedef struct	_regex_ptn		pregex_ptn;
 typedef struct	_range			prange;
 typedef struct	_regex			pregex;
 typedef struct	_lex			plex;
+typedef struct	_lex_stream		plex_stream;
+typedef struct	_regex_iter		pregex_iter;
+
+typedef int (*plex_readfn)( void* user, char* buf, size_t size );
 
 
 /*
@@ -97,6 +160,8 @@ struct _regex_nfa_st
 	unsigned int	accept;		/* Accepting state */
 	int				flags;		/* State flagging */
 	int				refs;		/* References flags */
+
+	int				id;			/* Dense state id, see pregex_nfa_index() */
 };
 
 /* NFA state machine */
@@ -104,8 +169,27 @@ struct _regex_nfa
 {
 	plist*			states;		/* NFA states */
 	int				modifiers;	/* Regex-modifiers */
+
+	int				cnt;		/* Number of indexed states, 0 if the
+									states are not indexed */
+	pregex_nfa_st**	index;		/* NFA states by id */
 };
 
+/* Sparse set of NFA state ids */
+struct _regex_nfa_set
+{
+	int				cnt;		/* Number of ids in the set */
+	int*			dense;		/* Ids in order of insertion */
+	int*			sparse;		/* Position of each id within dense */
+};
+
+#define pregex_nfa_set_has( set, i ) \
+	( (set)->sparse[ i ] < (set)->cnt \
+		&& (set)->dense[ (set)->sparse[ i ] ] == ( i ) )
+
+#define pregex_nfa_set_add( set, i ) \
+	( (set)->dense[ (set)->sparse[ i ] = (set)->cnt++ ] = ( i ) )
+
 /* DFA transition */
 struct _regex_dfa_tr
 {
@@ -123,6 +207,8 @@ struct _regex_dfa_st
 
 	unsigned int	accept;		/* Accepting state */
 	int				flags;		/* State flagging */
+	int*			fallback;	/* Further accepting ids and flags, see
+									pregex_accept_add() */
 	int				refs;		/* References flags */
 };
 
@@ -132,6 +218,142 @@ struct _regex_dfa
 	plist*			states;		/* List of dfa-states */
 };
 
+/* Number of columns behind the transitions of a dfatab row, which hold the
+further accepting ids and flags of a row flagged by PREGEX_FLAG_FALLBACK */
+#define pregex_dfatab_fallback( row ) \
+	( (row)[ 2 ] & PREGEX_FLAG_FALLBACK ? 1 + (row)[ (row)[ 0 ] ] * 2 : 0 )
+
+/* Self-loop acceleration of a DFA state */
+struct _regex_accel
+{
+	char			stay		[ 256 ];
+								/* Flags for bytes staying in the state */
+	int				cnt;		/* Number of bytes leaving the state */
+	char			leave		[ 3 ];
+								/* Bytes leaving the state, if there are
+									not more than three */
+};
+
+/* Comb-vector transition table for the characters up to PCCL_MAX */
+#define PREGEX_COMB_PAGES		( ( PCCL_MAX + 1 ) / 256 )
+
+struct _regex_comb
+{
+	int				classes;	/* Number of character classes */
+	int				blocks;		/* Number of distinct class map blocks */
+	int				rows;		/* Number of distinct rows */
+	int				size;		/* Number of next- and check-entries */
+	size_t			bytes;		/* Size of the table in bytes */
+
+	int*			base;		/* Displacement per row */
+	uint16_t*		page;		/* Class map block per 256 characters */
+	uint16_t*		map;		/* Class map blocks of 256 characters */
+	uint16_t*		row;		/* Row per state */
+	uint16_t*		def;		/* Default goto-state per row */
+	uint16_t*		tmpl;		/* Template state per row, or UINT16_MAX */
+	uint16_t*		next;		/* Goto-states of all rows, overlaid */
+	uint16_t*		check;		/* Owning row per entry of next */
+};
+
+/* Dense DFA transition table, compiled from a dfatab */
+struct _regex_dense
+{
+	int				states;		/* Number of states */
+	int				classes;	/* Number of character classes */
+
+	unsigned char	map			[ 256 ];
+								/* Character to class map */
+	uint16_t*		trans;		/* Transition matrix of states x classes;
+									A goto-state of value states means
+									that there is no transition. */
+	pregex_accel**	accel;		/* Self-loop acceleration per state for
+									byte input and UTF-8 input, or NULL */
+	unsigned char**	tags;		/* Reference tag list per state, or NULL
+									when no state takes references */
+	pregex_comb*	comb;		/* Table for characters beyond 255, or NULL
+									when the dfatab is searched instead */
+};
+
+/* Unanchored search machine, compiled from a dfatab */
+struct _regex_search
+{
+	int				flags;		/* Runtime flags the machine was built for */
+
+	int				trans_cnt;	/* Counts of forward search DFA states */
+	wchar_t**		trans;		/* Forward search DFA transitions */
+	pregex_dense*	dense;		/* Dense forward search DFA transitions */
+
+	int				rtrans_cnt;	/* Counts of reverse DFA states */
+	wchar_t**		rtrans;		/* Reverse DFA transitions */
+	pregex_dense*	rdense;		/* Dense reverse DFA transitions */
+
+	int				btrans_cnt;	/* Counts of backward search DFA states */
+	wchar_t**		btrans;		/* Backward search DFA transitions, or NULL
+									when not compiled */
+	pregex_dense*	bdense;		/* Dense backward search DFA transitions */
+};
+
+/* Lazy DFA state, constructed on demand */
+struct _regex_lazy_st
+{
+	int*			set;		/* Sorted NFA state indexes of this state */
+	int				cnt;		/* Number of NFA states in set */
+	unsigned int	hash;		/* Hash value of set */
+	int				next;		/* Next state in hash bucket, 1-based */
+
+	unsigned int	accept;		/* Accepting state */
+	int				flags;		/* State flagging */
+	int*			fallback;	/* Further accepting ids and flags, see
+									pregex_accept_add() */
+	int				refs;		/* References flags */
+
+	int				trans		[ 256 ];
+								/* Cached transitions; 0 is unknown,
+									-1 is no transition, else the
+									goto-state + 1 */
+};
+
+/* Lazy DFA, constructing its states from a NFA on demand */
+struct _regex_lazy
+{
+	pregex_nfa*		nfa;		/* The indexed NFA */
+
+	pregex_lazy_st*	states;		/* State cache */
+	int				states_cnt;	/* Number of cached states */
+	int				buckets		[ PREGEX_LAZY_BUCKETS ];
+								/* Hash buckets of the state cache */
+	int				flushes;	/* Number of cache flushes */
+
+	pregex_nfa_set*	work;		/* Working NFA state set */
+};
+
+/* Bit-parallel Glushkov NFA, constructed from a pattern */
+struct _regex_bitnfa
+{
+	int				positions;	/* Number of positions, including the
+									initial position 0 */
+	int				words;		/* Number of 64-bit words per position set */
+
+	uint64_t*		follow;		/* Follow set for every position */
+	uint64_t*		last;		/* Accepting positions */
+	pboolean		nullable;	/* Initial position accepts */
+	uint64_t*		mask;		/* Positions matching for characters 0-255 */
+	pccl**			ccl;		/* Character-class per position, referenced
+									from the pattern */
+
+	unsigned int	accept;		/* Accepting id */
+	int				flags;		/* Pattern flagging */
+};
+
+/* Binary image of a compiled pregex or plex, see pregex_save() */
+struct _regex_image
+{
+	char*			data;		/* Image data */
+	size_t			size;		/* Image size in bytes */
+	pboolean		mapped;		/* Data is mapped from a file, else it is
+									allocated */
+};
+
 /*
  * Patterns
  */
@@ -171,6 +393,14 @@ struct _regex
 
 	int				trans_cnt;	/* Counts of DFA states */
 	wchar_t**		trans;		/* DFA transitions */
+	pregex_dense*	dense;		/* Dense DFA transitions */
+	pregex_search*	search;		/* Unanchored search machine */
+	pregex_lazy*	lazy;		/* Lazy DFA, for PREGEX_COMP_LAZY */
+	pregex_bitnfa*	bitnfa;		/* Bit-parallel NFA, for PREGEX_COMP_BITNFA */
+	pregex_image*	image;		/* Loaded image holding the DFA rows */
+
+	char*			prefix;		/* Required literal prefix of any match */
+	char*			factor;		/* Required literal within any match */
 
 	prange			ref			[ PREGEX_MAXREF ];
 };
@@ -184,7 +414,46 @@ struct _lex
 
 	int				trans_cnt;	/* Counts of DFA states */
 	wchar_t**		trans;		/* DFA transitions */
+	pregex_dense*	dense;		/* Dense DFA transitions */
+	pregex_search*	search;		/* Unanchored search machine */
+	pregex_lazy*	lazy;		/* Lazy DFA, for PREGEX_COMP_LAZY */
+	pregex_image*	image;		/* Loaded image holding the DFA rows */
+
+	prange			ref			[ PREGEX_MAXREF ];
+};
+
+/* Streaming lexer context, see plex_stream_create() */
+struct _lex_stream
+{
+	plex*			lex;		/* Lexical analyzer */
+
+	plex_readfn		read;		/* Read function */
+	void*			user;		/* User data passed to read function */
+	int				fd;			/* File descriptor for plex_stream_fd() */
+
+	char*			buf;		/* Input buffer */
+	size_t			size;		/* Size of the buffer */
+	size_t			len;		/* Bytes of input within the buffer */
+	size_t			pos;		/* Position of the next token in buffer */
+	size_t			base;		/* Input offset of the buffer */
+	pboolean		eof;		/* End of input reached */
+	int				prev;		/* Anchor class of the discarded input's
+									last character */
+
+	size_t			offset;		/* Input offset of the recent token */
+};
+
+/* Match iterator, see pregex_iter_init() and plex_iter_init() */
+struct _regex_iter
+{
+	pregex*			regex;		/* Regular expression, or NULL */
+	plex*			lex;		/* Lexical analyzer, or NULL */
+
+	char*			begin;		/* Begin of input */
+	char*			ptr;		/* Current position, NULL when done */
+	char*			stop;		/* End of input, or NULL */
 
 	prange			ref			[ PREGEX_MAXREF ];
+								/* References of the recent match */
 };
 
@@ -0,0 +1,590 @@
+/* -MODULE----------------------------------------------------------------------
+Phorward Foundation Toolkit
+Copyright (C) 2006-2018 by Phorward Software Technologies, Jan Max Meyer
+http://www.phorward-software.com ++ contact<at>phorward<dash>software<dot>com
+All rights reserved. See LICENSE for more information.
+
+File:	stream.c
+Author:	Jan Max Meyer
+Usage:	Lexical analysis on streamed input, read in chunks from a file
+		descriptor, a FILE* or a user-defined read function.
+----------------------------------------------------------------------------- */
+
+#include "phorward.h"
+
+#ifdef _WIN32
+#include <io.h>
+#endif
+
+/* Read function for plex_stream_fd() */
+static int plex_stream_readfd( void* user, char* buf, size_t size )
+{
+	return (int)read( *( (int*)user ), buf, size );
+}
+
+/* Read function for plex_stream_file() */
+static int plex_stream_readfile( void* user, char* buf, size_t size )
+{
+	return (int)fread( buf, 1, size, (FILE*)user );
+}
+
+/** Creates a streaming lexer context, which runs the lexical analyzer //lex//
+on input that is obtained from the read function //read//.
+
+//read// is called as ``read( user, buf, size )`` whenever more input is
+required, and must store at most //size// bytes into //buf//. It returns the
+number of bytes read, 0 at the end of the input or a negative value on error,
+which is handled as the end of the input.
+
+The input is read in chunks of PREGEX_STREAM_BUFSIZE bytes, and may contain
+zero-bytes, which are matched like any other character. Only the input from
+the begin of the current token is kept, so the buffer grows only for tokens
+that don't fit into it.
+
+The lexer must not use PREGEX_COMP_LAZY or PREGEX_RUN_WCHAR.
+
+Returns the allocated plex_stream-object, which must be released using
+plex_stream_free(), or (plex_stream*)NULL on error.
+*/
+plex_stream* plex_stream_create( plex* lex, plex_readfn read, void* user )
+{
+	plex_stream*	stream;
+
+	PROC( "plex_stream_create" );
+	PARMS( "lex", "%p", lex );
+	PARMS( "read", "%p", read );
+	PARMS( "user", "%p", user );
+
+	if( !( lex && read ) )
+	{
+		WRONGPARAM;
+		RETURN( (plex_stream*)NULL );
+	}
+
+	if( !lex->trans_cnt && !lex->lazy )
+		plex_prepare( lex );
+
+	if( !lex->trans_cnt || lex->flags & PREGEX_RUN_WCHAR )
+	{
+		MSG( "Lexer can't be run on a stream" );
+		RETURN( (plex_stream*)NULL );
+	}
+
+	stream = (plex_stream*)pmalloc( sizeof( plex_stream ) );
+	stream->lex = lex;
+	stream->read = read;
+	stream->user = user;
+
+	stream->size = PREGEX_STREAM_BUFSIZE;
+	stream->buf = (char*)pmalloc( ( stream->size + 1 ) * sizeof( char ) );
+
+	RETURN( stream );
+}
+
+/** Creates a streaming lexer context for the lexical analyzer //lex//, which
+reads its input from the file descriptor //fd//.
+
+//fd// is not closed by plex_stream_free().
+
+Returns the allocated plex_stream-object, or (plex_stream*)NULL on error. */
+plex_stream* plex_stream_fd( plex* lex, int fd )
+{
+	plex_stream*	stream;
+
+	if( fd < 0 )
+	{
+		WRONGPARAM;
+		return (plex_stream*)NULL;
+	}
+
+	if( ( stream = plex_stream_create( lex, plex_stream_readfd, (void*)NULL ) ) )
+	{
+		stream->fd = fd;
+		stream->user = &stream->fd;
+	}
+
+	return stream;
+}
+
+/** Creates a streaming lexer context for the lexical analyzer //lex//, which
+reads its input from the file //f//.
+
+//f// is not closed by plex_stream_free().
+
+Returns the allocated plex_stream-object, or (plex_stream*)NULL on error. */
+plex_stream* plex_stream_file( plex* lex, FILE* f )
+{
+	if( !f )
+	{
+		WRONGPARAM;
+		return (plex_stream*)NULL;
+	}
+
+	return plex_stream_create( lex, plex_stream_readfile, (void*)f );
+}
+
+/** Frees the streaming lexer context //stream//. The lexer is not freed.
+
+Always returns (plex_stream*)NULL. */
+plex_stream* plex_stream_free( plex_stream* stream )
+{
+	if( !stream )
+		return (plex_stream*)NULL;
+
+	pfree( stream->buf );
+	pfree( stream );
+
+	return (plex_stream*)NULL;
+}
+
+/* Reads the next chunk of input into the buffer of //stream//. The input
+before the current token is discarded, and the buffer is enlarged when the
+current token fills it entirely. Returns FALSE at the end of the input. */
+static pboolean plex_stream_fill( plex_stream* stream )
+{
+	int		len;
+
+	if( stream->eof )
+		return FALSE;
+
+	/* Discard processed input */
+	if( stream->pos )
+	{
+		stream->prev = pregex_anchor_before( stream->buf,
+							stream->buf + stream->pos, stream->lex->flags );
+
+		memmove( stream->buf, stream->buf + stream->pos,
+					stream->len - stream->pos );
+
+		stream->len -= stream->pos;
+		stream->base += stream->pos;
+		stream->pos = 0;
+
+		/* Keep the buffered input terminated, even at the end of input */
+		stream->buf[ stream->len ] = '\0';
+	}
+
+	/* Token doesn't fit into buffer */
+	if( stream->len == stream->size )
+	{
+		stream->size *= 2;
+		stream->buf = (char*)prealloc( (char*)stream->buf,
+										( stream->size + 1 ) * sizeof( char ) );
+	}
+
+	if( ( len = ( *stream->read )( stream->user, stream->buf + stream->len,
+									stream->size - stream->len ) ) <= 0 )
+	{
+		stream->eof = TRUE;
+		return FALSE;
+	}
+
+	stream->len += len;
+	stream->buf[ stream->len ] = '\0';
+
+	return TRUE;
+}
+
+/* Reads the character at offset //off// from the current token of //stream//
+into //ch//, and returns its size in bytes. Input is read when the character
+is not entirely within the buffer. Returns 0 at the end of the input. */
+static int plex_stream_char( plex_stream* stream, size_t off, wchar_t* ch )
+{
+	char*	ptr;
+	int		len		= 1;
+
+	while( TRUE )
+	{
+		ptr = stream->buf + stream->pos + off;
+
+#ifdef UTF8
+		if( !( stream->lex->flags & PREGEX_RUN_UCHAR ) )
+			len = u8_seqlen( ptr );
+#endif
+
+		if( stream->pos + off + len <= stream->len )
+			break;
+
+		if( !plex_stream_fill( stream ) )
+		{
+			/* Truncated sequence at the end of the input */
+			if( stream->pos + off == stream->len )
+				return 0;
+
+			*ch = (unsigned char)*ptr;
+			return 1;
+		}
+	}
+
+#ifdef UTF8
+	if( !( stream->lex->flags & PREGEX_RUN_UCHAR ) )
+		*ch = u8_char( ptr );
+	else
+#endif
+		*ch = (unsigned char)*ptr;
+
+	return len;
+}
+
+/* Returns the anchor class of the character in front of the current token of
+//stream//. Reading may have discarded it from the buffer. */
+static int plex_stream_prev( plex_stream* stream )
+{
+	if( !stream->pos )
+		return stream->prev;
+
+	return pregex_anchor_before( stream->buf, stream->buf + stream->pos,
+									stream->lex->flags );
+}
+
+/* Checks the //anchors// of an accepting state, which is reached at offset
+//off// from the current token of //stream//. The character behind the match
+is read, if required. */
+static pboolean plex_stream_anchors( plex_stream* stream, int anchors,
+										size_t off )
+{
+	int			next	= PREGEX_ANCHOR_LINE;
+	wchar_t		ch;
+
+	if( stream->lex->flags & PREGEX_RUN_NOANCHORS )
+		return TRUE;
+
+	if( anchors & ( PREGEX_FLAG_EOL | PREGEX_FLAG_EOW )
+			&& plex_stream_char( stream, off, &ch ) )
+	{
+#ifdef UTF8
+		/* Matching UTF-8 on bytes, the entire sequence is read */
+		if( stream->lex->flags & PREGEX_RUN_UCHAR
+				&& stream->lex->flags & PREGEX_COMP_UTF8 && ch > 0x7F )
+			plex_stream_char( stream, off + u8_seqlen( stream->buf
+											+ stream->pos + off ) - 1, &ch );
+#endif
+
+		next = pregex_anchor_after( stream->buf + stream->pos + off,
+									stream->buf + stream->len,
+										stream->lex->flags );
+	}
+
+	return pregex_anchor_test( anchors, plex_stream_prev( stream ), next );
+}
+
+/* Returns the length of the buffered input at offset //off// from the current
+token of //stream//, which stays in the self-loop state //state// of the DFA
+with the dense table //dense//. */
+static size_t plex_stream_skip( plex_stream* stream, pregex_dense* dense,
+									int state, size_t off )
+{
+	pregex_accel*	accel;
+	char*			ptr;
+	char*			next;
+
+	if( !( dense && dense->accel
+			&& ( accel = dense->accel[ state * 2
+						+ !( stream->lex->flags & PREGEX_RUN_UCHAR ) ] ) ) )
+		return 0;
+
+	ptr = stream->buf + stream->pos + off;
+	next = pregex_accel_skip( accel, ptr, stream->buf + stream->len );
+
+#ifdef UTF8
+	/* Don't stop within a sequence cut by the buffer end */
+	if( !( stream->lex->flags & PREGEX_RUN_UCHAR )
+			&& next == stream->buf + stream->len )
+	{
+		while( next > ptr && ( next[ -1 ] & 0xC0 ) == 0x80 )
+			next--;
+
+		if( next > ptr && ( next[ -1 ] & 0xC0 ) == 0xC0 )
+			next--;
+	}
+#endif
+
+	return next - ptr;
+}
+
+/* Matches the lexer of //stream// at the current position, like plex_lex()
+does. The DFA state is kept while input is read, so that tokens can span
+multiple chunks. On a match, the match ID is returned, and //end// receives
+the length of the match. */
+static int plex_stream_match( plex_stream* stream, size_t* end )
+{
+	plex*			lex			= stream->lex;
+	wchar_t**		dfatab		= lex->trans;
+	pregex_dense*	dense		= lex->dense;
+	unsigned char*	tag;
+	int				i;
+	int				len;
+	int				state		= 0;
+	int				id			= 0;
+	int				aflags;
+	unsigned int	acc;
+	size_t			off			= 0;
+	size_t			skip;
+	size_t			ref			[ PREGEX_MAXREF * 2 ];
+	wchar_t			ch;
+
+	/* Reference offsets are stored + 1, zero is unset */
+	memset( ref, 0, sizeof( ref ) );
+
+	while( TRUE )
+	{
+		/* State accepts, and the anchors of one of its patterns hold? */
+		acc = 0;
+
+		if( dfatab[ state ][ 1 ] )
+			for( i = 0; ( acc = pregex_dfatab_accept( dfatab[ state ], i,
+														&aflags ) ); i++ )
+				if( !( aflags & PREGEX_FLAG_ANCHORS )
+						|| plex_stream_anchors( stream, aflags, off ) )
+					break;
+
+		if( acc )
+		{
+			*end = off;
+			id = acc;
+
+			if( lex->flags & PREGEX_RUN_NONGREEDY
+					|| aflags & PREGEX_FLAG_NONGREEDY )
+				break;
+		}
+
+		/* References */
+		if( dense && dense->tags )
+		{
+			for( tag = dense->tags[ state ];
+					tag && *tag < PREGEX_MAXREF; tag++ )
+			{
+				if( !ref[ *tag * 2 ] )
+					ref[ *tag * 2 ] = off + 1;
+
+				ref[ *tag * 2 + 1 ] = off + 1;
+			}
+		}
+		else if( dfatab[ state ][ 3 ] )
+		{
+			for( i = 0; i < PREGEX_MAXREF; i++ )
+			{
+				if( dfatab[ state ][ 3 ] & ( 1 << i ) )
+				{
+					if( !ref[ i * 2 ] )
+						ref[ i * 2 ] = off + 1;
+
+					ref[ i * 2 + 1 ] = off + 1;
+				}
+			}
+		}
+
+		/* Skip over buffered input staying in a self-loop state */
+		if( ( skip = plex_stream_skip( stream, dense, state, off ) ) )
+		{
+			off += skip;
+			continue;
+		}
+
+		if( !( len = plex_stream_char( stream, off, &ch ) ) )
+			break;
+
+		if( ( state = pregex_dfatab_next( dfatab, lex->trans_cnt, dense,
+											state, ch ) ) == lex->trans_cnt )
+			break;
+
+		off += len;
+	}
+
+	/* Buffer is stable now, fill references */
+	memset( lex->ref, 0, PREGEX_MAXREF * sizeof( prange ) );
+
+	for( i = 0; id && i < PREGEX_MAXREF; i++ )
+	{
+		if( !ref[ i * 2 ] )
+			continue;
+
+		lex->ref[ i ].start = stream->buf + stream->pos + ref[ i * 2 ] - 1;
+		lex->ref[ i ].end = stream->buf + stream->pos + ref[ i * 2 + 1 ] - 1;
+	}
+
+	return id;
+}
+
+/* Checks if the search machine of the lexer of //stream// can be used. */
+#define plex_stream_searchable( stream ) \
+	( (stream)->lex->search \
+		&& !( ( (stream)->lex->flags ^ (stream)->lex->search->flags ) \
+				& PREGEX_RUN_NONGREEDY ) )
+
+/* Checks if a token can begin with the character //ch// at the current
+position of //stream//. The search machine also rules out tokens whose begin
+anchors don't hold, or which can't be accepted anymore, as these would
+otherwise be run through the entire input they span. */
+static pboolean plex_stream_first( plex_stream* stream, wchar_t ch )
+{
+	pregex_search*	search	= stream->lex->search;
+	int				state	= 0;
+
+	if( !plex_stream_searchable( stream ) )
+		return pregex_dfatab_next( stream->lex->trans, stream->lex->trans_cnt,
+									stream->lex->dense, 0, ch )
+					< stream->lex->trans_cnt;
+
+	if( search->trans[ 0 ][ 2 ] & PREGEX_SEARCH_CLASSES )
+		state = plex_stream_prev( stream );
+
+	return ( state = pregex_dfatab_next( search->trans, search->trans_cnt,
+											search->dense, state, ch ) )
+				< search->trans_cnt
+			&& !( search->trans[ state ][ 2 ] & PREGEX_SEARCH_IDLE );
+}
+
+/* Skips the input of //stream// that doesn't match, using the search machine
+of the lexer. The forward search DFA is run over the input, and its state is
+kept while input is read. Input in front of an idle state can't contain the
+begin of a match, and is discarded. When a match has ended, the reverse DFA
+recovers its start from the remaining input, and the current position is moved
+there. Without a match, all input is skipped. */
+static void plex_stream_search( plex_stream* stream )
+{
+	pregex_search*	search		= stream->lex->search;
+	int				state		= 0;
+	int				next;
+	int				flags;
+	int				len;
+	size_t			off			= 0;
+	size_t			end			= 0;
+	size_t			skip;
+	char*			mstart;
+	wchar_t			ch;
+
+	/* Initial state for the character in front of the input */
+	if( search->trans[ 0 ][ 2 ] & PREGEX_SEARCH_CLASSES )
+		state = plex_stream_prev( stream );
+
+	/* Forward pass: Find the end of the leftmost match, stored + 1 */
+	while( TRUE )
+	{
+		if( search->trans[ state ][ 2 ] & PREGEX_SEARCH_IDLE )
+		{
+			stream->pos += off;
+			off = 0;
+		}
+
+		if( search->trans[ state ][ 1 ] )
+			end = off + 1;
+
+		/* Skip over buffered input staying in a self-loop state */
+		if( ( skip = plex_stream_skip( stream, search->dense, state, off ) ) )
+		{
+			off += skip;
+			continue;
+		}
+
+		if( !( len = plex_stream_char( stream, off, &ch ) ) )
+		{
+			/* A match waiting for its end anchors ends with the input */
+			if( search->trans[ state ][ 2 ] & PREGEX_SEARCH_ATEOF )
+				end = off + 1;
+
+			break;
+		}
+
+		if( ( next = pregex_dfatab_next( search->trans, search->trans_cnt,
+											search->dense, state, ch ) )
+				== search->trans_cnt )
+			break;
+
+		state = next;
+		off += len;
+
+		/* A match ended in front of this character */
+		if( search->trans[ state ][ 2 ] & PREGEX_SEARCH_ENDED )
+			end = off - len + 1;
+	}
+
+	if( !end )
+	{
+		stream->pos += off;
+		return;
+	}
+
+	/* Reverse pass: Find the start of the match in the buffered input */
+	flags = ( stream->lex->flags
+				& ~( PREGEX_RUN_NOTBOL | PREGEX_RUN_NOTBOW ) )
+					| pregex_anchor_flags( plex_stream_prev( stream ) );
+
+	if( pregex_search_start( search, stream->buf + stream->pos,
+								stream->buf + stream->len,
+									stream->buf + stream->pos + end - 1,
+										&mstart, flags ) )
+		stream->pos = mstart - stream->buf;
+}
+
+/** Reads the next token from the streaming lexer context //stream//.
+
+Unrecognized input is skipped, like plex_next() does, using the search machine
+of the lexer when it is available. If a token is matched,
+the function returns the id of the matching pattern, and //start// and //end//
+receive the begin and end pointer of the token. Both can be omitted by
+providing NULL-pointers. The token is not zero-terminated, and it is only valid
+until the next call. stream->offset receives the position of the token within
+the entire input, and the references of the lexer are filled.
+
+Empty matches are skipped, so that the input always advances.
+
+Returns 0 at the end of the input.
+*/
+unsigned int plex_stream_next( plex_stream* stream, char** start, char** end )
+{
+	int			id;
+	int			len;
+	int			skip	= 0;
+	size_t		match;
+	wchar_t		ch;
+
+	PROC( "plex_stream_next" );
+	PARMS( "stream", "%p", stream );
+	PARMS( "start", "%p", start );
+	PARMS( "end", "%p", end );
+
+	if( !stream )
+	{
+		WRONGPARAM;
+		RETURN( 0 );
+	}
+
+	while( ( len = plex_stream_char( stream, 0, &ch ) ) )
+	{
+		/* Check if a token can begin with the current character */
+		if( plex_stream_first( stream, ch ) )
+		{
+			if( ( id = plex_stream_match( stream, &match ) ) && match )
+			{
+				if( start )
+					*start = stream->buf + stream->pos;
+				if( end )
+					*end = stream->buf + stream->pos + match;
+
+				stream->offset = stream->base + stream->pos;
+				stream->pos += match;
+
+				VARS( "stream->offset", "%ld", stream->offset );
+				RETURN( id );
+			}
+
+			/* Don't retry the DFA at every position behind a failed run */
+			skip = PREGEX_SEARCH_MINSKIP;
+		}
+		else
+			skip++;
+
+		stream->pos += len;
+
+		/* Skip the input that doesn't match using the search machine */
+		if( skip >= PREGEX_SEARCH_MINSKIP && plex_stream_searchable( stream ) )
+		{
+			plex_stream_search( stream );
+			skip = 0;
+		}
+	}
+
+	MSG( "End of input" );
+	RETURN( 0 );
+}
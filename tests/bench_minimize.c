@@ -0,0 +1,78 @@
+#include "phorward.h"
+#include <time.h>
+
+/* Benchmark for pregex_dfa_minimize() on a large keyword lexer.
+
+Usage: bench_minimize [keywords] */
+
+int main( int argc, char** argv )
+{
+	int				i;
+	int				j;
+	int				len;
+	int				keywords	= 500;
+	int				states;
+	char			kw			[ 16 ];
+	plist*			ptns;
+	plistel*		e;
+	pregex_ptn*		ptn;
+	pregex_nfa*		nfa;
+	pregex_dfa*		dfa;
+	clock_t			start;
+
+	if( argc > 1 )
+		keywords = atoi( argv[ 1 ] );
+
+	ptns = plist_create( 0, PLIST_MOD_PTR );
+	nfa = pregex_nfa_create();
+
+	/* Generate pseudo-random keywords, identifiers and numbers */
+	srand( 1 );
+
+	for( i = 0; i < keywords; i++ )
+	{
+		len = 3 + rand() % 8;
+
+		for( j = 0; j < len; j++ )
+			kw[ j ] = 'a' + rand() % 26;
+
+		kw[ j ] = '\0';
+
+		pregex_ptn_parse( &ptn, kw, PREGEX_COMP_STATIC );
+		ptn->accept = i + 1;
+		plist_push( ptns, ptn );
+	}
+
+	pregex_ptn_parse( &ptn, "[a-z_][a-z0-9_]*", 0 );
+	ptn->accept = keywords + 1;
+	plist_push( ptns, ptn );
+
+	pregex_ptn_parse( &ptn, "[0-9]+", 0 );
+	ptn->accept = keywords + 2;
+	plist_push( ptns, ptn );
+
+	plist_for( ptns, e )
+		pregex_ptn_to_nfa( nfa, (pregex_ptn*)plist_access( e ) );
+
+	dfa = pregex_dfa_create();
+
+	start = clock();
+	states = pregex_dfa_from_nfa( dfa, nfa );
+	printf( "%d keywords, %d DFA states, subset construction %.3fs\n",
+		keywords, states, (double)( clock() - start ) / CLOCKS_PER_SEC );
+
+	start = clock();
+	states = pregex_dfa_minimize( dfa );
+	printf( "%d minimized DFA states, minimization %.3fs\n",
+		states, (double)( clock() - start ) / CLOCKS_PER_SEC );
+
+	pregex_dfa_free( dfa );
+	pregex_nfa_free( nfa );
+
+	plist_for( ptns, e )
+		pregex_ptn_free( (pregex_ptn*)plist_access( e ) );
+
+	plist_free( ptns );
+
+	return 0;
+}
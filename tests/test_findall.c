@@ -0,0 +1,103 @@
+#include "phorward.h"
+
+/* Regression test for pregex_findall() and pregex_splitall(): Patterns that
+match the empty string must not stop the finders from advancing. Empty
+matches are skipped, so the results are those of the non-empty matches. */
+
+static struct
+{
+	char*	pat;
+	int		flags;
+	char*	input;
+	char*	find;
+	char*	split;
+} tests[] =
+{
+	{ ".*",		PREGEX_RUN_NONGREEDY,	"abc",		"",			"abc" },
+	{ "x*",		0,						"abxxc",	"xx",		"ab c" },
+	{ "x*",		PREGEX_RUN_NONGREEDY,	"abxxc",	"",			"abxxc" },
+	{ "(ab)*|c",	0,					"xabcab",	"ab c ab",	"x" }
+};
+
+/* Joins the ranges of //a// separated by blanks into //buf// */
+static char* join( parray* a, char* buf )
+{
+	prange*		r;
+
+	*buf = '\0';
+
+	if( !a )
+		return buf;
+
+	parray_for( a, r )
+	{
+		if( *buf )
+			strcat( buf, " " );
+
+		strncat( buf, r->start, r->end - r->start );
+	}
+
+	return buf;
+}
+
+int main( int argc, char** argv )
+{
+	int				fails	= 0;
+	int				i;
+	char			buf[ 80 ];
+	pregex*			r;
+	pregex_iter		it;
+	prange			m;
+	parray*			a;
+
+	for( i = 0; i < sizeof( tests ) / sizeof( *tests ); i++ )
+	{
+		r = pregex_create( tests[ i ].pat, tests[ i ].flags );
+
+		pregex_findall( r, tests[ i ].input, &a );
+
+		if( strcmp( join( a, buf ), tests[ i ].find ) )
+		{
+			printf( "%s on %s: findall gave >%s<, expected >%s<\n",
+						tests[ i ].pat, tests[ i ].input, buf,
+							tests[ i ].find );
+			fails++;
+		}
+
+		parray_free( a );
+
+		pregex_splitall( r, tests[ i ].input, &a );
+
+		if( strcmp( join( a, buf ), tests[ i ].split ) )
+		{
+			printf( "%s on %s: splitall gave >%s<, expected >%s<\n",
+						tests[ i ].pat, tests[ i ].input, buf,
+							tests[ i ].split );
+			fails++;
+		}
+
+		parray_free( a );
+
+		/* The iterator gives the same matches */
+		a = parray_create( sizeof( prange ), 0 );
+		pregex_iter_init( &it, r, tests[ i ].input, (char*)NULL );
+
+		while( pregex_iter_next( &it, &m ) )
+			parray_push( a, &m );
+
+		if( strcmp( join( a, buf ), tests[ i ].find ) )
+		{
+			printf( "%s on %s: iterator gave >%s<, expected >%s<\n",
+						tests[ i ].pat, tests[ i ].input, buf,
+							tests[ i ].find );
+			fails++;
+		}
+
+		parray_free( a );
+		pregex_free( r );
+	}
+
+	printf( "%d tests, %d failed\n", i, fails );
+
+	return fails ? 1 : 0;
+}
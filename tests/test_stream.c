@@ -0,0 +1,127 @@
+#include "phorward.h"
+
+/* Regression test for plex_stream: Input is read in chunks of 1 to 11 bytes,
+and the last token is cut by the end of the input within a self-loop state.
+The stream must report the same tokens as plex_tokenize().
+
+A long run of word characters behind a word character never begins a word, and
+must be skipped in linear time by the search machine, which is carried across
+the chunks, without enlarging the buffer. */
+
+static char*	input;
+static size_t	pos;
+static size_t	chunk;
+
+static int readchunk( void* user, char* buf, size_t size )
+{
+	size_t	len		= strlen( input ) - pos;
+
+	if( len > chunk )
+		len = chunk;
+	if( len > size )
+		len = size;
+
+	memcpy( buf, input + pos, len );
+	pos += len;
+
+	return (int)len;
+}
+
+/* Streams //input// through //l// in chunks of //chunk// bytes, and compares
+the tokens with those of plex_tokenize() in //a//. No token exceeds the
+buffer, so it must not be enlarged. Returns the failures. */
+static int check( plex* l, parray* a )
+{
+	unsigned int	id;
+	char*			start;
+	char*			end;
+	plex_stream*	s;
+	prange*			r;
+	int				fails	= 0;
+
+	pos = 0;
+	s = plex_stream_create( l, readchunk, (void*)NULL );
+	r = a ? (prange*)parray_first( a ) : (prange*)NULL;
+
+	while( ( id = plex_stream_next( s, &start, &end ) ) )
+	{
+		if( !r || r->id != id
+				|| r->start - input != (long)s->offset
+				|| r->end - r->start != end - start )
+		{
+			printf( "chunk %d: unexpected token %d >%.*s< at %ld\n",
+						(int)chunk, id, (int)( end - start ), start,
+							(long)s->offset );
+			fails++;
+			break;
+		}
+
+		r = (prange*)parray_next( a, r );
+	}
+
+	if( r && !id )
+	{
+		printf( "chunk %d: missing token %d >%.*s<\n",
+					(int)chunk, r->id, (int)( r->end - r->start ),
+						r->start );
+		fails++;
+	}
+
+	if( s->size > PREGEX_STREAM_BUFSIZE )
+	{
+		printf( "chunk %d: buffer enlarged to %ld bytes\n",
+					(int)chunk, (long)s->size );
+		fails++;
+	}
+
+	plex_stream_free( s );
+	return fails;
+}
+
+int main( int argc, char** argv )
+{
+	int				fails	= 0;
+	size_t			cnt;
+	size_t			n		= 1 << 20;
+	char*			words;
+	plex*			l;
+	parray*			a;
+
+	l = plex_create( 0 );
+	plex_define( l, "[a-z]+", 1, 0 );
+	plex_define( l, "\"[a-z]*\"", 2, 0 );
+	plex_prepare( l );
+
+	input = "xxxxx \"eb";
+	cnt = plex_tokenize( l, input, &a );
+
+	for( chunk = 1; chunk < 12; chunk++ )
+		fails += check( l, a );
+
+	parray_free( a );
+	plex_free( l );
+
+	/* "1aaa...a abc" only has the token "abc" */
+	words = (char*)pmalloc( n + 6 );
+	*words = '1';
+	memset( words + 1, 'a', n );
+	strcpy( words + n + 1, " abc" );
+
+	l = plex_create( 0 );
+	plex_define( l, "\\<[a-z]+\\>", 1, 0 );
+	plex_prepare( l );
+
+	input = words;
+	cnt += plex_tokenize( l, input, &a );
+
+	for( chunk = 1000; chunk < n; chunk *= 10 )
+		fails += check( l, a );
+
+	printf( "%d tokens, %d failed\n", (int)cnt, fails );
+
+	parray_free( a );
+	plex_free( l );
+	pfree( words );
+
+	return fails ? 1 : 0;
+}
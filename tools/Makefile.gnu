@@ -18,14 +18,14 @@ clean:
 	-rm $(PLEX) $(PPARSE) $(PREGEX) $(PPGRAM2C) $(PVM)
 
 $(PLEX): plex.o util.o $(LIBPHORWARD)
-	$(CC) -o $@ $+
+	$(CC) -o $@ $+ -lpthread
 
 $(PPARSE): pparse.o util.o $(LIBPHORWARD)
-	$(CC) -o $@ $+
+	$(CC) -o $@ $+ -lpthread
 
 $(PREGEX): pregex.o util.o $(LIBPHORWARD)
-	$(CC) -o $@ $+
+	$(CC) -o $@ $+ -lpthread
 
 $(PVM): pvm.o util.o $(LIBPHORWARD)
-	$(CC) -o $@ $+
+	$(CC) -o $@ $+ -lpthread
 
@@ -21,6 +21,10 @@ void help( char** argv )
 	"   -f  --file      FILENAME  Read input from FILENAME\n"
 	"   -h  --help                Show this help, and exit.\n"
 	"   -i  --input     INPUT     Use string INPUT as input.\n"
+	"   -n  --name      NAME      Use NAME as function name of the generated\n"
+	"                             scanner ('scan' is default)\n"
+	"   -o  --output    FILENAME  Generate a direct-coded C scanner into\n"
+	"                             FILENAME, and exit.\n"
 	"   -V  --version             Show version info and exit.\n"
 
 
@@ -30,11 +34,16 @@ void help( char** argv )
 int main( int argc, char** argv )
 {
 	char*		finput		= (char*)NULL;
+	char*		fname		= (char*)NULL;
 	char*		begin_sep	= " >";
 	char*		end_sep		= "<\n";
 	char*		start		= (char*)NULL;
+	char*		foutput		= (char*)NULL;
+	char*		name		= "scan";
+	FILE*		f;
 	char*		end;
 	plex*		lex;
+	plex_stream*	stream;
 	int			id;
 
 	int			i;
@@ -46,33 +55,31 @@ int main( int argc, char** argv )
 
 	/* Analyze command-line parameters */
 	for( i = 0; ( rc = pgetopt( opt, &param, &next, argc, argv,
-						"b:e:d:Df:hi:V",
+						"b:e:d:Df:hi:n:o:V",
 						"begin: end: delimiter: file: "
-							"help input: version", i ) ) == 0; i++ )
+							"help input: name: output: version",
+								i ) ) == 0; i++ )
 	{
 		if( !strcmp( opt, "begin" ) || !strcmp( opt, "b" ) )
 			begin_sep = pstrunescape( param );
 		else if( !strcmp( opt, "end" ) || !strcmp( opt, "e" ) )
 			end_sep = pstrunescape( param );
 		else if( !strcmp( opt, "file" ) || !strcmp( opt, "f" ) )
-		{
-			finput = pfree( finput );
-
-			if( !pfiletostr( &finput, param ) )
-			{
-				fprintf( stderr, "Unable to read input file '%s'\n", param );
-				return 1;
-			}
-
-			start = finput;
-		}
+			fname = param;
 		else if( !strcmp( opt, "help" ) || !strcmp( opt, "h" )  )
 		{
 			help( argv );
 			return 0;
 		}
 		else if( !strcmp( opt, "input" ) || !strcmp( opt, "i" ) )
+		{
 			start = param;
+			fname = (char*)NULL;
+		}
+		else if( !strcmp( opt, "name" ) || !strcmp( opt, "n" ) )
+			name = param;
+		else if( !strcmp( opt, "output" ) || !strcmp( opt, "o" ) )
+			foutput = param;
 		else if( !strcmp( opt, "version" ) || !strcmp( opt, "V" ) )
 		{
 			version( argv, "Lexical analysis command-line utility" );
@@ -103,6 +110,58 @@ int main( int argc, char** argv )
 		return 1;
 	}
 
+	/* Generate scanner */
+	if( foutput )
+	{
+		if( !( f = fopen( foutput, "wb" ) ) )
+		{
+			fprintf( stderr, "Unable to write output file '%s'\n", foutput );
+			plex_free( lex );
+			return 1;
+		}
+
+		if( !( rc = plex_to_c( lex, f, name ) ) )
+			fprintf( stderr, "Unable to generate scanner\n" );
+
+		fclose( f );
+		plex_free( lex );
+
+		return !rc;
+	}
+
+	/* Stream input file in chunks */
+	if( fname )
+	{
+		if( !( f = fopen( fname, "rb" ) )
+				|| !( stream = plex_stream_file( lex, f ) ) )
+		{
+			fprintf( stderr, "Unable to read input file '%s'\n", fname );
+
+			if( f )
+				fclose( f );
+
+			plex_free( lex );
+			return 1;
+		}
+
+		while( ( id = plex_stream_next( stream, &start, &end ) ) )
+		{
+			if( i > 1 )
+				printf( "%d", id );
+
+			printf( "%s%.*s%s", begin_sep, (int)( end - start ), start,
+						end_sep );
+		}
+
+		fflush( stdout );
+
+		plex_stream_free( stream );
+		fclose( f );
+		plex_free( lex );
+
+		return 0;
+	}
+
 	/* Read from stdin */
 	if( !start )
 	{
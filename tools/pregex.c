@@ -24,6 +24,8 @@ void help( char** argv )
 	"   -h  --help                Show this help, and exit.\n"
 	"   -i  --input     INPUT     Use string INPUT as input.\n"
 	"   -r  --replace   STRING    Replacement string for 'replace' action.\n"
+	"   -t  --threads   NUMBER    Run 'find' action on NUMBER threads,\n"
+	"                             0 for all processors.\n"
 	"   -V  --version             Show version info and exit.\n"
 
 	"\n", *argv );
@@ -43,7 +45,10 @@ int main( int argc, char** argv )
 	char*		end;
 	char*		nstart;
 	pboolean	dump		= FALSE;
+	int			threads		= -1;
 	pregex*		re;
+	parray*		matches;
+	prange*		r;
 
 	int			i;
 	int			j;
@@ -56,9 +61,9 @@ int main( int argc, char** argv )
 
 	/* Analyze command-line parameters */
 	for( i = 0; ( rc = pgetopt( opt, &param, &next, argc, argv,
-						"a:d:De:hf:i:r:V",
+						"a:d:De:hf:i:r:t:V",
 						"action: delimiter: exec: file: help "
-							"input: replace: version", i ) )
+							"input: replace: threads: version", i ) )
 								== 0; i++ )
 	{
 		VARS( "opt", "%s", opt );
@@ -109,6 +114,8 @@ int main( int argc, char** argv )
 			input = param;
 		else if( !strcmp( opt, "replace" ) || !strcmp( opt, "r" ) )
 			replace = param;
+		else if( !strcmp( opt, "threads" ) || !strcmp( opt, "t" ) )
+			threads = atoi( param );
 		else if( !strcmp( opt, "version" ) || !strcmp( opt, "V" ) )
 		{
 			version( argv, "Regular expression command-line utility" );
@@ -160,6 +167,17 @@ int main( int argc, char** argv )
 		if( pregex_match( re, start, &end ) )
 			printf( "%.*s%s", end - start, start, delimiter );
 	}
+	else if( strcmp( action, "find" ) == 0 && threads >= 0 )
+	{
+		if( pregex_findall_parallel( re, start, (char*)NULL,
+										&matches, threads ) > 0 )
+		{
+			parray_for( matches, r )
+				printf( "%.*s%s", r->end - r->start, r->start, delimiter );
+
+			parray_free( matches );
+		}
+	}
 	else if( strcmp( action, "find" ) == 0 )
 	{
 		while( ( start = pregex_find( re, start, &end ) ) )
@@ -182,10 +200,7 @@ int main( int argc, char** argv )
 	{
 		VARS( "replace", "%s", replace );
 
-		start = pregex_replace( re, start, replace );
-		printf( "%s", start );
-
-		pfree( start );
+		pregex_replace_file( re, start, replace, stdout );
 	}
 
 	fflush( stdout );